@@ -0,0 +1,76 @@
+﻿/**
+ * @file chunk_sched.cpp
+ * @brief 分块池：领取、窃取与放回
+ */
+#include "chunk_sched.h"
+
+ChunkPool::ChunkPool(uint64_t total, uint64_t chunk, size_t executors)
+    : total_(total), chunk_(chunk ? chunk : 1), chunks_((size_t)((total + chunk_ - 1) / chunk_)),
+      avg_ms_(executors, -1.0) {}
+
+bool ChunkPool::acquire(size_t who, size_t& i, bool& stolen) {
+    std::unique_lock<std::mutex> lk(m_);
+    for (;;) {
+        while (next_ < chunks_.size() && chunks_[next_].state != FREE) ++next_;
+        const Clock::time_point now = Clock::now();
+        if (next_ < chunks_.size()) {
+            i = next_++;
+            chunks_[i].state = RUNNING;
+            chunks_[i].owner = who;
+            chunks_[i].t_owner = now;
+            stolen = false;
+            return true;
+        }
+        if (done_ == chunks_.size()) return false;
+        const size_t k = steal_target(who, now);
+        if (k != NOBODY) {
+            chunks_[k].thief = who;
+            chunks_[k].t_thief = now;
+            i = k;
+            stolen = true;
+            return true;
+        }
+        cv_.wait_for(lk, std::chrono::milliseconds(SCHED_POLL_MS));
+    }
+}
+
+// 可窃取的块中领取最早的一块；who 还没完成过任何块时不窃取（不知道自己多快）
+size_t ChunkPool::steal_target(size_t who, Clock::time_point now) const {
+    const double mine = avg_ms_[who];
+    if (mine < 0.0) return NOBODY;
+    size_t best = NOBODY;
+    for (size_t k = 0; k < chunks_.size(); ++k) {
+        const Chunk& c = chunks_[k];
+        if (c.state != RUNNING || c.thief != NOBODY || c.owner == who) continue;
+        const double elapsed = std::chrono::duration<double, std::milli>(now - c.t_owner).count();
+        // 原执行者预计还要多久：没有历史时只知道至少还要一点，已用时间超过 who 重算一遍的耗时才窃取
+        const double theirs = avg_ms_[c.owner];
+        const double left = theirs < 0.0 ? 0.0 : theirs - elapsed;
+        if (theirs < 0.0 ? elapsed <= mine : left <= mine) continue;
+        if (best == NOBODY || c.t_owner < chunks_[best].t_owner) best = k;
+    }
+    return best;
+}
+
+void ChunkPool::observe(size_t who, Clock::time_point since) {
+    const double ms = std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    double& a = avg_ms_[who];
+    a = (a < 0.0) ? ms : (1.0 - SCHED_EMA_ALPHA) * a + SCHED_EMA_ALPHA * ms;
+}
+
+void ChunkPool::release(size_t i, size_t who) {
+    std::lock_guard<std::mutex> lk(m_);
+    Chunk& c = chunks_[i];
+    if (c.state != RUNNING) return;
+    if (c.owner == who) {
+        c.owner = c.thief;
+        c.t_owner = c.t_thief;
+        c.thief = NOBODY;
+    }
+    else if (c.thief == who) c.thief = NOBODY;
+    if (c.owner == NOBODY) {
+        c.state = FREE;
+        if (i < next_) next_ = i;
+    }
+    cv_.notify_all();
+}
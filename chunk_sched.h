@@ -0,0 +1,117 @@
+﻿/**
+ * @file chunk_sched.h
+ * @brief 拉取式分块调度与跨节点窃取
+ * * 静态切分（MsgHeader 的 begin/end 一次定死）下，一个变慢的 worker（降频、同机干扰）会拖慢每一次查询。
+ * 拉取式调度把 [0, total) 切成 SCHED_CHUNK 个元素一块，master 本地与每个 worker 都是一个"执行者"：
+ * 空闲时从 ChunkPool 领取下一块（worker 由 master 上的代理线程代为领取：上一块的应答一到就发下一块的请求），
+ * 未开始的块始终留在池中，快的节点自然多领。未分配的块取完后，空闲的执行者窃取别人手上预计比自己
+ * 重新算一遍还晚完成的块做备份执行，先完成者的结果生效，尾延迟因此不再由最慢的节点决定。
+ * 每块的结果按块号存放，合并顺序与由谁计算无关。
+ */
+#pragma once
+#include "numa_mem.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 每块元素数：4M 个 float（16MB）。须为 DET_BLOCK 的整数倍，确定性 SUM 的结果才与分块无关
+#define SCHED_CHUNK (1ull << 22)      // TODO：块越小负载越均匀，但每块多一次网络往返
+#define SCHED_POLL_MS 2               // 无块可领时隔多久重新判断一次能否窃取
+#define SCHED_EMA_ALPHA 0.3           // 各执行者每块耗时的指数滑动平均系数
+
+class ChunkPool {
+public:
+    // [0, total) 按 chunk 个元素切块（最后一块可能较短），executors 为执行者个数（编号 0 .. executors - 1）
+    ChunkPool(uint64_t total, uint64_t chunk, size_t executors);
+
+    size_t size() const { return chunks_.size(); }
+    uint64_t begin(size_t i) const { return (uint64_t)i * chunk_; }
+    uint64_t end(size_t i) const { return (uint64_t)(i + 1) * chunk_ < total_ ? (uint64_t)(i + 1) * chunk_ : total_; }
+
+    // 执行者 who 领取一块写入 i：先按块号取未分配的块；都分出去后窃取别人手上的块（stolen 为 true），
+    // 条件是按各自的平均每块耗时，who 现在重算一遍比原执行者更早完成，且该块还没被窃取过。
+    // 暂时无块可领时等待（有块完成、被放回或可以窃取时返回），全部完成时返回 false
+    bool acquire(size_t who, size_t& i, bool& stolen);
+
+    // 执行者 who 完成第 i 块：只有第一个完成者在锁内执行 publish（写入该块的结果）并返回 true，之后完成的结果丢弃
+    template <class Fn>
+    bool complete(size_t i, size_t who, Fn publish) {
+        std::lock_guard<std::mutex> lk(m_);
+        Chunk& c = chunks_[i];
+        if (c.state == DONE) return false;
+        c.state = DONE;
+        ++done_;
+        observe(who, c.owner == who ? c.t_owner : c.t_thief);
+        publish();
+        cv_.notify_all();
+        return true;
+    }
+
+    // 执行者 who 放弃第 i 块（例如 worker 断开）：块仍未完成且没有其他执行者在算时放回池中
+    void release(size_t i, size_t who);
+
+private:
+    using Clock = std::chrono::steady_clock;
+    enum : int { FREE = 0, RUNNING = 1, DONE = 2 };
+    static constexpr size_t NOBODY = ~(size_t)0;
+    struct Chunk {
+        int state = FREE;
+        size_t owner = NOBODY;
+        size_t thief = NOBODY;
+        Clock::time_point t_owner, t_thief;
+    };
+
+    void observe(size_t who, Clock::time_point since);
+    size_t steal_target(size_t who, Clock::time_point now) const;
+
+    const uint64_t total_;
+    const uint64_t chunk_;
+    std::vector<Chunk> chunks_;
+    std::vector<double> avg_ms_;    // 各执行者每块耗时，< 0 表示还没完成过
+    size_t next_ = 0;               // 之前的块都已分配过
+    size_t done_ = 0;
+    std::mutex m_;
+    std::condition_variable cv_;
+};
+
+// 代理线程：替一个 worker 领取并执行块。被窃取的块的应答可能在本次调用返回之后才到，
+// 线程因此可以比调用活得更久；下次使用该连接前先 join，析构时也会 join
+class ProxyThread {
+public:
+    ProxyThread() = default;
+    ProxyThread(ProxyThread&&) = default;
+    ProxyThread& operator=(ProxyThread&&) = default;
+    ~ProxyThread() { join(); }
+
+    // fn 返回 false 表示连接已不可用
+    template <class Fn>
+    void start(Fn fn) {
+        join();
+        running_ = std::make_shared<std::atomic<bool>>(true);
+        ok_ = std::make_shared<std::atomic<bool>>(true);
+        t_ = std::thread([fn, running = running_, ok = ok_]() mutable {
+            numa_release_thread();  // 不继承主线程绑定的单个 CPU
+            ok->store(fn());
+            running->store(false);
+        });
+    }
+    bool joinable() const { return t_.joinable(); }
+    bool running() const { return running_ && running_->load(); }
+    // 等线程结束；返回连接是否仍然可用
+    bool join() {
+        if (t_.joinable()) t_.join();
+        return !ok_ || ok_->load();
+    }
+
+private:
+    std::thread t_;
+    std::shared_ptr<std::atomic<bool>> running_;
+    std::shared_ptr<std::atomic<bool>> ok_;
+};
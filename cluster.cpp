@@ -0,0 +1,98 @@
+﻿/**
+ * @file cluster.cpp
+ * @brief worker 列表解析与 N 路区间切分
+ */
+#include "cluster.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+std::string trim(const std::string& s) {
+    const size_t b = s.find_first_not_of(" \t\r\n");
+    if (b == std::string::npos) return std::string();
+    const size_t e = s.find_last_not_of(" \t\r\n");
+    return s.substr(b, e - b + 1);
+}
+
+// 解析一项 "ip[:port]"
+bool parse_one(const std::string& item, uint16_t default_port, WorkerAddr& out) {
+    const size_t colon = item.find(':');
+    out.ip = trim(item.substr(0, colon));
+    out.port = default_port;
+    if (out.ip.empty()) return false;
+    if (colon == std::string::npos) return true;
+    const std::string p = trim(item.substr(colon + 1));
+    char* end = nullptr;
+    const unsigned long v = std::strtoul(p.c_str(), &end, 10);
+    if (p.empty() || *end || v == 0 || v > 65535) return false;
+    out.port = (uint16_t)v;
+    return true;
+}
+
+// 先序访问以 worker w 为根的子树，返回子树节点数
+uint32_t tree_visit(size_t w, size_t workers, size_t arity, std::vector<TreeSlot>& order) {
+    const size_t at = order.size();
+    order.push_back(TreeSlot{ w, 1 });
+    for (size_t j = 0; j < arity; ++j) {
+        const size_t c = arity * (w + 1) + j;
+        if (c >= workers) break;
+        const uint32_t n = tree_visit(c, workers, arity, order);
+        order[at].subtree += n;
+    }
+    return order[at].subtree;
+}
+
+} // namespace
+
+bool parse_worker_list(const std::string& text, uint16_t default_port, std::vector<WorkerAddr>& out) {
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream items(line);
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            if (trim(item).empty()) continue;
+            WorkerAddr a;
+            if (!parse_one(item, default_port, a)) return false;
+            out.push_back(a);
+        }
+    }
+    return true;
+}
+
+bool load_worker_file(const std::string& path, uint16_t default_port, std::vector<WorkerAddr>& out) {
+    std::ifstream f(path);
+    if (!f) return false;
+    std::ostringstream text;
+    text << f.rdbuf();
+    return parse_worker_list(text.str(), default_port, out);
+}
+
+void split_ranges(uint64_t total, const std::vector<double>& weights, uint64_t align, std::vector<uint64_t>& bounds) {
+    const size_t k = weights.size();
+    bounds.assign(k + 1, 0);
+    if (k == 0) return;
+    double sum = 0.0;
+    for (double w : weights) sum += (w > 0.0 ? w : 0.0);
+    if (align == 0) align = 1;
+    // 按累计权重取切分点，保证单调且最后一段收尾
+    double acc = 0.0;
+    for (size_t i = 1; i < k; ++i) {
+        acc += (weights[i - 1] > 0.0 ? weights[i - 1] : 0.0);
+        uint64_t cut = sum > 0.0 ? (uint64_t)((double)total * (acc / sum)) : 0;
+        if (cut > total) cut = total;
+        cut -= cut % align;
+        bounds[i] = cut < bounds[i - 1] ? bounds[i - 1] : cut;
+    }
+    bounds[k] = total;
+}
+
+void tree_preorder(size_t workers, size_t arity, std::vector<TreeSlot>& order) {
+    order.clear();
+    if (arity == 0) arity = 1;
+    for (size_t c = 0; c < arity && c < workers; ++c) tree_visit(c, workers, arity, order);
+}
@@ -0,0 +1,43 @@
+﻿/**
+ * @file cluster.h
+ * @brief 多 worker 集群：worker 列表与 N 路区间切分
+ * * 默认只有 master.cpp 中的 WORKER_IP 一个 worker（双机模式）。master 启动时可以用参数指定多个 worker：
+ *   Master --workers 10.0.0.2,10.0.0.3:50002,...    （逗号分隔，端口省略时为 PORT）
+ *   Master --workers-file workers.txt                 （每行一个 ip[:port]，# 之后为注释）
+ * worker 多于一个时，SUM/MAX/STATS/SORT 把 [0, totalN) 按份额切成 1 + W 段，master 负责第 0 段，
+ * 请求同时下发给全部 worker，结果逐个收回合并；SORT 的各段有序结果在 master 上做 k 路归并（见 master.cpp）。
+ * worker 很多时 master 的网卡与归并成为瓶颈，可以用 --tree K 让 worker 排成 K 叉树（见 common.h 的 Op::TREE）：
+ * master 只连接自己的 K 个孩子，中间 worker 合并孩子的部分和/最大值，或把孩子的有序流与自己的段归并后再向上发送，
+ * master 收到的结果个数（SORT 的数据流条数）为 O(K) 而不是 O(W)。
+ */
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 一个 worker 的地址
+struct WorkerAddr {
+    std::string ip;
+    uint16_t port;
+};
+
+// 解析逗号或换行分隔的 "ip[:port]" 列表（忽略空白与 # 注释），追加到 out；格式错误时返回 false
+bool parse_worker_list(const std::string& text, uint16_t default_port, std::vector<WorkerAddr>& out);
+
+// 从文件读取 worker 列表，格式同 parse_worker_list；文件打不开或格式错误时返回 false
+bool load_worker_file(const std::string& path, uint16_t default_port, std::vector<WorkerAddr>& out);
+
+// 把 [0, total) 按 weights 的比例切成 weights.size() 段，bounds[k] 为第 k 段起点（bounds.back() == total）；
+// 内部切分点向下对齐到 align 的整数倍（确定性 SUM 需要按 DET_BLOCK 对齐，余下的部分归最后一段），权重不大于 0 的段为空
+void split_ranges(uint64_t total, const std::vector<double>& weights, uint64_t align, std::vector<uint64_t>& bounds);
+
+// 树形汇聚中的一个 worker：worker 为其在列表中的下标，subtree 为以它为根的子树节点数（含自身）
+struct TreeSlot {
+    size_t worker;
+    uint32_t subtree;
+};
+
+// 把 workers 个 worker 排成 arity 叉树（master 为根），按先序写入 order。
+// 堆式编号：master 的孩子为 worker 0..arity-1，worker i 的孩子为 arity*(i+1)+j；arity >= workers 时全部是 master 的孩子。
+// 按先序依次分配段时，每棵子树的段首尾相接
+void tree_preorder(size_t workers, size_t arity, std::vector<TreeSlot>& order);
@@ -26,9 +26,25 @@ static constexpr uint16_t PORT = 50001;       //  TODO：可以更改端口
 enum class Op : uint32_t {
     SUM = 1,
     MAX = 2,
-    SORT = 3
+    SORT = 3,
+    STATS = 4,  // 一次遍历返回 min/max/sum/均值/方差/argmax
+    SORT_SPLIT = 5, // 样本排序：交换键样本确定分割点，两端各自负责不相交的键区间
+    HELLO = 6,      // 连接建立后协商连接特性（len 为 master 请求的 FEATURE_* 位，begin 为请求的数据连接数）
+    TREE = 7        // 树形汇聚：len 为实际的 Op，收到的 worker 再把请求转发给自己的子节点，合并后向上应答（见 TreeNode）
 };
 
+// 连接特性位：HELLO 的应答中为双方都支持的特性
+#define FEATURE_SORT_CODEC 0x1u     // 排序结果按 wire_codec.h 的压缩格式分帧发送
+#define FEATURE_STRIPE 0x2u         // SORT_SPLIT 的结果条带化分布在多条数据连接上（见 stripe.h）
+#define FEATURE_SHM 0x4u            // 同机部署：SORT/SORT_SPLIT 的结果放在共享内存中（见 shm_transport.h）
+
+// 共享内存区域名的最大长度（含结尾 0）
+#define SHM_NAME_MAX 64
+
+// 树形汇聚：节点地址的最大长度（含结尾 0），以及一个请求中后代节点数的上限
+#define TREE_IP_MAX 64
+#define TREE_MAX_NODES 1024
+
 // 这两个max和min函数仅用于打印排序结果示例，不参与核心计算
 static inline int imax(int a, int b) { return a > b ? a : b; }
 static inline int imin(int a, int b) { return a < b ? a : b; }
@@ -50,16 +66,101 @@ struct WorkerScalarResult {
     double compute_ms;  // worker 侧计算耗时（不含网络）
 };
 
+// worker -> master SUM 结果
+// 确定性引擎（SumEngine::DET_OMP）下额外带回定点部分和，master 用整数相加合并，结果与切分位置无关
+struct WorkerSumResult {
+    float value;
+    uint32_t det;          // 1：det_fixed/det_special 有效
+    int64_t det_fixed;
+    uint32_t det_special;
+    double compute_ms;  // worker 侧计算耗时（不含网络）
+};
+
+// worker -> master 多统计量结果（对 ln(sqrt(x)) 而言）
+struct WorkerStatsResult {
+    uint64_t count;
+    double sum;
+    double m2;          // 与均值之差的平方和，master 用 Welford/Chan 公式合并
+    float min;
+    float max;
+    uint64_t argmax;    // 全局下标；不存在时为 ~0ULL
+    double compute_ms;  // worker 侧计算耗时（不含网络）
+};
+
 // worker -> master 排序结果头
 struct WorkerSortHeader {
     uint64_t bytes;     // 随后发送的 float 字节数
     double compute_ms;  // worker 侧计算耗时（不含网络）
 };
+
+// SORT 的结果按帧发送：每帧先发 SortChunkHeader，再发 count 个 float；count 为 0 的帧表示结束。
+// master 边收边归并，只需 SORT_RING_SLOTS 个 SORT_CHUNK 大小的缓冲区。
+struct SortChunkHeader {
+    uint32_t count;     // 本帧 float 个数，不超过 SORT_CHUNK
+};
+// 协商了 FEATURE_SORT_CODEC 的连接：每个非结束帧的 SortChunkHeader 之后是 CodecFrameHeader，再是 bytes 字节的编码数据；
+// 编码不划算时 bytes 为 0，随后仍是 count 个原始 float。SORT_SPLIT 的结果也按同样的帧格式发送（含结束帧）。
+struct CodecFrameHeader {
+    uint32_t bytes;
+};
+
+// worker -> master：HELLO 应答
+// 含 FEATURE_STRIPE 时 master 随即建立 streams 条数据连接，每条连接先发 StreamHello
+struct HelloReply {
+    uint32_t features;  // 双方都支持的 FEATURE_* 位
+    uint32_t streams;   // worker 接受的数据连接数
+};
+
+struct StreamHello {
+    uint32_t magic;
+    uint32_t index;     // 数据连接序号 [0, streams)
+};
+
+// 协商了 FEATURE_SHM 的连接：SORT/SORT_SPLIT 的结果应答先发 ShmNotice。
+// name 非空时结果在该共享内存区域中，主连接上不再有结果头与数据（compute_ms 在区域头部）；
+// name 为空（区域创建失败，或走外部排序）时随后仍按原有格式发送
+struct ShmNotice {
+    char name[SHM_NAME_MAX];
+    uint64_t count;     // 区域中的 float 个数
+};
+// SORT_SPLIT 协议（头部 begin/end 为 worker 的抽样区间，数据全集为 [0, end)）：
+// 1. worker -> master：WorkerSortSample，随后 count 个 uint32 键（sort_key_code）
+// 2. master -> worker：SortSplitter，worker 负责 key code >= code 的元素
+// 3. worker -> master：WorkerSortHeader，随后为已变换为 ln(sqrt(x)) 的有序结果，直接放在 result 的末尾
+//    （协商了 FEATURE_STRIPE 时结果头仍走主连接，结果本身条带化走数据连接）
+struct WorkerSortSample {
+    uint32_t count;
+};
+
+struct SortSplitter {
+    uint32_t code;
+};
+
+// Op::TREE 协议（头部 begin/end 为收到请求的 worker 自己负责的区间，len 为实际的 Op：SUM/MAX/STATS/SORT）：
+// 头部之后是 TreeHeader 与 count 个 TreeNode，即该 worker 的全部后代，按先序排列；先序下各节点区间首尾相接，
+// 整棵子树覆盖 [begin, 最后一个后代的 end)。worker 把每个孩子的子树原样转发给孩子（孩子没有后代时直接发实际的 Op），
+// 同时计算自己的区间，再合并孩子的结果：应答与对整棵子树区间直接做该 Op 相同
+// （SORT 按帧格式发送，协商了 FEATURE_SHM 时先发空的 ShmNotice）
+struct TreeHeader {
+    uint32_t count;
+};
+
+struct TreeNode {
+    char ip[TREE_IP_MAX];
+    uint16_t port;
+    uint32_t subtree;   // 以该节点为根的子树节点数（含自身），其后代紧跟在它后面
+    uint64_t begin;     // 该节点自己负责的区间
+    uint64_t end;
+};
 #pragma pack(pop)
 //用于展示网络传输损耗的时间
 
 static constexpr uint32_t MAGIC = 0x54435044; // 'DPCT'
 
+// SORT 结果每帧的 float 数（1MB），以及 master 接收环形缓冲的槽位数
+#define SORT_CHUNK (1u << 18)
+#define SORT_RING_SLOTS 4   // TODO：可调整；槽位越多，master 本地排序期间能先收下的数据越多
+
 // ===== shuffle (Fisher–Yates) =====
 //伪随机数生成器
 static inline uint64_t rng_next_u64(uint64_t& s) {
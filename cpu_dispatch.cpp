@@ -0,0 +1,127 @@
+﻿/**
+ * @file cpu_dispatch.cpp
+ * @brief 运行时 CPU 指令集分发实现
+ * * 用 cpuid 检测 CPU 特性，用 xgetbv 确认操作系统已启用对应的寄存器状态，
+ * 再从已编译进来的各 ISA 内核表中选出最高可用的一张。
+ * 本文件按基础指令集编译，不能包含任何 AVX 指令。
+ */
+#include "cpu_dispatch.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+  #include <cpuid.h>
+#endif
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+#define DPC_X86 1
+#endif
+
+#if defined(DPC_X86)
+static void cpuid(uint32_t leaf, uint32_t sub, uint32_t r[4]) {
+#if defined(_MSC_VER)
+    int v[4];
+    __cpuidex(v, (int)leaf, (int)sub);
+    for (int k = 0; k < 4; ++k) r[k] = (uint32_t)v[k];
+#else
+    __cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+// 读取 XCR0：操作系统在上下文切换时保存了哪些寄存器状态
+static uint64_t xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+#endif
+}
+#endif
+
+IsaLevel cpu_detect_isa() {
+#if defined(DPC_X86)
+    uint32_t r[4];
+    cpuid(0, 0, r);
+    const uint32_t max_leaf = r[0];
+
+    cpuid(1, 0, r);
+    const bool sse2 = (r[3] >> 26) & 1;
+    const bool osxsave = (r[2] >> 27) & 1;
+    if (!sse2) return IsaLevel::SCALAR;
+    if (!osxsave || max_leaf < 7) return IsaLevel::SSE2;
+
+    const uint64_t xcr0 = xgetbv0();
+    const bool ymm_state = (xcr0 & 0x6) == 0x6;       // XMM + YMM
+    const bool zmm_state = (xcr0 & 0xE6) == 0xE6;     // 再加 opmask + ZMM 高位
+    const bool avx = (r[2] >> 28) & 1;
+
+    cpuid(7, 0, r);
+    const bool avx2 = (r[1] >> 5) & 1;
+    const bool avx512f = (r[1] >> 16) & 1;
+
+    if (avx512f && avx2 && avx && zmm_state) return IsaLevel::AVX512;
+    if (avx2 && avx && ymm_state) return IsaLevel::AVX2;
+    return IsaLevel::SSE2;
+#else
+    return IsaLevel::SCALAR;
+#endif
+}
+
+const char* isa_name(IsaLevel isa) {
+    switch (isa) {
+    case IsaLevel::SCALAR: return "SCALAR";
+    case IsaLevel::SSE2: return "SSE2";
+    case IsaLevel::AVX2: return "AVX2";
+    case IsaLevel::AVX512: return "AVX512";
+    }
+    return "?";
+}
+
+// 读取 DPC_ISA 环境变量作为上限，未设置时不限制
+static IsaLevel isa_limit_from_env() {
+    const char* v = std::getenv("DPC_ISA");
+    if (!v) return IsaLevel::AVX512;
+    if (std::strcmp(v, "scalar") == 0) return IsaLevel::SCALAR;
+    if (std::strcmp(v, "sse2") == 0) return IsaLevel::SSE2;
+    if (std::strcmp(v, "avx2") == 0) return IsaLevel::AVX2;
+    return IsaLevel::AVX512;
+}
+
+static const CpuKernels* select_kernels() {
+    IsaLevel hw = cpu_detect_isa();
+    IsaLevel lim = isa_limit_from_env();
+    IsaLevel want = ((uint32_t)hw < (uint32_t)lim ? hw : lim);
+
+    // 从高到低找第一个既被 CPU 支持、又编译进来的内核表
+    const CpuKernels* table = nullptr;
+    if (!table && (uint32_t)want >= (uint32_t)IsaLevel::AVX512) table = cpu_kernels_avx512();
+    if (!table && (uint32_t)want >= (uint32_t)IsaLevel::AVX2) table = cpu_kernels_avx2();
+    if (!table && (uint32_t)want >= (uint32_t)IsaLevel::SSE2) table = cpu_kernels_sse2();
+    if (!table) table = cpu_kernels_scalar();
+
+    std::cout << "[CPU] isa detected=" << isa_name(hw) << " selected=" << isa_name(table->isa) << "\n";
+    return table;
+}
+
+const CpuKernels& cpu_kernels() {
+    // 局部静态变量的初始化是线程安全的
+    static const CpuKernels* table = select_kernels();
+    return *table;
+}
+
+// 未编译对应 ISA 的源文件时提供空实现，分发时自动跳过
+#if !defined(HAVE_KERNELS_SSE2)
+const CpuKernels* cpu_kernels_sse2() { return nullptr; }
+#endif
+#if !defined(HAVE_KERNELS_AVX2)
+const CpuKernels* cpu_kernels_avx2() { return nullptr; }
+#endif
+#if !defined(HAVE_KERNELS_AVX512)
+const CpuKernels* cpu_kernels_avx512() { return nullptr; }
+#endif
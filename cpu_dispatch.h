@@ -0,0 +1,93 @@
+﻿/**
+ * @file cpu_dispatch.h
+ * @brief 运行时 CPU 指令集分发模块
+ * * 同一个可执行文件需要运行在指令集不同的机器上，因此 SIMD 内核不再在编译期用 #if 选择，
+ * 而是在启动时通过 cpuid 检测 CPU 支持的最高指令集，并选出对应的一组内核函数指针。
+ * 主要内容：
+ * 1. IsaLevel：标量 / SSE2 / AVX2 / AVX-512 四个级别。
+ * 2. CpuKernels：单线程内核表（sum、max、统计量、排序输出变换等），由各 ISA 的 cpu_kernels_*.cpp 提供。
+ * 3. cpu_kernels()：首次调用时检测并缓存，之后直接返回同一张表。
+ * 环境变量 DPC_ISA（scalar/sse2/avx2/avx512）可以把级别限制得更低，便于在同一台机器上对比各版本。
+ */
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+enum class IsaLevel : uint32_t {
+    SCALAR = 0,
+    SSE2 = 1,
+    AVX2 = 2,
+    AVX512 = 3
+};
+
+// 一段数据经 ln(sqrt(x)) 变换后的统计量（一次遍历得到）
+// - min/max 与 MAX 基线一样忽略 NaN；sum 为双精度累加，NaN/inf 会传播到 sum 与 m2。
+// - m2 为与均值之差的平方和，方差 = m2 / count；分段结果用 Chan/Welford 公式合并（见 StatsReducer）。
+// - argmax 为最大值第一次出现的下标（相对本段起点），不存在（空段或全为 NaN）时为 STATS_NO_INDEX。
+static constexpr uint64_t STATS_NO_INDEX = ~0ULL;
+
+struct StatsResult {
+    uint64_t count;
+    double sum;
+    double m2;
+    float min;
+    float max;
+    uint64_t argmax;
+};
+
+// 确定性求和的分块与定点格式（见 reduce_kernel.h 的 det_sum_range）
+// 块按全局下标对齐：线程与 master/worker 只能在 DET_BLOCK 的整数倍处切分
+#define DET_BLOCK 4096
+static constexpr double DET_SCALE = 16777216.0;    // 2^24，定点量化步长 2^-24
+static constexpr uint32_t DET_SPECIAL_NAN = 1u;
+static constexpr uint32_t DET_SPECIAL_POS_INF = 2u;
+static constexpr uint32_t DET_SPECIAL_NEG_INF = 4u;
+
+// 定点部分和：各块 round(块和 * DET_SCALE) 的整数和，以及块内出现过的 inf/NaN
+struct DetSum {
+    int64_t fixed;
+    uint32_t special;
+};
+
+// 排序键编码：把 float 位模式映射为与 ln(sqrt(x)) 顺序一致的无符号整数（排序与划分内核共用）
+//   ±0（key=-inf）< 正数（位模式随值单调递增，+inf 最大）< NaN 与负数（key=NaN，统一排在最后）。
+static inline uint32_t sort_key_code(float x) {
+    uint32_t u;
+    memcpy(&u, &x, sizeof(u));
+    return u == 0x80000000u ? 0u : u;   // -0 与 +0 的 key 相同
+}
+
+// 单线程内核表：OpenMP 切块由 cpu_ops.h 负责，表中函数只处理一段连续数据
+struct CpuKernels {
+    IsaLevel isa;
+    // ln(sqrt(x)) 求和（向量化 log，双精度累加）
+    double (*sum_log_sqrt)(const float* data, uint64_t n);
+    // ln(sqrt(x)) 求和（尾数连乘 + 指数累加，无 log）
+    double (*sum_log_sqrt_prod)(const float* data, uint64_t n);
+    // ln(sqrt(x)) 确定性求和（float 通道 Kahan + 定点块和），要求 data 从块边界开始
+    DetSum (*sum_log_sqrt_det)(const float* data, uint64_t n);
+    // ln(sqrt(x)) 最大值（逐元素向量化 log）
+    float (*max_log_sqrt)(const float* data, uint64_t n);
+    // 原始值最大值，忽略 NaN（单调变换下推）
+    float (*max_raw)(const float* data, uint64_t n);
+    // ln(sqrt(x)) 的 min/max/sum/m2/argmax，一次遍历
+    StatsResult (*stats_log_sqrt)(const float* data, uint64_t n);
+    // 排序输出：对按 key 有序的原始值做一次 ln(sqrt(x)) 变换，out 可以等于 in
+    void (*transform_log_sqrt)(const float* in, float* out, uint64_t n);
+    // 按 sort_key_code 原地划分（无分支）：[0, k) 的键 < pivot，[k, n) 的键 >= pivot，返回 k
+    uint64_t (*partition_by_code)(float* data, uint64_t n, uint32_t pivot);
+};
+
+// 检测当前 CPU（含操作系统对 YMM/ZMM 状态的支持）可用的最高级别
+IsaLevel cpu_detect_isa();
+
+// 启动时选定的内核表（线程安全，只检测一次）
+const CpuKernels& cpu_kernels();
+
+const char* isa_name(IsaLevel isa);
+
+// 各 ISA 的内核表；对应的 .cpp 未参与编译时返回 nullptr
+const CpuKernels* cpu_kernels_scalar();
+const CpuKernels* cpu_kernels_sse2();
+const CpuKernels* cpu_kernels_avx2();
+const CpuKernels* cpu_kernels_avx512();
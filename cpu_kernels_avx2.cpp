@@ -0,0 +1,112 @@
+﻿/**
+ * @file cpu_kernels_avx2.cpp
+ * @brief AVX2 内核（每步 8 个 float）
+ * * 本文件以 -mavx2（MSVC 为 /arch:AVX2）编译，只在 cpuid 确认支持 AVX2 时被调用。
+ */
+#include "cpu_dispatch.h"
+#include "cpu_kernels_scalar.h"
+#include "reduce_kernel.h"
+#include "simd_log.h"
+
+#include <cmath>
+
+namespace {
+
+__m256 prod_renorm_avx2(__m256 p, __m256i& e) {
+    __m256i pi = _mm256_castps_si256(p);
+    e = _mm256_add_epi32(e, _mm256_sub_epi32(_mm256_srli_epi32(pi, 23), _mm256_set1_epi32(127)));
+    return _mm256_castsi256_ps(_mm256_or_si256(
+        _mm256_and_si256(pi, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000)));
+}
+
+double sum_log_sqrt_prod_avx2(const float* data, uint64_t n) {
+    const __m256i mant = _mm256_set1_epi32(0x007FFFFF);
+    const __m256i one = _mm256_set1_epi32(0x3F800000);
+    const __m256i lo = _mm256_set1_epi32(0x00800000);
+    const __m256i lim = _mm256_set1_epi32(0x7F000000);
+
+    // 4 组独立的乘积累加器隐藏乘法延迟
+    __m256 p0 = _mm256_set1_ps(1.0f), p1 = p0, p2 = p0, p3 = p0;
+    __m256i e32 = _mm256_setzero_si256();              // 块内指数（未减偏置）
+    __m256i e64a = _mm256_setzero_si256(), e64b = e64a; // 跨块累计的 64 位指数
+    int64_t bias = 0;                                   // 已累加的元素个数，每个元素需扣除 127 偏置
+    double slow = 0.0;
+
+    uint64_t b = 0;
+    for (; b + PROD_BLOCK <= n; b += PROD_BLOCK) {
+        const float* x = data + b;
+        __m256 q0 = p0, q1 = p1, q2 = p2, q3 = p3;
+        __m256i eb = _mm256_setzero_si256();
+        __m256i bad = _mm256_setzero_si256();
+        for (int i = 0; i < PROD_BLOCK; i += 32) {
+            __m256i u0 = _mm256_loadu_si256((const __m256i*)(x + i));
+            __m256i u1 = _mm256_loadu_si256((const __m256i*)(x + i + 8));
+            __m256i u2 = _mm256_loadu_si256((const __m256i*)(x + i + 16));
+            __m256i u3 = _mm256_loadu_si256((const __m256i*)(x + i + 24));
+            // 校验：(u - 0x00800000) 无符号 >= 0x7F000000 即非正规格化数
+            __m256i v0 = _mm256_sub_epi32(u0, lo), v1 = _mm256_sub_epi32(u1, lo);
+            __m256i v2 = _mm256_sub_epi32(u2, lo), v3 = _mm256_sub_epi32(u3, lo);
+            bad = _mm256_or_si256(bad, _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(v0, lim), v0),
+                                _mm256_cmpeq_epi32(_mm256_max_epu32(v1, lim), v1)),
+                _mm256_or_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(v2, lim), v2),
+                                _mm256_cmpeq_epi32(_mm256_max_epu32(v3, lim), v3))));
+            // 指数直接累加带偏置的原始指数域，偏置最后统一扣除
+            eb = _mm256_add_epi32(eb, _mm256_add_epi32(
+                _mm256_add_epi32(_mm256_srli_epi32(u0, 23), _mm256_srli_epi32(u1, 23)),
+                _mm256_add_epi32(_mm256_srli_epi32(u2, 23), _mm256_srli_epi32(u3, 23))));
+            q0 = _mm256_mul_ps(q0, _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(u0, mant), one)));
+            q1 = _mm256_mul_ps(q1, _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(u1, mant), one)));
+            q2 = _mm256_mul_ps(q2, _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(u2, mant), one)));
+            q3 = _mm256_mul_ps(q3, _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(u3, mant), one)));
+        }
+        if (!_mm256_testz_si256(bad, bad)) {
+            // 块内有特殊值：丢弃本块的乘积，整块走标量回退
+            slow += scalar_sum_log_sqrt(x, PROD_BLOCK);
+            continue;
+        }
+        p0 = prod_renorm_avx2(q0, e32);
+        p1 = prod_renorm_avx2(q1, e32);
+        p2 = prod_renorm_avx2(q2, e32);
+        p3 = prod_renorm_avx2(q3, e32);
+        e32 = _mm256_add_epi32(e32, eb);
+        bias += PROD_BLOCK;
+        // 每块把 32 位指数并入 64 位累加器，避免大数据量时溢出
+        e64a = _mm256_add_epi64(e64a, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(e32)));
+        e64b = _mm256_add_epi64(e64b, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(e32, 1)));
+        e32 = _mm256_setzero_si256();
+    }
+
+    // 每个通道只做一次 log
+    alignas(32) float pf[4][8];
+    alignas(32) int64_t ea[4], eb4[4];
+    _mm256_store_ps(pf[0], p0); _mm256_store_ps(pf[1], p1);
+    _mm256_store_ps(pf[2], p2); _mm256_store_ps(pf[3], p3);
+    _mm256_store_si256((__m256i*)ea, e64a);
+    _mm256_store_si256((__m256i*)eb4, e64b);
+    double ln_p = 0.0;
+    for (int k = 0; k < 8; ++k) {
+        ln_p += log((double)pf[0][k] * pf[1][k] * pf[2][k] * pf[3][k]);
+    }
+    int64_t e_total = ea[0] + ea[1] + ea[2] + ea[3] + eb4[0] + eb4[1] + eb4[2] + eb4[3] - bias * 127;
+    double s = 0.5 * (ln_p + (double)e_total * LN2_D) + slow;
+    // 不足一个块的尾部走标量版本
+    return s + scalar_sum_log_sqrt_prod(data + b, n - b);
+}
+
+} // namespace
+
+const CpuKernels* cpu_kernels_avx2() {
+    static const CpuKernels k = {
+        IsaLevel::AVX2,
+        reduce_transform<LogSqrtTransform, SumReducer, IsaAvx2>,
+        sum_log_sqrt_prod_avx2,
+        det_sum_range<LogSqrtTransform, IsaAvx2>,
+        reduce_transform<LogSqrtTransform, MaxReducer, IsaAvx2>,
+        reduce_transform<IdentityTransform, MaxReducer, IsaAvx2>,
+        stats_transform_range<LogSqrtTransform, IsaAvx2>,
+        map_transform<LogSqrtTransform, IsaAvx2>,
+        partition_by_code_range<IsaAvx2>,
+    };
+    return &k;
+}
@@ -0,0 +1,104 @@
+﻿/**
+ * @file cpu_kernels_avx512.cpp
+ * @brief AVX-512 内核（每步 16 个 float）
+ * * 本文件以 -mavx512f（MSVC 为 /arch:AVX512）编译，只在 cpuid 确认支持 AVX-512F
+ * 且操作系统启用了 ZMM 状态时被调用。只使用 AVX-512F 指令。
+ * 尾部元素用掩码加载/存储处理，不需要标量收尾。
+ */
+#include "cpu_dispatch.h"
+#include "cpu_kernels_scalar.h"
+#include "reduce_kernel.h"
+#include "simd_log.h"
+
+#include <cmath>
+
+namespace {
+
+__m512 prod_renorm_avx512(__m512 p, __m512i& e) {
+    __m512i pi = _mm512_castps_si512(p);
+    e = _mm512_add_epi32(e, _mm512_sub_epi32(_mm512_srli_epi32(pi, 23), _mm512_set1_epi32(127)));
+    return _mm512_castsi512_ps(_mm512_or_si512(
+        _mm512_and_si512(pi, _mm512_set1_epi32(0x007FFFFF)), _mm512_set1_epi32(0x3F800000)));
+}
+
+// 块长为 AVX2 的两倍：每步 64 个元素，每个累加器仍最多连乘 64 次
+double sum_log_sqrt_prod_avx512(const float* data, uint64_t n) {
+    const __m512i mant = _mm512_set1_epi32(0x007FFFFF);
+    const __m512i one = _mm512_set1_epi32(0x3F800000);
+    const __m512i lo = _mm512_set1_epi32(0x00800000);
+    const __m512i lim = _mm512_set1_epi32(0x7F000000);
+    const uint64_t blk = PROD_BLOCK * 2;
+
+    __m512 p0 = _mm512_set1_ps(1.0f), p1 = p0, p2 = p0, p3 = p0;
+    __m512i e32 = _mm512_setzero_si512();
+    __m512i e64a = _mm512_setzero_si512(), e64b = e64a;
+    int64_t bias = 0;
+    double slow = 0.0;
+
+    uint64_t b = 0;
+    for (; b + blk <= n; b += blk) {
+        const float* x = data + b;
+        __m512 q0 = p0, q1 = p1, q2 = p2, q3 = p3;
+        __m512i eb = _mm512_setzero_si512();
+        __mmask16 bad = 0;
+        for (uint64_t i = 0; i < blk; i += 64) {
+            __m512i u0 = _mm512_loadu_si512((const void*)(x + i));
+            __m512i u1 = _mm512_loadu_si512((const void*)(x + i + 16));
+            __m512i u2 = _mm512_loadu_si512((const void*)(x + i + 32));
+            __m512i u3 = _mm512_loadu_si512((const void*)(x + i + 48));
+            // AVX-512 有无符号比较：(u - 0x00800000) >= 0x7F000000 即非正规格化数
+            bad |= _mm512_cmpge_epu32_mask(_mm512_sub_epi32(u0, lo), lim);
+            bad |= _mm512_cmpge_epu32_mask(_mm512_sub_epi32(u1, lo), lim);
+            bad |= _mm512_cmpge_epu32_mask(_mm512_sub_epi32(u2, lo), lim);
+            bad |= _mm512_cmpge_epu32_mask(_mm512_sub_epi32(u3, lo), lim);
+            eb = _mm512_add_epi32(eb, _mm512_add_epi32(
+                _mm512_add_epi32(_mm512_srli_epi32(u0, 23), _mm512_srli_epi32(u1, 23)),
+                _mm512_add_epi32(_mm512_srli_epi32(u2, 23), _mm512_srli_epi32(u3, 23))));
+            q0 = _mm512_mul_ps(q0, _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(u0, mant), one)));
+            q1 = _mm512_mul_ps(q1, _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(u1, mant), one)));
+            q2 = _mm512_mul_ps(q2, _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(u2, mant), one)));
+            q3 = _mm512_mul_ps(q3, _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(u3, mant), one)));
+        }
+        if (bad) {
+            slow += scalar_sum_log_sqrt(x, blk);
+            continue;
+        }
+        p0 = prod_renorm_avx512(q0, e32);
+        p1 = prod_renorm_avx512(q1, e32);
+        p2 = prod_renorm_avx512(q2, e32);
+        p3 = prod_renorm_avx512(q3, e32);
+        e32 = _mm512_add_epi32(e32, eb);
+        bias += (int64_t)blk;
+        e64a = _mm512_add_epi64(e64a, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(e32)));
+        e64b = _mm512_add_epi64(e64b, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(e32, 1)));
+        e32 = _mm512_setzero_si512();
+    }
+
+    alignas(64) float pf[4][16];
+    _mm512_store_ps(pf[0], p0); _mm512_store_ps(pf[1], p1);
+    _mm512_store_ps(pf[2], p2); _mm512_store_ps(pf[3], p3);
+    double ln_p = 0.0;
+    for (int k = 0; k < 16; ++k) {
+        ln_p += log((double)pf[0][k] * pf[1][k] * pf[2][k] * pf[3][k]);
+    }
+    int64_t e_total = _mm512_reduce_add_epi64(_mm512_add_epi64(e64a, e64b)) - bias * 127;
+    double s = 0.5 * (ln_p + (double)e_total * LN2_D) + slow;
+    return s + scalar_sum_log_sqrt_prod(data + b, n - b);
+}
+
+} // namespace
+
+const CpuKernels* cpu_kernels_avx512() {
+    static const CpuKernels k = {
+        IsaLevel::AVX512,
+        reduce_transform<LogSqrtTransform, SumReducer, IsaAvx512>,
+        sum_log_sqrt_prod_avx512,
+        det_sum_range<LogSqrtTransform, IsaAvx512>,
+        reduce_transform<LogSqrtTransform, MaxReducer, IsaAvx512>,
+        reduce_transform<IdentityTransform, MaxReducer, IsaAvx512>,
+        stats_transform_range<LogSqrtTransform, IsaAvx512>,
+        map_transform<LogSqrtTransform, IsaAvx512>,
+        partition_by_code_range<IsaAvx512>,
+    };
+    return &k;
+}
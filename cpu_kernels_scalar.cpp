@@ -0,0 +1,92 @@
+﻿/**
+ * @file cpu_kernels_scalar.cpp
+ * @brief 标量内核（任何 CPU 都可运行的兜底实现）
+ * * 同时导出标量辅助函数，供各 SIMD 内核处理尾部元素和特殊值回退。
+ * 本文件按基础指令集编译。
+ */
+#include "cpu_dispatch.h"
+#include "cpu_kernels_scalar.h"
+#include "reduce_kernel.h"
+
+#include <cmath>
+#include <cstring>
+
+double scalar_sum_log_sqrt(const float* data, uint64_t n) {
+    return reduce_transform<LogSqrtTransform, SumReducer, IsaScalar>(data, n);
+}
+
+float scalar_max_log_sqrt(const float* data, uint64_t n) {
+    return reduce_transform<LogSqrtTransform, MaxReducer, IsaScalar>(data, n);
+}
+
+float scalar_max_raw(const float* data, uint64_t n) {
+    return reduce_transform<IdentityTransform, MaxReducer, IsaScalar>(data, n);
+}
+
+// 无分支 Lomuto 划分：每个元素都与写指针处交换，写指针只在键 < pivot 时前进
+uint64_t scalar_partition_by_code(float* data, uint64_t n, uint32_t pivot) {
+    uint64_t k = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        const float x = data[i];
+        data[i] = data[k];
+        data[k] = x;
+        k += (sort_key_code(x) < pivot);
+    }
+    return k;
+}
+
+// 标量版乘积累加：逐元素拆分指数/尾数，与 SIMD 版本使用相同的块与回退规则
+double scalar_sum_log_sqrt_prod(const float* data, uint64_t n) {
+    double p = 1.0;         // 跨块的尾数乘积，落在 (0, 1] 区间，过小时并入 ln_p
+    int64_t e_total = 0;
+    double ln_p = 0.0;
+    double slow = 0.0;
+    for (uint64_t b = 0; b < n; b += PROD_BLOCK) {
+        uint64_t len = (n - b < PROD_BLOCK ? n - b : PROD_BLOCK);
+        const float* x = data + b;
+        int64_t e_blk = 0;
+        double p_blk = 1.0;
+        bool ok = true;
+        for (uint64_t i = 0; i < len; ++i) {
+            uint32_t u;
+            memcpy(&u, &x[i], sizeof(u));
+            // 正的规格化数：指数域在 [1, 254] 且符号位为 0
+            if (u - 0x00800000u >= 0x7F000000u) { ok = false; break; }
+            uint32_t mu = (u & 0x007FFFFFu) | 0x3F800000u;
+            float m;
+            memcpy(&m, &mu, sizeof(m));
+            p_blk *= m;
+            e_blk += (int64_t)(u >> 23) - 127;
+            // 每 512 次乘法规格化一次，保证 double 乘积不溢出
+            if ((i & 511) == 511) {
+                int e;
+                p_blk = frexp(p_blk, &e);
+                e_blk += e;
+            }
+        }
+        if (!ok) { slow += scalar_sum_log_sqrt(x, len); continue; }
+        // 规格化：把块乘积的指数并入整数累加器
+        int e;
+        p_blk = frexp(p_blk, &e);
+        e_total += e_blk + e;
+        p *= p_blk;
+        if (p < 1e-200) { ln_p += log(p); p = 1.0; }
+    }
+    ln_p += log(p);
+    return 0.5 * (ln_p + (double)e_total * LN2_D) + slow;
+}
+
+const CpuKernels* cpu_kernels_scalar() {
+    static const CpuKernels k = {
+        IsaLevel::SCALAR,
+        scalar_sum_log_sqrt,
+        scalar_sum_log_sqrt_prod,
+        det_sum_range<LogSqrtTransform, IsaScalar>,
+        scalar_max_log_sqrt,
+        scalar_max_raw,
+        stats_transform_range<LogSqrtTransform, IsaScalar>,
+        map_transform<LogSqrtTransform, IsaScalar>,
+        scalar_partition_by_code,
+    };
+    return &k;
+}
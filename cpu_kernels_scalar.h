@@ -0,0 +1,20 @@
+﻿/**
+ * @file cpu_kernels_scalar.h
+ * @brief 标量辅助函数声明（内核内部使用）
+ * * 这些函数在按基础指令集编译的 cpu_kernels_scalar.cpp 中实现，
+ * 各 SIMD 内核通过普通函数调用使用它们处理尾部元素与特殊值回退，
+ * 避免在 AVX 翻译单元里生成可能被其它代码共用的标量代码副本。
+ */
+#pragma once
+#include <cstdint>
+
+// 乘积累加引擎的块长：每块结束时把乘积重新规格化
+#define PROD_BLOCK 2048
+
+static constexpr double LN2_D = 0.69314718055994530942;
+
+double scalar_sum_log_sqrt(const float* data, uint64_t n);
+double scalar_sum_log_sqrt_prod(const float* data, uint64_t n);
+float scalar_max_log_sqrt(const float* data, uint64_t n);
+float scalar_max_raw(const float* data, uint64_t n);
+uint64_t scalar_partition_by_code(float* data, uint64_t n, uint32_t pivot);
@@ -0,0 +1,105 @@
+﻿/**
+ * @file cpu_kernels_sse2.cpp
+ * @brief SSE2 内核（每步 4 个 float）
+ * * 本文件以 SSE2 编译（x64 默认即包含 SSE2），只在 cpuid 确认支持时被调用。
+ */
+#include "cpu_dispatch.h"
+#include "cpu_kernels_scalar.h"
+#include "reduce_kernel.h"
+#include "simd_log.h"
+
+#include <cmath>
+
+namespace {
+
+__m128 prod_renorm_sse(__m128 p, __m128i& e) {
+    __m128i pi = _mm_castps_si128(p);
+    e = _mm_add_epi32(e, _mm_sub_epi32(_mm_srli_epi32(pi, 23), _mm_set1_epi32(127)));
+    return _mm_castsi128_ps(_mm_or_si128(
+        _mm_and_si128(pi, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+}
+
+double sum_log_sqrt_prod_sse2(const float* data, uint64_t n) {
+    const __m128i mant = _mm_set1_epi32(0x007FFFFF);
+    const __m128i one = _mm_set1_epi32(0x3F800000);
+    const __m128i lo = _mm_set1_epi32(0x00800000);
+    // SSE2 没有无符号比较：翻转符号位后用有符号比较，v >= 0x7F000000（无符号）即非法
+    const __m128i flip = _mm_set1_epi32((int)0x80000000u);
+    const __m128i lim = _mm_set1_epi32((int)(0x7F000000u ^ 0x80000000u) - 1);
+
+    __m128 p0 = _mm_set1_ps(1.0f), p1 = p0, p2 = p0, p3 = p0;
+    __m128i e32 = _mm_setzero_si128();
+    int64_t e_total = 0;
+    int64_t bias = 0;
+    double slow = 0.0;
+
+    // SSE 每步只处理 16 个元素，块长减半，保证每个累加器仍最多连乘 64 次
+    const uint64_t blk = PROD_BLOCK / 2;
+    uint64_t b = 0;
+    for (; b + blk <= n; b += blk) {
+        const float* x = data + b;
+        __m128 q0 = p0, q1 = p1, q2 = p2, q3 = p3;
+        __m128i eb = _mm_setzero_si128();
+        __m128i bad = _mm_setzero_si128();
+        for (uint64_t i = 0; i < blk; i += 16) {
+            __m128i u0 = _mm_loadu_si128((const __m128i*)(x + i));
+            __m128i u1 = _mm_loadu_si128((const __m128i*)(x + i + 4));
+            __m128i u2 = _mm_loadu_si128((const __m128i*)(x + i + 8));
+            __m128i u3 = _mm_loadu_si128((const __m128i*)(x + i + 12));
+            bad = _mm_or_si128(bad, _mm_or_si128(
+                _mm_or_si128(_mm_cmpgt_epi32(_mm_xor_si128(_mm_sub_epi32(u0, lo), flip), lim),
+                             _mm_cmpgt_epi32(_mm_xor_si128(_mm_sub_epi32(u1, lo), flip), lim)),
+                _mm_or_si128(_mm_cmpgt_epi32(_mm_xor_si128(_mm_sub_epi32(u2, lo), flip), lim),
+                             _mm_cmpgt_epi32(_mm_xor_si128(_mm_sub_epi32(u3, lo), flip), lim))));
+            eb = _mm_add_epi32(eb, _mm_add_epi32(
+                _mm_add_epi32(_mm_srli_epi32(u0, 23), _mm_srli_epi32(u1, 23)),
+                _mm_add_epi32(_mm_srli_epi32(u2, 23), _mm_srli_epi32(u3, 23))));
+            q0 = _mm_mul_ps(q0, _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(u0, mant), one)));
+            q1 = _mm_mul_ps(q1, _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(u1, mant), one)));
+            q2 = _mm_mul_ps(q2, _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(u2, mant), one)));
+            q3 = _mm_mul_ps(q3, _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(u3, mant), one)));
+        }
+        if (_mm_movemask_epi8(bad) != 0) {
+            slow += scalar_sum_log_sqrt(x, blk);
+            continue;
+        }
+        p0 = prod_renorm_sse(q0, e32);
+        p1 = prod_renorm_sse(q1, e32);
+        p2 = prod_renorm_sse(q2, e32);
+        p3 = prod_renorm_sse(q3, e32);
+        e32 = _mm_add_epi32(e32, eb);
+        bias += (int64_t)blk;
+        alignas(16) int32_t e4[4];
+        _mm_store_si128((__m128i*)e4, e32);
+        e_total += (int64_t)e4[0] + e4[1] + e4[2] + e4[3];
+        e32 = _mm_setzero_si128();
+    }
+
+    alignas(16) float pf[4][4];
+    _mm_store_ps(pf[0], p0); _mm_store_ps(pf[1], p1);
+    _mm_store_ps(pf[2], p2); _mm_store_ps(pf[3], p3);
+    double ln_p = 0.0;
+    for (int k = 0; k < 4; ++k) {
+        ln_p += log((double)pf[0][k] * pf[1][k] * pf[2][k] * pf[3][k]);
+    }
+    e_total -= bias * 127;
+    double s = 0.5 * (ln_p + (double)e_total * LN2_D) + slow;
+    return s + scalar_sum_log_sqrt_prod(data + b, n - b);
+}
+
+} // namespace
+
+const CpuKernels* cpu_kernels_sse2() {
+    static const CpuKernels k = {
+        IsaLevel::SSE2,
+        reduce_transform<LogSqrtTransform, SumReducer, IsaSse2>,
+        sum_log_sqrt_prod_sse2,
+        det_sum_range<LogSqrtTransform, IsaSse2>,
+        reduce_transform<LogSqrtTransform, MaxReducer, IsaSse2>,
+        reduce_transform<IdentityTransform, MaxReducer, IsaSse2>,
+        stats_transform_range<LogSqrtTransform, IsaSse2>,
+        map_transform<LogSqrtTransform, IsaSse2>,
+        scalar_partition_by_code,       // SSE2 没有通道重排指令（pshufb 需 SSSE3），沿用标量无分支划分
+    };
+    return &k;
+}
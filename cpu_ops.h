@@ -4,25 +4,16 @@
  * * 该文件提供了针对 float 数据逐个计算 ln(sqrt(x)) 后的基础聚合操作实现。
  * 包含单机版的求和 (sum) 和求最大值 (max) 函数。
  * 这些函数是 Master 和 Worker 节点进行本地计算时的底层核心逻辑。
+ * SIMD 内核在运行时按 CPU 指令集分发（见 cpu_dispatch.h），本文件只负责 OpenMP 切块与引擎选择。
  */
 #pragma once
 #include <cmath>
 #include <cstdint>
-
-// ===== SSE/AVX2 (SIMD) support =====
-// AVX2 processes 8 floats per step, SSE processes 4; logf stays scalar.
-
-#if defined(USE_SSE)
-  #if defined(_MSC_VER)
-    #include <intrin.h>
-  #endif
-  #include <immintrin.h>
-#endif
-
-//OpenMP 支持
-#ifdef USE_OPENMP
-#include <omp.h>
-#endif
+#include <cstring>
+#include "cpu_dispatch.h"
+#include "range_gen.h"
+#include "reduce_kernel.h"
+#include "simd_log.h"
 
 // 计算 log(sqrt(x)) 的总和
 // 说明：逐个元素先开方再取对数，并把结果累加到双精度变量中以减少精度损失。
@@ -53,285 +44,256 @@ inline float cpu_max_log_sqrt(const float* data, uint64_t n) {
     return m;
 }
 
-// ===== SSE/AVX2 version (for SpeedUp path) =====
-// 说明：sqrt 使用 SIMD（AVX2 每次 8 个元素或 SSE 每次 4 个元素）并行计算，
-// logf 仍保持标量逐个计算，以保证与基线版本的数值一致性。
+// ===== SIMD version (for SpeedUp path) =====
+// 说明：开方与取对数一起在 SIMD 寄存器内完成（直接计算 0.5*ln(x)），不再回落到标量 logf；
+// 误差说明见 simd_log.h。具体使用 SSE2/AVX2/AVX-512 哪个版本由 cpu_kernels() 在启动时决定，
+// 函数名保留 _sse 后缀以兼容已有调用。求和仍使用双精度累加。
+
 inline float cpu_sum_log_sqrt_sse(const float* data, uint64_t n) {
-#if defined(USE_SSE) && defined(USE_AVX2)
-    double s = 0.0;
-    uint64_t i = 0;
-    alignas(32) float buf[8];
-
-    for (; i + 8 <= n; i += 8) {
-        // 从内存加载 8 个 float 到 AVX 寄存器
-        __m256 x = _mm256_loadu_ps(data + i);
-        // 对 8 个元素并行开方
-        __m256 r = _mm256_sqrt_ps(x);
-        // 将结果存回对齐缓冲区，便于标量 logf 处理
-        _mm256_store_ps(buf, r);
-        // 逐个计算 logf 并累加
-        s += logf(buf[0]) + logf(buf[1]) + logf(buf[2]) + logf(buf[3]) +
-             logf(buf[4]) + logf(buf[5]) + logf(buf[6]) + logf(buf[7]);
-    }
-    // 处理剩余不足 8 个的尾部元素
-    for (; i < n; ++i) s += logf(sqrtf(data[i]));
-    return (float)s;
-#elif defined(USE_SSE)
-    double s = 0.0;
-    uint64_t i = 0;
-    alignas(16) float buf[4];
-
-    for (; i + 4 <= n; i += 4) {
-        // 从内存加载 4 个 float 到 SSE 寄存器
-        __m128 x = _mm_loadu_ps(data + i);
-        // 对 4 个元素并行开方
-        __m128 r = _mm_sqrt_ps(x);
-        // 将结果存回对齐缓冲区，便于标量 logf 处理
-        _mm_store_ps(buf, r);
-        // 逐个计算 logf 并累加
-        s += logf(buf[0]) + logf(buf[1]) + logf(buf[2]) + logf(buf[3]);
-    }
-    // 处理剩余不足 4 个的尾部元素
-    for (; i < n; ++i) s += logf(sqrtf(data[i]));
-    return (float)s;
-#else
-    return cpu_sum_log_sqrt(data, n);
-#endif
+    return (float)cpu_kernels().sum_log_sqrt(data, n);
 }
 
 inline float cpu_max_log_sqrt_sse(const float* data, uint64_t n) {
-#if defined(USE_SSE) && defined(USE_AVX2)
-    float m = -INFINITY;
-    uint64_t i = 0;
-    alignas(32) float buf[8];
-
-    for (; i + 8 <= n; i += 8) {
-        // 从内存加载 8 个 float 到 AVX 寄存器
-        __m256 x = _mm256_loadu_ps(data + i);
-        // 对 8 个元素并行开方
-        __m256 r = _mm256_sqrt_ps(x);
-        // 将结果存回对齐缓冲区，便于标量 logf 处理
-        _mm256_store_ps(buf, r);
-        for (int k = 0; k < 8; ++k) {
-            // 逐个计算 logf，并更新局部最大值
-            float v = logf(buf[k]);
-            m = (v > m ? v : m);
-        }
-    }
-    // 处理剩余不足 8 个的尾部元素
-    for (; i < n; ++i) {
-        float v = logf(sqrtf(data[i]));
-        m = (v > m ? v : m);
-    }
-    return m;
-#elif defined(USE_SSE)
-    float m = -INFINITY;
-    uint64_t i = 0;
-    alignas(16) float buf[4];
-
-    for (; i + 4 <= n; i += 4) {
-        // 从内存加载 4 个 float 到 SSE 寄存器
-        __m128 x = _mm_loadu_ps(data + i);
-        // 对 4 个元素并行开方
-        __m128 r = _mm_sqrt_ps(x);
-        // 将结果存回对齐缓冲区，便于标量 logf 处理
-        _mm_store_ps(buf, r);
-        for (int k = 0; k < 4; ++k) {
-            // 逐个计算 logf，并更新局部最大值
-            float v = logf(buf[k]);
-            m = (v > m ? v : m);
-        }
-    }
-    // 处理剩余不足 4 个的尾部元素
-    for (; i < n; ++i) {
-        float v = logf(sqrtf(data[i]));
-        m = (v > m ? v : m);
-    }
-    return m;
-#else
-    return cpu_max_log_sqrt(data, n);
-#endif
+    return cpu_kernels().max_log_sqrt(data, n);
 }
 
 // -------------------- OpenMP + SIMD (same function uses both) --------------------
 // 设计说明：
-// - OpenMP：把外层循环按块分配给多个线程并行执行。
-// - SIMD：每个线程内部用 AVX2/SSE 对元素并行开方。
-// - logf：仍使用标量逐个计算，保证与基线结果一致。
-// - 尾部处理：当 n 不是 8/4 的整数倍时，剩余元素使用标量串行处理。
+// - OpenMP：把数据按线程静态切成连续的一段（与 schedule(static) 相同的划分方式）。
+// - SIMD：每个线程对自己的一段调用分发得到的单线程内核，结果留在寄存器中累加/取最大。
+// - 每个线程的部分结果写入独占缓存行的槽位，并行区结束后按线程号顺序合并（无锁，见 reduce_kernel.h 的 OmpThreads）。
 
 inline float cpu_sum_log_sqrt_sse_omp(const float* data, uint64_t n) {
-#if defined(USE_OPENMP)
-    double sum = 0.0;
-
-#if defined(USE_SSE) && defined(USE_AVX2)
-    const uint64_t n8 = (n / 8) * 8;
-#pragma omp parallel for reduction(+:sum) schedule(static)
-    for (long long i = 0; i < (long long)n8; i += 8) {
-        // 并行线程内：加载 8 个元素并行开方
-        __m256 x = _mm256_loadu_ps(data + i);
-        __m256 r = _mm256_sqrt_ps(x);
-
-        alignas(32) float buf[8];
-        // 将开方结果写回缓冲，便于标量 logf
-        _mm256_store_ps(buf, r);
-
-        // 每个线程累加本地的 logf 结果，OpenMP 负责归约到 sum
-        sum += logf(buf[0]) + logf(buf[1]) + logf(buf[2]) + logf(buf[3]) +
-               logf(buf[4]) + logf(buf[5]) + logf(buf[6]) + logf(buf[7]);
-    }
+    return (float)reduce_with<SumReducer, OmpThreads>(cpu_kernels().sum_log_sqrt, data, n);
+}
+
+inline float cpu_max_log_sqrt_sse_omp(const float* data, uint64_t n) {
+    return reduce_with<MaxReducer, OmpThreads>(cpu_kernels().max_log_sqrt, data, n);
+}
 
-    // 处理尾部元素（不足 8 个的部分）
-    for (uint64_t i = n8; i < n; ++i) sum += logf(sqrtf(data[i]));
-    return (float)sum;
+// -------------------- 单调变换下推 (MAX) --------------------
+// 设计说明：
+// - 变换单调递增时，max(f(x_i)) = f(max(x_i))，因此先对原始值做纯 SIMD 最大值（无 log，只受内存带宽限制），
+//   最后只对胜者做一次变换；非单调变换才逐元素求 f(x)。
+// - 原始值最大值忽略 NaN，非正数的回退见 LogSqrtTransform::from_raw_max。
 
-#elif defined(USE_SSE)
-    const uint64_t n4 = (n / 4) * 4;
-#pragma omp parallel for reduction(+:sum) schedule(static)
-    for (long long i = 0; i < (long long)n4; i += 4) {
-        // 并行线程内：加载 4 个元素并行开方
-        __m128 x = _mm_loadu_ps(data + i);
-        __m128 r = _mm_sqrt_ps(x);
+inline float cpu_max_raw_sse(const float* data, uint64_t n) {
+    return cpu_kernels().max_raw(data, n);
+}
 
-        alignas(16) float buf[4];
-        // 将开方结果写回缓冲，便于标量 logf
-        _mm_store_ps(buf, r);
+inline float cpu_max_raw_sse_omp(const float* data, uint64_t n) {
+    return reduce_with<MaxReducer, OmpThreads>(cpu_kernels().max_raw, data, n);
+}
 
-        // 每个线程累加本地的 logf 结果，OpenMP 负责归约到 sum
-        sum += logf(buf[0]) + logf(buf[1]) + logf(buf[2]) + logf(buf[3]);
+// 按变换类型选择执行方式（编译期判定）
+template <class Transform>
+inline float cpu_max_transformed_omp(const float* data, uint64_t n) {
+    if constexpr (Transform::monotone_increasing) {
+        return Transform::from_raw_max(cpu_max_raw_sse_omp(data, n));
+    }
+    else {
+        // 非单调变换：逐元素变换后取最大值（标量特征，变换只需提供 vapply<IsaScalar>）
+        return reduce_transform<Transform, MaxReducer, IsaScalar, OmpThreads>(data, n);
     }
+}
 
-    // 处理尾部元素（不足 4 个的部分）
-    for (uint64_t i = n4; i < n; ++i) sum += logf(sqrtf(data[i]));
-    return (float)sum;
+// -------------------- 多统计量 (STATS) --------------------
+// 一次遍历得到 ln(sqrt(x)) 的 min/max/sum/均值/方差/argmax，避免按 SUM、MAX 分别读取数据。
 
-#else
-#pragma omp parallel for reduction(+:sum) schedule(static)
-    for (long long i = 0; i < (long long)n; ++i) {
-        // 没有 SIMD 时，直接标量计算并由 OpenMP 归约
-        sum += logf(sqrtf(data[i]));
+// 标量基线：逐元素 Welford 更新
+inline StatsResult cpu_stats_log_sqrt(const float* data, uint64_t n) {
+    StatsResult r = stats_identity();
+    double mean = 0.0;
+    for (uint64_t i = 0; i < n; ++i) {
+        float v = logf(sqrtf(data[i]));
+        r.count++;
+        r.sum += v;
+        double d = (double)v - mean;
+        mean += d / (double)r.count;
+        r.m2 += d * ((double)v - mean);
+        r.min = (v < r.min ? v : r.min);
+        if (v > r.max || (v == r.max && r.argmax == STATS_NO_INDEX)) {
+            r.max = v;
+            r.argmax = i;
+        }
     }
-    return (float)sum;
-#endif
+    return r;
+}
 
-#else
-#if defined(USE_SSE)
-    return cpu_sum_log_sqrt_sse(data, n);
-#else
-    return cpu_sum_log_sqrt(data, n);
-#endif
-#endif
+// SIMD + OpenMP：每个线程一段，段内结果的 argmax 平移为全局下标后按线程顺序合并
+inline StatsResult cpu_stats_log_sqrt_omp(const float* data, uint64_t n) {
+    auto kernel = cpu_kernels().stats_log_sqrt;
+    return OmpThreads::run<StatsReducer>(n, [kernel, data](uint64_t b, uint64_t e) {
+        StatsResult r = kernel(data + b, e - b);
+        stats_offset(r, b);
+        return r;
+    });
 }
 
-inline float cpu_max_log_sqrt_sse_omp(const float* data, uint64_t n) {
+// -------------------- 变换输出 (SORT 的最后一步) --------------------
+// 对已按 key 排好序的原始值做一次 ln(sqrt(x)) 变换，out 可以与 in 相同（原地变换）。
+inline void transform_log_sqrt_sse_omp(const float* in, float* out, uint64_t n) {
+    auto kernel = cpu_kernels().transform_log_sqrt;
 #if defined(USE_OPENMP)
-    float global_max = -INFINITY;
-
-#if defined(USE_SSE) && defined(USE_AVX2)
-    const uint64_t n8 = (n / 8) * 8;
-
 #pragma omp parallel
+#endif
     {
-        // 每个线程维护自己的局部最大值，避免频繁竞争
-        float local_max = -INFINITY;
-
-#pragma omp for schedule(static) nowait
-        for (long long i = 0; i < (long long)n8; i += 8) {
-            // 并行线程内：加载 8 个元素并行开方
-            __m256 x = _mm256_loadu_ps(data + i);
-            __m256 r = _mm256_sqrt_ps(x);
-
-            alignas(32) float buf[8];
-            // 将开方结果写回缓冲，便于标量 logf
-            _mm256_store_ps(buf, r);
-
-            for (int k = 0; k < 8; ++k) {
-                // 逐个计算 logf，并更新线程内最大值
-                float v = logf(buf[k]);
-                local_max = (v > local_max ? v : local_max);
-            }
-        }
-
-#pragma omp critical
-        {
-            // 合并线程内最大值到全局最大值
-            global_max = (local_max > global_max ? local_max : global_max);
-        }
+        uint64_t b, e;
+        omp_static_range(n, b, e);
+        kernel(in + b, out + b, e - b);
     }
+}
 
-    // 处理尾部元素（不足 8 个的部分），直接更新全局最大值
-    for (uint64_t i = n8; i < n; ++i) {
-        float v = logf(sqrtf(data[i]));
-        global_max = (v > global_max ? v : global_max);
-    }
-    return global_max;
+// -------------------- 无 log 求和 (乘积累加引擎) --------------------
+// 设计说明：
+// - sum(ln(sqrt(x_i))) = 0.5 * ln(prod x_i)。把每个 x 拆成 m * 2^e（m 在 [1,2)），
+//   尾数 m 在 SIMD 通道内连乘，指数 e 用整数单独累加，循环内完全没有 log。
+// - 每处理一个块（PROD_BLOCK 个元素，每个累加器最多连乘 64 次，乘积 < 2^64）就把乘积重新规格化
+//   （类似 frexp：乘积的指数并入整数累加器，尾数重置回 [1,2)），因此不会溢出。
+// - 快速路径只接受正的规格化数；块内出现 0、负数、次正规数、inf 或 NaN 时，整个块退回
+//   scalar_sum_log_sqrt（标量多项式 log_sqrt_ss，双精度累加），特殊值语义与基线的 logf 一致。
+// - 最后每个通道只做一次 log：ln(P) + E*ln2。
+// 精度：每次 float 乘法给 ln(P) 带来 <= 2^-24 的绝对误差，随机情况下总误差约 sqrt(n) * 3e-8，
+// 默认 1.28e8 个元素时约 1e-4，远小于 float 结果本身的 ULP（见 master 启动时打印的精度报告）。
+// 各 ISA 的实现见 cpu_kernels_*.cpp。
+
+inline float cpu_sum_log_sqrt_prod(const float* data, uint64_t n) {
+    return (float)cpu_kernels().sum_log_sqrt_prod(data, n);
+}
 
-#elif defined(USE_SSE)
-    const uint64_t n4 = (n / 4) * 4;
+inline float cpu_sum_log_sqrt_prod_omp(const float* data, uint64_t n) {
+    return (float)reduce_with<SumReducer, OmpThreads>(cpu_kernels().sum_log_sqrt_prod, data, n);
+}
 
-#pragma omp parallel
-    {
-        // 每个线程维护自己的局部最大值，避免频繁竞争
-        float local_max = -INFINITY;
-
-#pragma omp for schedule(static) nowait
-        for (long long i = 0; i < (long long)n4; i += 4) {
-            // 并行线程内：加载 4 个元素并行开方
-            __m128 x = _mm_loadu_ps(data + i);
-            __m128 r = _mm_sqrt_ps(x);
-
-            alignas(16) float buf[4];
-            // 将开方结果写回缓冲，便于标量 logf
-            _mm_store_ps(buf, r);
-
-            for (int k = 0; k < 4; ++k) {
-                // 逐个计算 logf，并更新线程内最大值
-                float v = logf(buf[k]);
-                local_max = (v > local_max ? v : local_max);
-            }
-        }
+// -------------------- 确定性求和 --------------------
+// 结果与线程数、master/worker 切分位置、所用 ISA 无关（算法见 reduce_kernel.h 的 det_sum_range）。
+// 线程按 DET_BLOCK 块切分，每个线程返回定点部分和，整数相加后顺序无关；审计结果时也可以保持多线程。
+
+inline DetSum cpu_sum_log_sqrt_det_omp(const float* data, uint64_t n) {
+    auto kernel = cpu_kernels().sum_log_sqrt_det;
+    const uint64_t blocks = (n + DET_BLOCK - 1) / DET_BLOCK;
+    return OmpThreads::run<DetSumReducer>(blocks, [kernel, data, n](uint64_t b, uint64_t e) {
+        const uint64_t lo = b * DET_BLOCK;
+        const uint64_t hi = (e * DET_BLOCK < n ? e * DET_BLOCK : n);
+        return lo < hi ? kernel(data + lo, hi - lo) : det_identity();
+    });
+}
 
-#pragma omp critical
-        {
-            // 合并线程内最大值到全局最大值
-            global_max = (local_max > global_max ? local_max : global_max);
-        }
+inline float cpu_sum_log_sqrt_det(const float* data, uint64_t n) {
+    return (float)det_value(cpu_sum_log_sqrt_det_omp(data, n));
+}
+
+// -------------------- SUM 引擎选择 --------------------
+enum class SumEngine : uint32_t {
+    SCALAR = 0,     // cpu_sum_log_sqrt：基线，逐元素 logf
+    SSE = 1,        // cpu_sum_log_sqrt_sse：向量化 log，单线程
+    SSE_OMP = 2,    // cpu_sum_log_sqrt_sse_omp：向量化 log + OpenMP
+    PROD_OMP = 3,   // cpu_sum_log_sqrt_prod_omp：尾数连乘 + 指数累加，无 log
+    DET_OMP = 4     // cpu_sum_log_sqrt_det：确定性求和，结果与线程数/切分/ISA 无关
+};
+
+// master/worker 使用的 SUM 引擎：默认保持原有的向量化 log 路径，PROD_OMP / DET_OMP 需显式选择
+static constexpr SumEngine SUM_ENGINE = SumEngine::SSE_OMP;   // TODO：可切换 SUM 引擎（PROD_OMP 更快、误差更小，但块内遇到特殊值时整块退回标量路径）
+
+static inline const char* sum_engine_name(SumEngine e) {
+    switch (e) {
+    case SumEngine::SCALAR: return "SCALAR";
+    case SumEngine::SSE: return "SSE";
+    case SumEngine::SSE_OMP: return "SSE_OMP";
+    case SumEngine::PROD_OMP: return "PROD_OMP";
+    case SumEngine::DET_OMP: return "DET_OMP";
     }
+    return "?";
+}
 
-    // 处理尾部元素（不足 4 个的部分），直接更新全局最大值
-    for (uint64_t i = n4; i < n; ++i) {
-        float v = logf(sqrtf(data[i]));
-        global_max = (v > global_max ? v : global_max);
+inline float cpu_sum_log_sqrt_engine(SumEngine e, const float* data, uint64_t n) {
+    switch (e) {
+    case SumEngine::SCALAR: return cpu_sum_log_sqrt(data, n);
+    case SumEngine::SSE: return cpu_sum_log_sqrt_sse(data, n);
+    case SumEngine::SSE_OMP: return cpu_sum_log_sqrt_sse_omp(data, n);
+    case SumEngine::PROD_OMP: return cpu_sum_log_sqrt_prod_omp(data, n);
+    case SumEngine::DET_OMP: return cpu_sum_log_sqrt_det(data, n);
     }
-    return global_max;
+    return cpu_sum_log_sqrt(data, n);
+}
 
-#else
-#pragma omp parallel
-    {
-        // 每个线程维护自己的局部最大值，避免频繁竞争
-        float local_max = -INFINITY;
-
-#pragma omp for schedule(static) nowait
-        for (long long i = 0; i < (long long)n; ++i) {
-            // 直接标量计算并更新线程内最大值
-            float v = logf(sqrtf(data[i]));
-            local_max = (v > local_max ? v : local_max);
+// -------------------- 生成器融合 (不物化数组) --------------------
+// 设计说明：
+// - 线程按 GEN_TILE 块静态切分 [begin, end)，每块先由 RangeGenerator 写到线程栈上的 L1 缓冲区，
+//   立即交给分发得到的单线程内核；块结果按 Reducer 合并，各线程结果仍按线程号顺序合并。
+// - 块从 begin 起按 GEN_TILE 对齐，且 GEN_TILE == DET_BLOCK，因此确定性求和与物化数组时逐位一致。
+// - 数据只在 L1 中存在一次，内存占用为 O(线程数)，没有大数组的分配与缺页。
+
+static_assert(GEN_TILE % DET_BLOCK == 0, "GEN_TILE must be a multiple of DET_BLOCK");
+
+// kernel(tile, cnt, off)：off 为该块相对 begin 的偏移
+template <class Reducer, class Kernel>
+inline typename Reducer::result_type gen_reduce_omp(const RangeGenerator& g, uint64_t begin, uint64_t end, Kernel kernel) {
+    using R = typename Reducer::result_type;
+    const uint64_t n = end - begin;
+    const uint64_t tiles = (n + GEN_TILE - 1) / GEN_TILE;
+    return OmpThreads::run<Reducer>(tiles, [&g, &kernel, begin, n](uint64_t tb, uint64_t te) {
+        alignas(64) float tile[GEN_TILE];
+        R r = Reducer::identity();
+        for (uint64_t t = tb; t < te; ++t) {
+            const uint64_t off = t * GEN_TILE;
+            const uint64_t cnt = (n - off < GEN_TILE ? n - off : GEN_TILE);
+            g.fill(tile, begin + off, cnt);
+            r = Reducer::combine(r, kernel(tile, cnt, off));
         }
+        return r;
+    });
+}
 
-#pragma omp critical
-        {
-            // 合并线程内最大值到全局最大值
-            global_max = (local_max > global_max ? local_max : global_max);
-        }
+inline DetSum cpu_sum_log_sqrt_det_gen(const RangeGenerator& g, uint64_t begin, uint64_t end) {
+    auto kernel = cpu_kernels().sum_log_sqrt_det;
+    return gen_reduce_omp<DetSumReducer>(g, begin, end, [kernel](const float* p, uint64_t cnt, uint64_t) {
+        return kernel(p, cnt);
+    });
+}
+
+// 按 SUM 引擎选择块内核；各块部分和以双精度累加（SCALAR 也逐块双精度累加，与基线 sum() 一致）
+inline float cpu_sum_log_sqrt_gen(SumEngine e, const RangeGenerator& g, uint64_t begin, uint64_t end) {
+    if (e == SumEngine::DET_OMP) return (float)det_value(cpu_sum_log_sqrt_det_gen(g, begin, end));
+    double (*kernel)(const float*, uint64_t) = nullptr;
+    switch (e) {
+    case SumEngine::SCALAR:
+        kernel = [](const float* p, uint64_t cnt) {
+            double s = 0.0;
+            for (uint64_t i = 0; i < cnt; ++i) s += logf(sqrtf(p[i]));
+            return s;
+        };
+        break;
+    case SumEngine::PROD_OMP: kernel = cpu_kernels().sum_log_sqrt_prod; break;
+    default: kernel = cpu_kernels().sum_log_sqrt; break;
     }
-    return global_max;
-#endif
+    return (float)gen_reduce_omp<SumReducer>(g, begin, end, [kernel](const float* p, uint64_t cnt, uint64_t) {
+        return kernel(p, cnt);
+    });
+}
 
-#else
-#if defined(USE_SSE)
-    return cpu_max_log_sqrt_sse(data, n);
-#else
-    return cpu_max_log_sqrt(data, n);
-#endif
-#endif
+// 单调变换下推：块内求原始值最大值，最后只变换一次
+template <class Transform>
+inline float cpu_max_transformed_gen(const RangeGenerator& g, uint64_t begin, uint64_t end) {
+    if constexpr (Transform::monotone_increasing) {
+        auto kernel = cpu_kernels().max_raw;
+        return Transform::from_raw_max(gen_reduce_omp<MaxReducer>(g, begin, end, [kernel](const float* p, uint64_t cnt, uint64_t) {
+            return kernel(p, cnt);
+        }));
+    }
+    else {
+        return gen_reduce_omp<MaxReducer>(g, begin, end, [](const float* p, uint64_t cnt, uint64_t) {
+            return reduce_transform_range<Transform, MaxReducer, IsaScalar>(p, cnt);
+        });
+    }
+}
+
+// argmax 为相对 begin 的下标，与物化数组后调用 cpu_stats_log_sqrt_omp 的含义相同
+inline StatsResult cpu_stats_log_sqrt_gen(const RangeGenerator& g, uint64_t begin, uint64_t end) {
+    auto kernel = cpu_kernels().stats_log_sqrt;
+    return gen_reduce_omp<StatsReducer>(g, begin, end, [kernel](const float* p, uint64_t cnt, uint64_t off) {
+        StatsResult r = kernel(p, cnt);
+        stats_offset(r, off);
+        return r;
+    });
 }
@@ -6,11 +6,34 @@
  * 1. key_log_sqrt: 计算比较键。
  * 2. quicksort_by_key: 对原始数据进行原地快速排序，但依据变换后的 Key 进行比较。
  * 3. merge_to_transformed: 将两段已排序的原始数据归并，并直接输出变换后的有序序列。
+ * 4. sort_by_transform: 单调变换下推，按原始值排序，避免每次比较都计算 log。
+ * 5. radix_sort_by_code: 对 sort_key_code 做多线程 LSD 基数排序（SortEngine::RADIX）。
+ * 6. merge_to_transformed_omp: 合并路径（merge path）并行归并 + 分块 SIMD 变换 + 非临时存储。
+ * 7. 样本排序辅助：sample_codes / choose_splitter / select_by_code（Op::SORT_SPLIT）。
+ * 8. merge_stream_to_transformed: 第二段按块陆续到达时的流式归并（配合 spsc_ring.h）。
+ * 9. intro_sort_by_code: 内省排序（ninther 取枢轴 + 向量化无分支划分 + 排序网络 + 堆排序兜底 + OpenMP 任务）。
+ * 10. bucket_by_code: 按抽样分割点把数据分到键有序的若干桶（worker SORT 的分桶流水线发送）。
  * * 用于 Master 的本地排序以及合并 Worker 返回的有序数据。
  */
 #pragma once
 #include <cmath>
 #include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "common.h"
+#include "cpu_dispatch.h"
+#include "range_gen.h"
+#include "simd_log.h"
+
+#if defined(USE_OPENMP)
+#include <omp.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CPU_SORT_HAVE_STREAM 1
+#endif
 
 //cpu_sort.h：
 //提供按 log(sqrt(x)) 为比较键的排序与归并逻辑，包括 key_log_sqrt、quicksort_by_key 和 merge_to_transformed，用于得到全局有序的 log(sqrt(.)) 序列。
@@ -20,31 +43,330 @@ static inline float key_log_sqrt(float x) {
     return logf(sqrtf(x));
 }
 
-// 原地快速排序，按 key_log_sqrt(x) 升序排列 a[l..r]，流程为：
-// 1) 选中间元素为 pivot，并计算其 key， kp = key_log_sqrt(pivot)。
+// 原地快速排序，按 key(x) 升序排列 a[l..r]，流程为：
+// 1) 选中间元素为 pivot，并计算其 key， kp = key(pivot)。
 // 2) i/j 双指针向中间扫描，找到与 key 关系不满足的元素。
 // 3) 交换 a[i]/a[j] 并推进指针，完成一轮分区。
 // 4) 递归处理左右子区间，直到区间长度为 1。
-static void quicksort_by_key(float* a, int64_t l, int64_t r) {
+template <class KeyFn>
+static void quicksort_by(float* a, int64_t l, int64_t r, KeyFn key) {
     int64_t i = l, j = r;
     float pivot = a[(l + r) >> 1];
-    float kp = key_log_sqrt(pivot);
+    auto kp = key(pivot);
 
     while (i <= j) {
-        while (key_log_sqrt(a[i]) < kp) ++i;
-        while (key_log_sqrt(a[j]) > kp) --j;
+        while (key(a[i]) < kp) ++i;
+        while (key(a[j]) > kp) --j;
         if (i <= j) {
             float t = a[i]; a[i] = a[j]; a[j] = t;
             ++i; --j;
         }
     }
-    if (l < j) quicksort_by_key(a, l, j);
-    if (i < r) quicksort_by_key(a, i, r);
+    if (l < j) quicksort_by(a, l, j, key);
+    if (i < r) quicksort_by(a, i, r, key);
+}
+
+// 基线版本：每次比较都计算 key_log_sqrt(x)
+static void quicksort_by_key(float* a, int64_t l, int64_t r) {
+    quicksort_by(a, l, r, [](float x) { return key_log_sqrt(x); });
+}
+
+// ===== 单调变换下推 (SORT) =====
+// ln(sqrt(x)) 在 x > 0 上严格单调递增，因此可以直接按原始值排序，最后统一做一次变换，
+// 把 O(n log n) 次 log 降为 n 次。非正数与 NaN 需要回退：
+// - sort_key_code（见 cpu_dispatch.h）把 float 位模式映射为与 key 顺序一致的无符号整数：
+//   ±0（key=-inf）< 正数（位模式随值单调递增，+inf 最大）< NaN 与负数（key=NaN，统一排在最后）。
+// - 全部元素 > 0 时走快速路径（直接比较 float）；否则按 sort_key_code 比较，仍然不需要 log。
+
+// 判断是否全部元素都 > 0（NaN 也视为不满足）
+static inline bool all_positive(const float* a, int64_t n) {
+    int64_t bad = 0;
+    for (int64_t i = 0; i < n; ++i) bad += !(a[i] > 0.0f);
+    return bad == 0;
+}
+
+// 按 Transform 的 key 升序排列原始值 a[0..n)，输出仍是原始值（与 quicksort_by_key 的约定相同）。
+// 单调递增变换走原始值排序；非单调变换回退为逐次比较都求 key 的排序。
+template <class Transform>
+static void sort_by_transform(float* a, int64_t n) {
+    if (n < 2) return;
+    if constexpr (Transform::monotone_increasing) {
+        if (all_positive(a, n)) quicksort_by(a, 0, n - 1, [](float x) { return x; });
+        else quicksort_by(a, 0, n - 1, [](float x) { return sort_key_code(x); });
+    }
+    else {
+        quicksort_by(a, 0, n - 1, [](float x) { return Transform::apply(x); });
+    }
+}
+
+// ===== 并行 LSD 基数排序 (SORT) =====
+// 设计说明：
+// - 排序键为 sort_key_code(x)（与 key 顺序一致的 32 位无符号整数），每轮处理 8 位，共 4 轮，从低位到高位。
+// - 每轮：各线程对自己的连续一段统计 256 桶直方图；按 (桶, 线程号) 顺序做前缀和得到每个线程在各桶的写入起点，
+//   因此排序是稳定的，且线程之间不需要同步写入。
+// - 分散写入先进入每桶一条缓存行（16 个 float）的写合并缓冲，满一行再整行写出，避免 256 路随机写造成的缓存/TLB 抖动。
+// - 两个缓冲区交替作为源和目标；所有元素某一位都相同（直方图只有一个桶非空）时跳过该轮，
+//   最后若结果落在临时缓冲区则并行拷回。
+// 输出与 sort_by_transform<单调变换> 相同（key 相等的 +0/-0 之间顺序可能不同，变换后都是 -inf）。
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_WC 16             // 写合并缓冲：每桶 16 个 float = 64 字节
+#define RADIX_MIN_N 65536       // 小于该规模时改用内省排序
+
+static void intro_sort_by_code(float* a, int64_t n);
+
+static void radix_sort_by_code(float* a, int64_t n) {
+    if (n < RADIX_MIN_N) {
+        // 小规模（顺串、桶、尾段）走内省排序：ninther 枢轴，深度超限改用堆排序，大量重复键时最坏仍为 O(n log n)
+        //if (n > 1) quicksort_by(a, 0, n - 1, [](float x) { return sort_key_code(x); });
+        intro_sort_by_code(a, n);
+        return;
+    }
+#if defined(USE_OPENMP)
+    const int nt = omp_get_max_threads();
+#else
+    const int nt = 1;
+#endif
+    const int64_t chunk = (n + nt - 1) / nt;
+    std::unique_ptr<float[]> tmp(new float[(size_t)n]);
+    // hist[t * RADIX_BUCKETS + d]：先是线程 t 的计数，前缀和之后是线程 t 在桶 d 的写入位置
+    std::vector<int64_t> hist((size_t)nt * RADIX_BUCKETS);
+    float* src = a;
+    float* dst = tmp.get();
+
+    for (int shift = 0; shift < 32; shift += RADIX_BITS) {
+        // 1) 各线程直方图（按线程编号循环而不是按实际线程数切块，两个阶段的切块保证一致）
+#if defined(USE_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+        for (int t = 0; t < nt; ++t) {
+            int64_t* h = &hist[(size_t)t * RADIX_BUCKETS];
+            for (int d = 0; d < RADIX_BUCKETS; ++d) h[d] = 0;
+            const int64_t b = (int64_t)t * chunk < n ? (int64_t)t * chunk : n;
+            const int64_t e = b + chunk < n ? b + chunk : n;
+            for (int64_t i = b; i < e; ++i) ++h[(sort_key_code(src[i]) >> shift) & (RADIX_BUCKETS - 1)];
+        }
+
+        // 2) 前缀和；某一桶包含全部元素时本轮是恒等排列，跳过
+        bool trivial = false;
+        int64_t sum = 0;
+        for (int d = 0; d < RADIX_BUCKETS; ++d) {
+            int64_t start = sum;
+            for (int t = 0; t < nt; ++t) {
+                int64_t c = hist[(size_t)t * RADIX_BUCKETS + d];
+                hist[(size_t)t * RADIX_BUCKETS + d] = sum;
+                sum += c;
+            }
+            if (sum - start == n) trivial = true;
+        }
+        if (trivial) continue;
+
+        // 3) 经写合并缓冲分散写入
+#if defined(USE_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+        for (int t = 0; t < nt; ++t) {
+            alignas(64) float wc[RADIX_BUCKETS][RADIX_WC];
+            uint32_t fill[RADIX_BUCKETS] = {};
+            int64_t* pos = &hist[(size_t)t * RADIX_BUCKETS];
+            const int64_t b = (int64_t)t * chunk < n ? (int64_t)t * chunk : n;
+            const int64_t e = b + chunk < n ? b + chunk : n;
+            for (int64_t i = b; i < e; ++i) {
+                const float x = src[i];
+                const uint32_t d = (sort_key_code(x) >> shift) & (RADIX_BUCKETS - 1);
+                wc[d][fill[d]++] = x;
+                if (fill[d] == RADIX_WC) {
+                    memcpy(dst + pos[d], wc[d], sizeof(wc[d]));
+                    pos[d] += RADIX_WC;
+                    fill[d] = 0;
+                }
+            }
+            for (int d = 0; d < RADIX_BUCKETS; ++d) {
+                memcpy(dst + pos[d], wc[d], fill[d] * sizeof(float));
+            }
+        }
+        float* s = src; src = dst; dst = s;
+    }
+
+    if (src != a) {
+#if defined(USE_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+        for (int t = 0; t < nt; ++t) {
+            const int64_t b = (int64_t)t * chunk < n ? (int64_t)t * chunk : n;
+            const int64_t e = b + chunk < n ? b + chunk : n;
+            if (b < e) memcpy(a + b, src + b, (size_t)(e - b) * sizeof(float));
+        }
+    }
+}
+
+// ===== 内省排序 (SortEngine::INTRO) =====
+// 设计说明：
+// - 比较键为 sort_key_code(x)，与 sort_by_transform<单调变换> 的顺序相同，不需要 log。
+// - 枢轴：n >= INTRO_NINTHER 时取 ninther（三组"三数取中"的中位数），否则三数取中；枢轴总是某个元素的键。
+// - 划分：cpu_kernels().partition_by_code（AVX2/AVX-512 为查表重排 + 整向量写入的无分支原地划分，其余为无分支 Lomuto），
+//   得到 [0, k) < p、[k, n) >= p。k == 0 说明 p 是最小键，再按 p + 1 划分一次把等于 p 的元素放到左边，
+//   这一段全部相等无需再排，因此大量重复值时也不会退化。
+// - 递归深度超过 2*log2(n) 时改用堆排序，最坏情况 O(n log n)。
+// - 不超过 INTRO_SMALL 个元素时用 16 输入的 Batcher 排序网络（63 次无分支比较交换），不足 16 个用最大键补齐。
+// - 较小的一段递归、较大的一段继续循环，栈深度 O(log n)；不小于 INTRO_TASK_MIN 的子段作为 OpenMP 任务并行处理。
+//   OpenMP 3.0 之前（MSVC 的 /openmp 为 2.0）没有任务，退化为单线程递归。
+#define INTRO_SMALL 16
+#define INTRO_NINTHER 128
+#define INTRO_TASK_MIN 65536
+
+#if defined(USE_OPENMP) && defined(_OPENMP) && _OPENMP >= 200805
+#define CPU_SORT_HAVE_TASKS 1
+#endif
+
+// 排序网络：(code << 32) | 位模式 作为 64 位整数比较，键相同的元素按位模式排列，结果与比较键一致
+static constexpr uint8_t INTRO_NETWORK16[63][2] = {
+    {0, 1}, {2, 3}, {0, 2}, {1, 3}, {1, 2}, {4, 5}, {6, 7}, {4, 6},
+    {5, 7}, {5, 6}, {0, 4}, {2, 6}, {2, 4}, {1, 5}, {3, 7}, {3, 5},
+    {1, 2}, {3, 4}, {5, 6}, {8, 9}, {10, 11}, {8, 10}, {9, 11}, {9, 10},
+    {12, 13}, {14, 15}, {12, 14}, {13, 15}, {13, 14}, {8, 12}, {10, 14}, {10, 12},
+    {9, 13}, {11, 15}, {11, 13}, {9, 10}, {11, 12}, {13, 14}, {0, 8}, {4, 12},
+    {4, 8}, {2, 10}, {6, 14}, {6, 10}, {2, 4}, {6, 8}, {10, 12}, {1, 9},
+    {5, 13}, {5, 9}, {3, 11}, {7, 15}, {7, 11}, {3, 5}, {7, 9}, {11, 13},
+    {1, 2}, {3, 4}, {5, 6}, {7, 8}, {9, 10}, {11, 12}, {13, 14},
+};
+
+static inline void intro_small_sort(float* a, int64_t n) {
+    uint64_t k[INTRO_SMALL];
+    for (int64_t i = 0; i < INTRO_SMALL; ++i) {
+        uint32_t bits = 0;
+        if (i < n) memcpy(&bits, a + i, sizeof(bits));
+        k[i] = (i < n ? (uint64_t)sort_key_code(a[i]) << 32 | bits : ~0ULL);
+    }
+    for (const auto& c : INTRO_NETWORK16) {
+        const uint64_t x = k[c[0]], y = k[c[1]];
+        k[c[0]] = (x < y ? x : y);
+        k[c[1]] = (x < y ? y : x);
+    }
+    for (int64_t i = 0; i < n; ++i) {
+        const uint32_t bits = (uint32_t)k[i];
+        memcpy(a + i, &bits, sizeof(bits));
+    }
+}
+
+static inline uint32_t median3(uint32_t x, uint32_t y, uint32_t z) {
+    const uint32_t lo = (x < y ? x : y), hi = (x < y ? y : x);
+    const uint32_t m = (hi < z ? hi : z);
+    return (lo > m ? lo : m);
+}
+
+static inline uint32_t intro_pivot(const float* a, int64_t n) {
+    const int64_t mid = n >> 1;
+    auto med = [a](int64_t i, int64_t j, int64_t k) {
+        return median3(sort_key_code(a[i]), sort_key_code(a[j]), sort_key_code(a[k]));
+    };
+    if (n < INTRO_NINTHER) return med(0, mid, n - 1);
+    const int64_t s = n >> 3;
+    return median3(med(0, s, 2 * s), med(mid - s, mid, mid + s), med(n - 1 - 2 * s, n - 1 - s, n - 1));
+}
+
+static void intro_heap_sort(float* a, int64_t n) {
+    auto less = [](float x, float y) { return sort_key_code(x) < sort_key_code(y); };
+    std::make_heap(a, a + n, less);
+    std::sort_heap(a, a + n, less);
+}
+
+static void intro_sort_rec(float* a, int64_t n, int depth, const CpuKernels* kern);
+
+static void intro_sort_part(float* a, int64_t n, int depth, const CpuKernels* kern) {
+#if defined(CPU_SORT_HAVE_TASKS)
+    if (n >= INTRO_TASK_MIN) {
+#pragma omp task firstprivate(a, n, depth, kern)
+        intro_sort_rec(a, n, depth, kern);
+        return;
+    }
+#endif
+    intro_sort_rec(a, n, depth, kern);
+}
+
+static void intro_sort_rec(float* a, int64_t n, int depth, const CpuKernels* kern) {
+    while (n > INTRO_SMALL) {
+        if (depth-- == 0) {
+            intro_heap_sort(a, n);
+            return;
+        }
+        const uint32_t p = intro_pivot(a, n);
+        int64_t k = (int64_t)kern->partition_by_code(a, (uint64_t)n, p);
+        if (k == 0) {
+            if (p == 0xFFFFFFFFu) return;       // 全部是最大键
+            k = (int64_t)kern->partition_by_code(a, (uint64_t)n, p + 1);
+            a += k;
+            n -= k;
+            continue;
+        }
+        if (k < n - k) {
+            intro_sort_part(a, k, depth, kern);
+            a += k;
+            n -= k;
+        }
+        else {
+            intro_sort_part(a + k, n - k, depth, kern);
+            n = k;
+        }
+    }
+    intro_small_sort(a, n);
+}
+
+static void intro_sort_by_code(float* a, int64_t n) {
+    if (n < 2) return;
+    const CpuKernels* kern = &cpu_kernels();
+    int depth = 0;
+    for (int64_t m = n; m > 1; m >>= 1) depth += 2;
+#if defined(CPU_SORT_HAVE_TASKS)
+    if (n >= INTRO_TASK_MIN && !omp_in_parallel() && omp_get_max_threads() > 1) {
+#pragma omp parallel
+#pragma omp single nowait
+        intro_sort_rec(a, n, depth, kern);
+        return;
+    }
+#endif
+    intro_sort_rec(a, n, depth, kern);
+}
+
+// ===== 排序引擎选择 =====
+enum class SortEngine : uint32_t {
+    QUICK = 0,      // sort_by_transform：单线程快速排序（单调变换下推）
+    RADIX = 1,      // radix_sort_by_code：多线程 LSD 基数排序
+    INTRO = 2       // intro_sort_by_code：向量化划分的内省排序（OpenMP 任务并行）
+};
+
+// master/worker 本地排序使用的引擎（基线 sort() 保持 quicksort_by_key 不变）
+static constexpr SortEngine SORT_ENGINE = SortEngine::RADIX;   // TODO：可切换排序引擎
+
+static inline const char* sort_engine_name(SortEngine e) {
+    switch (e) {
+    case SortEngine::QUICK: return "QUICK";
+    case SortEngine::RADIX: return "RADIX";
+    case SortEngine::INTRO: return "INTRO";
+    }
+    return "?";
+}
+
+// 与 sort_by_transform 的约定相同：按 Transform 的 key 升序排列原始值，输出仍是原始值
+// 基数排序与内省排序只适用于单调递增变换（键即 sort_key_code），其余情况回退为 sort_by_transform
+template <class Transform>
+static void sort_with_engine(SortEngine e, float* a, int64_t n) {
+    if constexpr (Transform::monotone_increasing) {
+        if (e == SortEngine::RADIX) {
+            radix_sort_by_code(a, n);
+            return;
+        }
+        if (e == SortEngine::INTRO) {
+            intro_sort_by_code(a, n);
+            return;
+        }
+    }
+    sort_by_transform<Transform>(a, n);
 }
 
 // merge：输入两段已按 key 排序的原始值数组，输出 result 为“变换后值”
 // 这样 master 最终得到全局排序后的 log(sqrt(.)) 序列
-// 归并两段按 key 排序的原始值，输出转换后的升序序列
+// 比较使用 sort_key_code（与 key 顺序一致且无需 log），每个输出元素只变换一次
 static void merge_to_transformed(
     const float* a, int64_t na,
     const float* b, int64_t nb,
@@ -52,11 +374,346 @@ static void merge_to_transformed(
 ) {
     int64_t i = 0, j = 0, k = 0;
     while (i < na && j < nb) {
-        float ka = key_log_sqrt(a[i]);
-        float kb = key_log_sqrt(b[j]);
-        if (ka <= kb) { outTransformed[k++] = ka; ++i; }
-        else { outTransformed[k++] = kb; ++j; }
+        if (sort_key_code(a[i]) <= sort_key_code(b[j])) outTransformed[k++] = key_log_sqrt(a[i++]);
+        else outTransformed[k++] = key_log_sqrt(b[j++]);
     }
     while (i < na) outTransformed[k++] = key_log_sqrt(a[i++]);
     while (j < nb) outTransformed[k++] = key_log_sqrt(b[j++]);
 }
+
+// ===== 并行归并 (merge path) =====
+// 设计说明：
+// - 输出按线程均分为连续的 [d0, d1)；对每个边界 d 在两个输入上二分出 co-rank：
+//   a 取前 i 个、b 取前 d - i 个时，两段前缀正好是全局归并结果的前 d 个（相等时 a 先，与 merge_to_transformed 一致）。
+//   各线程的输入区间互不重叠、输出长度相同，负载均衡且无需同步。
+// - 线程内按 MERGE_TILE 分块：先无分支地归并原始值到 L1 缓冲（比较 sort_key_code，无 log），
+//   再用分发得到的 SIMD 内核整块做 ln(sqrt(x)) 变换，最后以非临时存储写出，512MB 的输出不污染缓存。
+#define MERGE_TILE 2048
+
+// 输出位置 d 处 a 的取数个数
+static inline int64_t merge_path_corank(const float* a, int64_t na, const float* b, int64_t nb, int64_t d) {
+    int64_t lo = d > nb ? d - nb : 0;
+    int64_t hi = d < na ? d : na;
+    while (lo < hi) {
+        int64_t i = (lo + hi) >> 1;
+        // a[i] 排在 b[d-i-1] 之前（或相等）时，a 至少还要再取一个
+        if (sort_key_code(a[i]) <= sort_key_code(b[d - i - 1])) lo = i + 1;
+        else hi = i;
+    }
+    return lo;
+}
+
+// 把 src[0, n) 写到 dst，对齐部分使用非临时存储（绕过缓存）
+static inline void store_stream(float* dst, const float* src, int64_t n) {
+#if defined(CPU_SORT_HAVE_STREAM)
+    int64_t k = 0;
+    for (; k < n && ((uintptr_t)(dst + k) & 15) != 0; ++k) dst[k] = src[k];
+    for (; k + 4 <= n; k += 4) _mm_stream_ps(dst + k, _mm_loadu_ps(src + k));
+    for (; k < n; ++k) dst[k] = src[k];
+#else
+    memcpy(dst, src, (size_t)n * sizeof(float));
+#endif
+}
+
+// 与 merge_to_transformed 相同的输入输出约定，多线程执行
+static void merge_to_transformed_omp(
+    const float* a, int64_t na,
+    const float* b, int64_t nb,
+    float* outTransformed
+) {
+    const int64_t total = na + nb;
+    if (total <= 0) return;
+#if defined(USE_OPENMP)
+    const int nt = omp_get_max_threads();
+#else
+    const int nt = 1;
+#endif
+    const int64_t chunk = (total + nt - 1) / nt;
+    auto transform = cpu_kernels().transform_log_sqrt;
+
+#if defined(USE_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (int t = 0; t < nt; ++t) {
+        const int64_t d0 = (int64_t)t * chunk < total ? (int64_t)t * chunk : total;
+        const int64_t d1 = d0 + chunk < total ? d0 + chunk : total;
+        if (d0 >= d1) continue;
+        int64_t i = merge_path_corank(a, na, b, nb, d0), j = d0 - i;
+        const int64_t i1 = merge_path_corank(a, na, b, nb, d1), j1 = d1 - i1;
+
+        alignas(64) float tile[MERGE_TILE];
+        for (int64_t k = d0; k < d1; ) {
+            const int64_t cnt = (d1 - k < MERGE_TILE ? d1 - k : MERGE_TILE);
+            int64_t m = 0;
+            // 两边都有剩余时无分支选择
+            while (m < cnt && i < i1 && j < j1) {
+                const float x = a[i], y = b[j];
+                const bool takeA = sort_key_code(x) <= sort_key_code(y);
+                tile[m++] = takeA ? x : y;
+                i += takeA;
+                j += !takeA;
+            }
+            while (m < cnt && i < i1) tile[m++] = a[i++];
+            while (m < cnt && j < j1) tile[m++] = b[j++];
+            transform(tile, tile, (uint64_t)cnt);
+            store_stream(outTransformed + k, tile, cnt);
+            k += cnt;
+        }
+#if defined(CPU_SORT_HAVE_STREAM)
+        _mm_sfence();
+#endif
+    }
+}
+
+// ===== 流式归并 =====
+// b 按块陆续到达（例如从网络接收），每块用完即可归还，不需要先收齐整段 b。
+// next_chunk(count) 返回下一块的指针与长度，返回 nullptr 表示结束；release_chunk() 归还当前块。
+// 归并规则与 merge_to_transformed 相同（相等时 a 先），输出同样经 L1 分块做 SIMD 变换并以非临时存储写出。
+// 返回写出的元素个数，调用方需保证 out 至少能容纳 na + b 的总长度。
+template <class NextChunk, class ReleaseChunk>
+static int64_t merge_stream_to_transformed(
+    const float* a, int64_t na,
+    NextChunk next_chunk, ReleaseChunk release_chunk,
+    float* outTransformed
+) {
+    auto transform = cpu_kernels().transform_log_sqrt;
+    alignas(64) float tile[MERGE_TILE];
+    int64_t m = 0, k = 0, i = 0;
+    auto flush = [&]() {
+        transform(tile, tile, (uint64_t)m);
+        store_stream(outTransformed + k, tile, m);
+        k += m;
+        m = 0;
+    };
+
+    size_t bn = 0, j = 0;
+    const float* b = next_chunk(bn);
+    while (b) {
+        // 两边都有剩余时无分支选择，每次最多填满一个输出块
+        while (j < bn && i < na) {
+            const int64_t room = MERGE_TILE - m;
+            int64_t step = 0;
+            while (step < room && j < bn && i < na) {
+                const float x = a[i], y = b[j];
+                const bool takeA = sort_key_code(x) <= sort_key_code(y);
+                tile[m + step++] = takeA ? x : y;
+                i += takeA;
+                j += !takeA;
+            }
+            m += step;
+            if (m == MERGE_TILE) flush();
+        }
+        // a 已取完：本块剩余部分直接输出
+        while (j < bn) {
+            tile[m++] = b[j++];
+            if (m == MERGE_TILE) flush();
+        }
+        release_chunk();
+        b = next_chunk(bn);
+        j = 0;
+    }
+    while (i < na) {
+        tile[m++] = a[i++];
+        if (m == MERGE_TILE) flush();
+    }
+    flush();
+#if defined(CPU_SORT_HAVE_STREAM)
+    _mm_sfence();
+#endif
+    return k;
+}
+
+// ===== 样本排序 (Op::SORT_SPLIT) =====
+// 设计说明：
+// - 两端各自从自己负责的下标区间随机抽取键样本（sort_key_code），worker 把样本发给 master，
+//   master 合并后取分位数作为分割点：key code < splitter 的元素归 master，>= splitter 的归 worker。
+// - 数据按下标可生成（RangeGenerator），因此两端各自扫描整个 [0, N)，只保留落在自己键区间内的元素，
+//   原始数据不经过网络；worker 排序并变换后，结果可以直接收进 result 的对应偏移，无需归并。
+#define SORT_SAMPLE 8192    // 两端合计的样本数，按下标区间长度分配
+
+// 从 [begin, end) 中按固定种子随机抽取 count 个元素的 sort_key_code
+static void sample_codes(const RangeGenerator& g, uint64_t begin, uint64_t end, uint32_t count, uint64_t seed, uint32_t* out) {
+    if (end <= begin) return;
+    uint64_t s = seed | 1;
+    for (uint32_t k = 0; k < count; ++k) {
+        float x;
+        g.fill(&x, begin + rng_next_u64(s) % (end - begin), 1);
+        out[k] = sort_key_code(x);
+    }
+}
+
+// 合并后的样本按 frac 分位数选分割点（frac 为 master 应负责的比例）
+static uint32_t choose_splitter(std::vector<uint32_t>& codes, double frac) {
+    if (codes.empty()) return 0;
+    size_t k = (size_t)(frac * (double)codes.size());
+    if (k >= codes.size()) return 0xFFFFFFFFu;
+    std::nth_element(codes.begin(), codes.begin() + (ptrdiff_t)k, codes.end());
+    return codes[k];
+}
+
+// 扫描 [begin, end)，把 sort_key_code 落在 [lo, hi) 的元素按下标顺序写入 out（hi 可取 2^32）
+// 两遍：先按 GEN_TILE 分块统计各线程命中数，再由各线程写入自己的偏移（同时完成首次访问）
+template <class Vec>
+static void select_by_code(const RangeGenerator& g, uint64_t begin, uint64_t end, uint64_t lo, uint64_t hi, Vec& out) {
+    const uint64_t n = end > begin ? end - begin : 0;
+    const int64_t tiles = (int64_t)((n + GEN_TILE - 1) / GEN_TILE);
+#if defined(USE_OPENMP)
+    const int nt = omp_get_max_threads();
+#else
+    const int nt = 1;
+#endif
+    const int64_t chunk = (tiles + nt - 1) / nt;
+    std::vector<uint64_t> cnt((size_t)nt + 1, 0);
+
+    auto scan = [&](int t, float* dst) {
+        alignas(64) float tile[GEN_TILE];
+        alignas(64) float sel[GEN_TILE];
+        const int64_t tb = (int64_t)t * chunk < tiles ? (int64_t)t * chunk : tiles;
+        const int64_t te = tb + chunk < tiles ? tb + chunk : tiles;
+        uint64_t c = 0;
+        for (int64_t k = tb; k < te; ++k) {
+            const uint64_t off = (uint64_t)k * GEN_TILE;
+            const uint64_t m = (n - off < GEN_TILE ? n - off : GEN_TILE);
+            g.fill(tile, begin + off, m);
+            // 块内无分支压缩：无条件写、按命中推进
+            uint64_t kept = 0;
+            for (uint64_t i = 0; i < m; ++i) {
+                const uint64_t code = sort_key_code(tile[i]);
+                sel[kept] = tile[i];
+                kept += (code >= lo && code < hi);
+            }
+            if (dst) memcpy(dst + c, sel, (size_t)kept * sizeof(float));
+            c += kept;
+        }
+        return c;
+    };
+
+#if defined(USE_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (int t = 0; t < nt; ++t) cnt[(size_t)t + 1] = scan(t, nullptr);
+    for (int t = 0; t < nt; ++t) cnt[(size_t)t + 1] += cnt[(size_t)t];
+
+    out.resize((size_t)cnt[(size_t)nt]);
+    float* base = out.data();
+#if defined(USE_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (int t = 0; t < nt; ++t) scan(t, base + cnt[(size_t)t]);
+}
+
+// ===== 分桶流水线排序 (Op::SORT) =====
+// 设计说明：
+// - 按固定种子从数据中抽取 PIPE_BUCKETS * PIPE_OVERSAMPLE 个键，排序后取等距分位数作为 PIPE_BUCKETS - 1 个分割点；
+//   sort_key_code 落在 [sp[b-1], sp[b]) 的元素属于第 b 桶，桶之间按键有序，各桶分别排好后首尾相接即整体有序。
+// - 分散写入与基数排序的一轮相同（每线程直方图 + 前缀和 + 写合并缓冲，同桶内保持原顺序），
+//   桶号先查键高 16 位的前缀表（前缀内的键全部落在同一桶时直接得到桶号），只有跨越分割点的前缀
+//   才做 log2(PIPE_BUCKETS) 次无分支比较的二分查找；统计时按字节暂存，分散写入时直接读取。
+// - worker 按桶号顺序多线程排序各桶，发送线程等第 b 桶排好就把它分帧发出，排序与发送重叠（见 worker.cpp）。
+//   分割点重复（大量相同键）时只会出现空桶或大桶，结果仍然正确。
+#define PIPE_BUCKETS 64             // TODO：可调整，须为不超过 128 的 2 的幂；桶越多首帧越早，但每桶越小
+#define PIPE_OVERSAMPLE 32
+#define PIPE_MIN_N (1 << 20)        // 少于该规模时整段排序后一次发出
+#define PIPE_LUT_SPLIT 0xFF         // 前缀表中表示“该前缀跨越分割点”
+
+static constexpr bool USE_PIPE_SORT = true;   // TODO：可切换 worker 的 SORT 是否分桶流水线发送
+
+// sp 为已排序的 PIPE_BUCKETS - 1 个分割点，返回不大于 code 的分割点个数（即桶号）
+static inline uint32_t pipe_bucket_of(const uint32_t* sp, uint32_t code) {
+    uint32_t b = 0;
+    for (uint32_t step = PIPE_BUCKETS / 2; step; step >>= 1) {
+        b += step & (0u - (uint32_t)(sp[b + step - 1] <= code));
+    }
+    return b;
+}
+
+// 把 a[0, n) 按键分到 out 的 PIPE_BUCKETS 个连续桶中；第 b 桶为 out[bounds[b], bounds[b + 1])
+template <class Vec>
+static void bucket_by_code(const float* a, int64_t n, uint64_t seed, Vec& out, std::vector<int64_t>& bounds) {
+    static_assert((PIPE_BUCKETS & (PIPE_BUCKETS - 1)) == 0 && PIPE_BUCKETS <= 128, "PIPE_BUCKETS must be a power of two <= 128");
+    bounds.assign(PIPE_BUCKETS + 1, n);
+    bounds[0] = 0;
+    out.resize((size_t)n);
+    if (n <= 0) return;
+
+    // 1) 抽样选分割点
+    std::vector<uint32_t> sample((size_t)PIPE_BUCKETS * PIPE_OVERSAMPLE);
+    uint64_t s = seed | 1;
+    for (auto& c : sample) c = sort_key_code(a[rng_next_u64(s) % (uint64_t)n]);
+    std::sort(sample.begin(), sample.end());
+    uint32_t sp[PIPE_BUCKETS - 1];
+    for (int b = 0; b + 1 < PIPE_BUCKETS; ++b) sp[b] = sample[(size_t)(b + 1) * PIPE_OVERSAMPLE];
+    std::unique_ptr<uint8_t[]> lut(new uint8_t[1u << 16]);
+    for (uint32_t p = 0; p < (1u << 16); ++p) {
+        const uint32_t lo = pipe_bucket_of(sp, p << 16), hi = pipe_bucket_of(sp, (p << 16) | 0xFFFFu);
+        lut[p] = (uint8_t)(lo == hi ? lo : PIPE_LUT_SPLIT);
+    }
+    auto bucket_of = [&](uint32_t code) {
+        const uint32_t b = lut[code >> 16];
+        return b != PIPE_LUT_SPLIT ? b : pipe_bucket_of(sp, code);
+    };
+
+#if defined(USE_OPENMP)
+    const int nt = omp_get_max_threads();
+#else
+    const int nt = 1;
+#endif
+    const int64_t chunk = (n + nt - 1) / nt;
+    // hist[t * PIPE_BUCKETS + b]：先是线程 t 的计数，前缀和之后是线程 t 在桶 b 的写入位置
+    std::vector<int64_t> hist((size_t)nt * PIPE_BUCKETS);
+    // 第一遍算出的桶号暂存下来，分散写入时不再二分查找
+    std::unique_ptr<uint8_t[]> ids(new uint8_t[(size_t)n]);
+
+    // 2) 各线程直方图
+#if defined(USE_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (int t = 0; t < nt; ++t) {
+        int64_t* h = &hist[(size_t)t * PIPE_BUCKETS];
+        for (int b = 0; b < PIPE_BUCKETS; ++b) h[b] = 0;
+        const int64_t lo = (int64_t)t * chunk < n ? (int64_t)t * chunk : n;
+        const int64_t hi = lo + chunk < n ? lo + chunk : n;
+        for (int64_t i = lo; i < hi; ++i) {
+            const uint32_t b = bucket_of(sort_key_code(a[i]));
+            ids[(size_t)i] = (uint8_t)b;
+            ++h[b];
+        }
+    }
+
+    // 3) 前缀和，同时得到桶边界
+    int64_t sum = 0;
+    for (int b = 0; b < PIPE_BUCKETS; ++b) {
+        bounds[b] = sum;
+        for (int t = 0; t < nt; ++t) {
+            int64_t c = hist[(size_t)t * PIPE_BUCKETS + b];
+            hist[(size_t)t * PIPE_BUCKETS + b] = sum;
+            sum += c;
+        }
+    }
+
+    // 4) 经写合并缓冲分散写入
+    float* dst = out.data();
+#if defined(USE_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (int t = 0; t < nt; ++t) {
+        alignas(64) float wc[PIPE_BUCKETS][RADIX_WC];
+        uint32_t fill[PIPE_BUCKETS] = {};
+        int64_t* pos = &hist[(size_t)t * PIPE_BUCKETS];
+        const int64_t lo = (int64_t)t * chunk < n ? (int64_t)t * chunk : n;
+        const int64_t hi = lo + chunk < n ? lo + chunk : n;
+        for (int64_t i = lo; i < hi; ++i) {
+            const float x = a[i];
+            const uint32_t b = ids[(size_t)i];
+            wc[b][fill[b]++] = x;
+            if (fill[b] == RADIX_WC) {
+                memcpy(dst + pos[b], wc[b], sizeof(wc[b]));
+                pos[b] += RADIX_WC;
+                fill[b] = 0;
+            }
+        }
+        for (int b = 0; b < PIPE_BUCKETS; ++b) {
+            memcpy(dst + pos[b], wc[b], fill[b] * sizeof(float));
+        }
+    }
+}
@@ -0,0 +1,309 @@
+﻿/**
+ * @file ext_sort.cpp
+ * @brief 外部排序：顺串生成/写盘、只读映射与预读、败者树 k 路归并
+ * * Windows 用 CreateFileMapping/MapViewOfFile（FILE_FLAG_SEQUENTIAL_SCAN）与 PrefetchVirtualMemory，
+ * Linux 用 mmap + madvise(SEQUENTIAL / WILLNEED / DONTNEED)。
+ */
+#include "ext_sort.h"
+#include "cpu_sort.h"
+#include "numa_mem.h"
+#include "reduce_kernel.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#if defined(USE_OPENMP)
+#include <omp.h>
+#endif
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+uint64_t process_id() {
+#if defined(_WIN32)
+    return (uint64_t)GetCurrentProcessId();
+#else
+    return (uint64_t)getpid();
+#endif
+}
+
+// 整块顺序写出一个顺串；失败时删除残留文件
+bool write_run(const std::string& path, const float* a, uint64_t n) {
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    std::setvbuf(f, nullptr, _IONBF, 0);    // 已经是大块写入，不需要 stdio 再拷贝一次
+    ExtRunHeader hd{ EXT_RUN_MAGIC, EXT_RUN_VERSION, n, 0, 0, 0 };
+    if (n) {
+        hd.min_code = sort_key_code(a[0]);
+        hd.max_code = sort_key_code(a[n - 1]);
+    }
+    bool ok = std::fwrite(&hd, sizeof(hd), 1, f) == 1;
+    const uint64_t step = EXT_IO_BYTES / sizeof(float);
+    for (uint64_t off = 0; ok && off < n; off += step) {
+        const size_t m = (size_t)(n - off < step ? n - off : step);
+        ok = std::fwrite(a + off, sizeof(float), m, f) == m;
+    }
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok) std::remove(path.c_str());
+    return ok;
+}
+
+// 并行生成 [first, first + n) 到 dst（切块同 omp_static_range，首次写入即在处理线程的节点上）
+void fill_parallel(const RangeGenerator& g, float* dst, uint64_t first, uint64_t n) {
+#if defined(USE_OPENMP)
+#pragma omp parallel
+#endif
+    {
+        uint64_t b, e;
+        omp_static_range(n, b, e);
+        if (b < e) g.fill(dst + b, first + b, e - b);
+    }
+}
+
+// 只读映射的顺串，按 EXT_MERGE_BLOCK 顺序读取
+class MappedRun final : public SortedSource {
+public:
+    ~MappedRun() override {
+#if defined(_WIN32)
+        if (base_) UnmapViewOfFile(base_);
+        if (map_) CloseHandle(map_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+        if (base_) munmap(base_, bytes_);
+#endif
+    }
+
+    bool open(const std::string& path) {
+#if defined(_WIN32)
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file_, &sz)) return false;
+        bytes_ = (uint64_t)sz.QuadPart;
+        if (bytes_ < sizeof(ExtRunHeader)) return false;
+        map_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!map_) return false;
+        base_ = MapViewOfFile(map_, FILE_MAP_READ, 0, 0, 0);
+        if (!base_) return false;
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(ExtRunHeader)) {
+            ::close(fd);
+            return false;
+        }
+        bytes_ = (uint64_t)st.st_size;
+        void* p = mmap(nullptr, bytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);                // 映射建立后不再需要文件描述符
+        if (p == MAP_FAILED) return false;
+        base_ = p;
+        madvise(base_, bytes_, MADV_SEQUENTIAL);
+#endif
+        ExtRunHeader hd;
+        memcpy(&hd, base_, sizeof(hd));
+        if (hd.magic != EXT_RUN_MAGIC || hd.version != EXT_RUN_VERSION
+            || hd.count != (bytes_ - sizeof(ExtRunHeader)) / sizeof(float)) return false;
+        data_ = (const float*)((const char*)base_ + sizeof(ExtRunHeader));
+        count_ = hd.count;
+        prefetch(0);
+        return true;
+    }
+
+    const float* next_block(size_t& n) override {
+        if (pos_ >= count_) {
+            n = 0;
+            return nullptr;
+        }
+        n = (size_t)(count_ - pos_ < EXT_MERGE_BLOCK ? count_ - pos_ : EXT_MERGE_BLOCK);
+        const float* p = data_ + pos_;
+        pos_ += n;
+        // 读到上一个预读窗口的一半时发出下一个窗口，磁盘读取与归并重叠
+        if ((pos_ - n) * sizeof(float) + EXT_READAHEAD_BYTES / 2 >= ahead_) prefetch(ahead_);
+        release_behind(pos_ - n);
+        return p;
+    }
+
+private:
+    // 预读文件偏移 [from, from + EXT_READAHEAD_BYTES)（相对数据区）
+    void prefetch(uint64_t from) {
+        const uint64_t total = count_ * sizeof(float);
+        if (from >= total) {
+            ahead_ = ~0ULL;
+            return;
+        }
+        const uint64_t len = (total - from < EXT_READAHEAD_BYTES ? total - from : EXT_READAHEAD_BYTES);
+        char* p = (char*)data_ + from;
+#if defined(_WIN32)
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+        WIN32_MEMORY_RANGE_ENTRY r{ p, (SIZE_T)len };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &r, 0);
+#else
+        (void)p;
+#endif
+#else
+        const uintptr_t pg = (uintptr_t)sysconf(_SC_PAGESIZE);
+        char* b = (char*)((uintptr_t)p & ~(pg - 1));
+        madvise(b, (size_t)(p + len - b), MADV_WILLNEED);
+#endif
+        ahead_ = from + len;
+    }
+
+    // 已归并过的整页不再需要（Windows 上只读映射的页可被系统随时回收，不做处理）
+    void release_behind(uint64_t pos) {
+#if !defined(_WIN32)
+        const uint64_t pg = (uint64_t)sysconf(_SC_PAGESIZE);
+        const uint64_t end = ((sizeof(ExtRunHeader) + pos * sizeof(float)) / pg) * pg;
+        if (end >= released_ + EXT_READAHEAD_BYTES) {
+            madvise((char*)base_ + released_, (size_t)(end - released_), MADV_DONTNEED);
+            released_ = end;
+        }
+#else
+        (void)pos;
+#endif
+    }
+
+#if defined(_WIN32)
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE map_ = nullptr;
+#endif
+    void* base_ = nullptr;
+    uint64_t bytes_ = 0;
+    const float* data_ = nullptr;
+    uint64_t count_ = 0;
+    uint64_t pos_ = 0;
+    uint64_t ahead_ = 0;        // 已发出预读的数据区字节数
+    uint64_t released_ = 0;     // 已释放的文件字节数（页对齐）
+};
+
+} // namespace
+
+std::string ext_tmp_dir() {
+    const char* env = std::getenv("DPC_SORT_TMP");
+    if (env && *env) return env;
+    std::error_code ec;
+    const std::filesystem::path p = std::filesystem::temp_directory_path(ec);
+    return ec ? std::string(".") : p.string();
+}
+
+ExtRunSet::~ExtRunSet() {
+    for (const std::string& p : paths_) std::remove(p.c_str());
+}
+
+bool ExtRunSet::build(const RangeGenerator& g, uint64_t begin, uint64_t end, uint64_t seed) {
+    const std::string dir = ext_tmp_dir();
+    const uint64_t n = end - begin;
+    const uint64_t run = (n < EXT_RUN_ELEMS ? n : EXT_RUN_ELEMS);
+    FirstTouchVec buf[2];
+    std::thread writer;
+    bool write_ok = true;
+
+    for (uint64_t off = 0, i = 0; off < n; off += run, ++i) {
+        const uint64_t m = (n - off < run ? n - off : run);
+        FirstTouchVec& cur = buf[i & 1];
+        cur.resize((size_t)m);
+        fill_parallel(g, cur.data(), begin + off, m);
+        shuffle_fisher_yates(cur.data(), m, seed ^ (off * 0x9E3779B97F4A7C15ULL));
+        sort_with_engine<LogSqrtTransform>(SORT_ENGINE, cur.data(), (int64_t)m);    //TODO：排序引擎由 cpu_sort.h 中的 SORT_ENGINE 决定
+
+        // 上一个顺串写完后才能复用它的缓冲区，也保证同时只有一个写线程
+        if (writer.joinable()) writer.join();
+        if (!write_ok) break;
+        char name[96];
+        std::snprintf(name, sizeof(name), "dpc_%s_%llu_%llu.run", tag_.c_str(),
+            (unsigned long long)process_id(), (unsigned long long)paths_.size());
+        paths_.push_back((std::filesystem::path(dir) / name).string());
+        writer = std::thread([&write_ok, path = paths_.back(), p = cur.data(), m]() {
+            numa_release_thread();  // 写盘与下一个顺串的排序重叠，不继承主线程绑定的单个 CPU
+            write_ok = write_run(path, p, m);
+        });
+    }
+    if (writer.joinable()) writer.join();
+    if (!write_ok) {
+        std::cerr << "[EXT] failed to write run in " << dir << "\n";
+        return false;
+    }
+    total_ = n;
+    std::cout << "[EXT] " << tag_ << ": " << paths_.size() << " runs of <= " << run
+        << " elements in " << dir << "\n";
+    return true;
+}
+
+bool ExtRunSet::open(std::vector<std::unique_ptr<SortedSource>>& out) const {
+    for (const std::string& p : paths_) {
+        std::unique_ptr<MappedRun> r(new MappedRun());
+        if (!r->open(p)) {
+            std::cerr << "[EXT] failed to map " << p << "\n";
+            return false;
+        }
+        out.push_back(std::move(r));
+    }
+    return true;
+}
+
+// 败者树：叶子数补齐为 2 的幂，已耗尽的输入键为 EXHAUSTED（大于任何 32 位 code）。
+// loser[1..P) 存放每场比赛的败者，loser[0] 为总冠军；冠军输出一个元素后只需沿它的路径重赛。
+uint64_t ext_merge(std::vector<std::unique_ptr<SortedSource>>& src, MergeSink& sink) {
+    static constexpr uint64_t EXHAUSTED = 1ULL << 32;
+    const size_t k = src.size();
+    size_t P = 1;
+    while (P < k) P <<= 1;
+
+    std::vector<const float*> cur(P, nullptr), end(P, nullptr);
+    std::vector<uint64_t> key(P, EXHAUSTED);
+    auto refill = [&](size_t i) {
+        size_t n = 0;
+        const float* p = src[i]->next_block(n);
+        while (p && n == 0) p = src[i]->next_block(n);
+        cur[i] = p;
+        end[i] = p ? p + n : nullptr;
+        key[i] = p ? sort_key_code(*p) : EXHAUSTED;
+    };
+    for (size_t i = 0; i < k; ++i) refill(i);
+
+    std::vector<size_t> loser(P, 0), win(2 * P, 0);
+    for (size_t i = 0; i < P; ++i) win[P + i] = i;
+    for (size_t nd = P - 1; nd >= 1; --nd) {
+        const size_t a = win[2 * nd], b = win[2 * nd + 1];
+        win[nd] = (key[a] <= key[b] ? a : b);
+        loser[nd] = (key[a] <= key[b] ? b : a);
+    }
+    loser[0] = win[1];
+
+    std::vector<float> out(EXT_MERGE_BLOCK);
+    size_t filled = 0;
+    uint64_t total = 0;
+    size_t w = loser[0];
+    while (key[w] != EXHAUSTED) {
+        out[filled++] = *cur[w]++;
+        if (filled == EXT_MERGE_BLOCK) {
+            if (!sink.consume(out.data(), filled)) return total;
+            total += filled;
+            filled = 0;
+        }
+        if (cur[w] == end[w]) refill(w);
+        else key[w] = sort_key_code(*cur[w]);
+        for (size_t nd = (w + P) >> 1; nd >= 1; nd >>= 1) {
+            if (key[loser[nd]] < key[w]) std::swap(loser[nd], w);
+        }
+        loser[0] = w;
+    }
+    if (filled && sink.consume(out.data(), filled)) total += filled;
+    return total;
+}
@@ -0,0 +1,104 @@
+﻿/**
+ * @file ext_sort.h
+ * @brief 外部排序（数据量超过内存时的 SORT）
+ * * 原来两端都把整段数据放进一个 vector，DATANUM 受限于内存最小的节点。外部排序分两个阶段：
+ * 1. 生成顺串：每次从生成器取 EXT_RUN_ELEMS 个元素到内存，打乱后用 SORT_ENGINE 多线程排序，
+ *    交给写线程整块顺序写入本地磁盘，同时排序下一个顺串（两块缓冲交替）。
+ * 2. k 路归并：各顺串文件只读映射，按顺序读取并提前发出预读、释放已读过的页；
+ *    败者树每输出一个元素只需 log2(k) 次比较，输出按 EXT_MERGE_BLOCK 个元素一块交给调用方。
+ * worker 的 SORT 把每块直接作为一帧发给 master；master 把自己的顺串与 worker 的数据流一起归并，
+ * 变换后写入 result。内存占用与区间长度无关：两个顺串缓冲，外加 SORT_ENGINE 为 RADIX 时基数排序的
+ * 一块同样大小的临时缓冲（另一块顺串缓冲此时正由写线程写盘，不能借用），峰值约 3 * EXT_RUN_ELEMS 个 float。
+ * 顺串文件放在环境变量 DPC_SORT_TMP 指定的目录（默认系统临时目录），ExtRunSet 析构时删除。
+ */
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "range_gen.h"
+
+// 每个顺串的元素数：64M 个 float = 256MB，同时存在两块（排序与写盘交替），
+// 基数排序另需一块同样大小的临时缓冲，峰值约 768MB
+#define EXT_RUN_ELEMS (1ull << 26)      // TODO：按节点内存调整
+// 归并输出块：与网络分帧一致，worker 每块直接作为一帧发出
+#define EXT_MERGE_BLOCK SORT_CHUNK
+// 顺串写盘每次写入的字节数，以及归并时在读位置之前预读的字节数
+#define EXT_IO_BYTES (8u << 20)
+#define EXT_READAHEAD_BYTES (32u << 20)
+
+// 区间长度超过该值（元素数，1GB float）时 SORT 走外部排序
+static constexpr uint64_t EXT_SORT_MIN = 1ull << 28;   // TODO：可调小以在小数据上验证外部排序
+
+static inline bool ext_sort_wanted(uint64_t n) { return n > EXT_SORT_MIN; }
+
+// 顺串文件格式：32 字节头 + count 个按 sort_key_code 升序的原始 float（本机字节序）
+#pragma pack(push, 1)
+struct ExtRunHeader {
+    uint32_t magic;         // EXT_RUN_MAGIC
+    uint32_t version;
+    uint64_t count;
+    uint32_t min_code;      // 首尾元素的 sort_key_code，便于检查
+    uint32_t max_code;
+    uint64_t reserved;
+};
+#pragma pack(pop)
+
+static constexpr uint32_t EXT_RUN_MAGIC = 0x4E555244;  // "DRUN"
+static constexpr uint32_t EXT_RUN_VERSION = 1;
+
+// 一路按 sort_key_code 有序的输入
+struct SortedSource {
+    virtual ~SortedSource() = default;
+    // 返回下一块数据并把元素数写入 n；上一块在本次调用后失效；没有更多数据时返回 nullptr
+    virtual const float* next_block(size_t& n) = 0;
+};
+
+// 内存中已排好的数组作为一路输入（一次返回全部）
+struct ArraySource final : SortedSource {
+    const float* p;
+    uint64_t n;
+    ArraySource(const float* a, uint64_t c) : p(a), n(c) {}
+    const float* next_block(size_t& cnt) override {
+        if (!n) return nullptr;
+        cnt = (size_t)n;
+        n = 0;
+        return p;
+    }
+};
+
+// 一组顺串文件（析构时删除）
+class ExtRunSet {
+public:
+    explicit ExtRunSet(const char* tag) : tag_(tag) {}
+    ~ExtRunSet();
+    ExtRunSet(const ExtRunSet&) = delete;
+    ExtRunSet& operator=(const ExtRunSet&) = delete;
+
+    // 生成 [begin, end) 的全部顺串；seed 用于顺串内打乱（与内存版 SORT 一样先打乱再排序）
+    bool build(const RangeGenerator& g, uint64_t begin, uint64_t end, uint64_t seed);
+
+    // 依次映射各顺串，追加到 out；失败返回 false
+    bool open(std::vector<std::unique_ptr<SortedSource>>& out) const;
+
+    size_t runs() const { return paths_.size(); }
+    uint64_t total() const { return total_; }
+
+private:
+    std::string tag_;
+    std::vector<std::string> paths_;
+    uint64_t total_ = 0;
+};
+
+// 归并结果的接收方：raw 为按 key 有序的原始值，返回 false 时中止归并
+struct MergeSink {
+    virtual ~MergeSink() = default;
+    virtual bool consume(const float* raw, size_t n) = 0;
+};
+
+// 败者树 k 路归并，返回交给 sink 的元素总数
+uint64_t ext_merge(std::vector<std::unique_ptr<SortedSource>>& src, MergeSink& sink);
+
+// 顺串目录（DPC_SORT_TMP 或系统临时目录）
+std::string ext_tmp_dir();
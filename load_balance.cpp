@@ -0,0 +1,125 @@
+﻿/**
+ * @file load_balance.cpp
+ * @brief EWMA 代价模型与按预测完成时间相等的切分
+ */
+#include "load_balance.h"
+
+namespace {
+
+// SORT 与 SORT_SPLIT 的代价相同，共用一项
+size_t op_index(Op op) {
+    if (op == Op::SORT_SPLIT) op = Op::SORT;
+    return (size_t)op;
+}
+
+double ewma(double old, double x, bool seen) {
+    return seen ? old + LB_ALPHA * (x - old) : x;
+}
+
+// 网络开销与元素数成正比的 Op（结果为整段数据）
+bool net_scales(Op op) {
+    return op == Op::SORT || op == Op::SORT_SPLIT;
+}
+
+} // namespace
+
+CostModel::Entry& CostModel::at(size_t node, Op op) {
+    if (nodes_.size() <= node) nodes_.resize(node + 1);
+    std::vector<Entry>& v = nodes_[node];
+    if (v.size() <= op_index(op)) v.resize(op_index(op) + 1);
+    return v[op_index(op)];
+}
+
+const CostModel::Entry* CostModel::find(size_t node, Op op) const {
+    if (node >= nodes_.size() || op_index(op) >= nodes_[node].size()) return nullptr;
+    const Entry& e = nodes_[node][op_index(op)];
+    return e.seen ? &e : nullptr;
+}
+
+void CostModel::observe_compute(size_t node, Op op, uint64_t n, double ms) {
+    if (n == 0 || !(ms > 0.0)) return;
+    Entry& e = at(node, op);
+    e.compute_per_elem = ewma(e.compute_per_elem, ms / (double)n, e.seen);
+    e.seen = true;
+}
+
+void CostModel::observe_net(size_t node, Op op, uint64_t n, double ms) {
+    if (ms < 0.0) ms = 0.0;
+    Entry& e = at(node, op);
+    if (net_scales(op)) {
+        if (n == 0) return;
+        e.net_per_elem = ewma(e.net_per_elem, ms / (double)n, e.net_seen);
+    }
+    else e.net_fixed = ewma(e.net_fixed, ms, e.net_seen);
+    e.net_seen = true;
+}
+
+double CostModel::predict(size_t node, Op op, uint64_t n) const {
+    const Entry* e = find(node, op);
+    if (!e) return -1.0;
+    return e->net_fixed + (double)n * (e->compute_per_elem + e->net_per_elem);
+}
+
+void CostModel::plan(Op op, size_t nodes, uint64_t total, std::vector<double>& weights) const {
+    weights.assign(nodes, 1.0);
+    if (nodes == 0) return;
+    // 各节点的每元素代价与固定开销；没有观测的节点用已有节点的平均每元素代价
+    std::vector<double> cost(nodes, 0.0), fixed(nodes, 0.0);
+    double known = 0.0;
+    size_t nk = 0;
+    for (size_t i = 0; i < nodes; ++i) {
+        const Entry* e = find(i, op);
+        if (!e || !(e->compute_per_elem + e->net_per_elem > 0.0)) continue;
+        cost[i] = e->compute_per_elem + e->net_per_elem;
+        fixed[i] = e->net_fixed;
+        known += cost[i];
+        ++nk;
+    }
+    if (nk == 0) return;
+    for (size_t i = 0; i < nodes; ++i) {
+        if (cost[i] <= 0.0) cost[i] = known / (double)nk;
+    }
+
+    // 求 T：sum((T - fixed_i) / cost_i) = total，只计 T > fixed_i 的节点（其余分 0，之后按最小份额补）
+    std::vector<char> active(nodes, 1);
+    double T = 0.0;
+    for (;;) {
+        double inv = 0.0, acc = (double)total;
+        for (size_t i = 0; i < nodes; ++i) {
+            if (!active[i]) continue;
+            inv += 1.0 / cost[i];
+            acc += fixed[i] / cost[i];
+        }
+        T = acc / inv;
+        bool changed = false;
+        for (size_t i = 0; i < nodes; ++i) {
+            if (active[i] && T <= fixed[i]) {
+                active[i] = 0;
+                changed = true;
+            }
+        }
+        if (!changed) break;
+    }
+    const double floor = LB_MIN_SHARE * (double)total / (double)nodes;
+    for (size_t i = 0; i < nodes; ++i) {
+        const double n = active[i] ? (T - fixed[i]) / cost[i] : 0.0;
+        weights[i] = n > floor ? n : floor;
+    }
+}
+
+CostModel& cost_model() {
+    static CostModel m;
+    return m;
+}
+
+uint64_t adaptive_mid(Op op, uint64_t totalN) {
+    uint64_t mid = totalN / 2;
+    if (USE_ADAPTIVE_SPLIT && totalN > 1) {
+        std::vector<double> w;
+        cost_model().plan(op, 2, totalN, w);
+        mid = (uint64_t)((double)totalN * (w[0] / (w[0] + w[1])));
+    }
+    if (mid == 0) mid = 1;
+    if (mid >= totalN) mid = totalN - 1;
+    return mid;
+}
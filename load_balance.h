@@ -0,0 +1,58 @@
+﻿/**
+ * @file load_balance.h
+ * @brief 按实测吞吐自适应切分任务（EWMA 代价模型）
+ * * 原来双机版固定 mid = totalN / 2（或重新编译换成 split_mid_30_70），节点性能不同时快的一端要空等。
+ * 这里对每个节点、每种 Op 维护指数加权平均的代价估计：
+ *   预测耗时(n) = net_fixed + n * (compute_per_elem + net_per_elem)
+ * compute_per_elem 来自 master 本地计时与 worker 回传的 compute_ms；网络耗时由 master 在确实空等 worker 时
+ * 用 (收到结果的时刻 - 下发时刻 - compute_ms) 得到：SUM/MAX/STATS 的应答只有几十字节，记为固定开销，
+ * SORT 的结果与分到的元素数成正比，记为每元素开销。
+ * 每次调用按预测完成时间相等求各节点的元素数：n_i = (T - net_fixed_i) / cost_i，sum(n_i) = total。
+ * 节点 0 为 master，节点 w + 1 为 worker w。
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "common.h"
+
+// 新观测在 EWMA 中的权重
+#define LB_ALPHA 0.3
+// master 等待应答超过该时长（毫秒）才认为是在空等，此时才记录网络耗时
+#define LB_WAIT_MIN_MS 0.05
+// 每个节点至少分到的份额：分到 0 个元素的节点不再有观测，模型无法发现它变快了
+#define LB_MIN_SHARE 0.02
+
+static constexpr bool USE_ADAPTIVE_SPLIT = true;    // TODO：可切换，关闭后回到固定均分
+
+class CostModel {
+public:
+    // node 在 n 个元素上的计算耗时（毫秒）
+    void observe_compute(size_t node, Op op, uint64_t n, double ms);
+    // node 本次 n 个元素的结果在网络上额外花的时间（毫秒）
+    void observe_net(size_t node, Op op, uint64_t n, double ms);
+    // 预测 node 处理 n 个元素的耗时；没有观测时返回负数
+    double predict(size_t node, Op op, uint64_t n) const;
+    // 把 total 个元素分给 nodes 个节点，使预测完成时间相等，weights[i] 为节点 i 的元素数；
+    // 没有观测的节点按已有节点的平均代价估计，全部没有观测时均分
+    void plan(Op op, size_t nodes, uint64_t total, std::vector<double>& weights) const;
+
+private:
+    struct Entry {
+        double compute_per_elem = 0.0;
+        double net_per_elem = 0.0;
+        double net_fixed = 0.0;
+        bool seen = false;
+        bool net_seen = false;
+    };
+    Entry& at(size_t node, Op op);
+    const Entry* find(size_t node, Op op) const;
+
+    std::vector<std::vector<Entry>> nodes_;   // [node][op]
+};
+
+// master 全局唯一的代价模型
+CostModel& cost_model();
+
+// 双机版的切分点：master 负责 [0, mid)；关闭 USE_ADAPTIVE_SPLIT 或还没有观测时为 totalN / 2
+uint64_t adaptive_mid(Op op, uint64_t totalN);
@@ -1,24 +1,44 @@
 ﻿#include "common.h"
 #include "net.h"
+#include "cluster.h"
 #include "cpu_ops.h"
 #include "cpu_sort.h"
+#include "ext_sort.h"
+#include "load_balance.h"
+#include "numa_mem.h"
+#include "chunk_sched.h"
+#include "shm_transport.h"
+#include "spsc_ring.h"
+#include "stripe.h"
+#include "wire_codec.h"
 
 #include <iostream>
 #include <exception>
 #include <iomanip>
 
 #include <vector>
+#if defined(_WIN32)
 #ifndef NOMINMAX
 #define NOMINMAX
 #endif
 #include <windows.h>
+#else
+#include "win_compat.h"
+#endif
 #ifdef max
 #undef max
 #endif
 #ifdef min
 #undef min
 #endif
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <string>
+#include <thread>
 /**
  * @file master.cpp
  * @brief 主节点 (Master) 入口程序
@@ -33,9 +53,8 @@
 /*
 NDEBUG
 _CONSOLE
-USE_SSE = 1
 USE_OPENMP = 1
-USE_AVX2 = 1
+HAVE_KERNELS_SSE2 / HAVE_KERNELS_AVX2 / HAVE_KERNELS_AVX512（仅 cpu_dispatch.cpp，SIMD 版本在运行时选择）
 
 */
 // 提前声明，供 SpeedUp 计算使用
@@ -59,6 +78,11 @@ static inline uint64_t split_mid_30_70(uint64_t totalN) {
     return mid;
 }
 
+// 把切分点向下对齐到 DET_BLOCK 的整数倍：确定性 SUM 的块按全局下标划分，切在块中间会改变结果//
+static inline uint64_t align_split_det(uint64_t mid) {
+    return mid - mid % DET_BLOCK;
+}
+
 // ========== 单机计算接口 ==========//
 // 对 data 做 log(sqrt(x)) 后求和//
 float sum(const float data[], const int len) {
@@ -87,6 +111,7 @@ float max(const float data[], const int len) {
 float sort(const float data[], const int len, float result[]) {
     std::vector<float> tmp(data, data + len);
     if (len > 1) quicksort_by_key(tmp.data(), 0, len - 1);
+    //sort_with_engine<LogSqrtTransform>(SortEngine::INTRO, tmp.data(), len);//TODO：键语义相同，可直接替换基线排序
     for (int i = 0; i < len; ++i) result[i] = logf(sqrtf(tmp[i]));
     return 0.0f;
 }
@@ -97,10 +122,19 @@ float sort(const float data[], const int len, float result[]) {
 // - 当 data 为空时，master 根据 (begin,end) 生成序列，worker 也按协商范围自行生成
 
 // 生成 [begin, end) 的递增数据//
-static void init_local(std::vector<float>& data, uint64_t begin, uint64_t end) {
+// resize 不写内存，由各线程按与内核相同的静态切块首次写入，页面落在之后处理它的线程所在 NUMA 节点//
+static void init_local(FirstTouchVec& data, uint64_t begin, uint64_t end) {
     uint64_t n = end - begin;
     data.resize((size_t)n);
-    for (uint64_t i = 0; i < n; ++i) data[(size_t)i] = (float)(begin + i + 1);
+    float* p = data.data();
+#if defined(USE_OPENMP)
+#pragma omp parallel
+#endif
+    {
+        uint64_t b, e;
+        omp_static_range(n, b, e);
+        for (uint64_t i = b; i < e; ++i) p[i] = (float)(begin + i + 1);
+    }
 }
 
 // 确保 Winsock 只初始化一次//
@@ -109,31 +143,454 @@ static inline void ensure_wsa_inited() {
     (void)wsa;
 }
 
-// 单例形式持有 worker 端 socket//
-static SOCKET& worker_sock_ref() {
-    static SOCKET s = INVALID_SOCKET;
-    return s;
-}
-
 // 修改这里即可替换 worker(B) 的 IP，单机自测可用 127.0.0.1//
 const char* WORKER_IP = "127.0.0.1"; // TODO: 需要修改为worker IP    //192.168.137.1    //192.168.137.5（worker）  //本机测试时使用： 127.0.0.1
 
+// 一个 worker 节点的连接状态//
+struct WorkerConn {
+    WorkerAddr addr;
+    SOCKET sock = INVALID_SOCKET;
+    uint32_t features = 0;          // 当前连接协商到的特性（FEATURE_*），重连时重新协商//
+    std::vector<SOCKET> streams{};  // 协商了 FEATURE_STRIPE 时的数据连接（控制消息仍走 sock）//
+    bool no_hello = false;          // 旧版 worker 不认识 HELLO，之后不再协商//
+    bool shm_broken = false;        // 共享内存区域打不开（例如 DPC_SHM=1 但 worker 实际在另一台机器上），之后不再请求 FEATURE_SHM//
+    ProxyThread proxy{};            // 拉取式调度时替它领取块的代理线程（见 chunk_sched.h），可能还在等被窃取的块的迟到应答//
+};
+
+// worker 列表：默认只有 WORKER_IP 一个（双机模式），启动参数可指定多个（见 cluster.h 与 main）//
+static std::vector<WorkerConn>& workers_ref() {
+    static std::vector<WorkerConn> v = []() {
+        std::vector<WorkerConn> d;
+        d.push_back(WorkerConn{ WorkerAddr{ WORKER_IP, PORT } });    // WorkerConn 持有线程，只能移动//
+        return d;
+    }();
+    return v;
+}
+
+// 单例形式持有 worker 端 socket；w 为 worker 序号，双机模式下只有 0//
+static SOCKET& worker_sock_ref(size_t w = 0) {
+    return workers_ref()[w].sock;
+}
+
+// 当前连接协商到的特性（FEATURE_*），重连时重新协商//
+static uint32_t& worker_features_ref(size_t w = 0) {
+    return workers_ref()[w].features;
+}
+
+// 协商了 FEATURE_STRIPE 时的数据连接（控制消息仍走 worker_sock_ref）//
+static std::vector<SOCKET>& worker_streams_ref(size_t w = 0) {
+    return workers_ref()[w].streams;
+}
+
+// 连接建立后发送 HELLO 协商特性；旧版 worker 不认识 HELLO 会断开连接，//
+// 之后的重连不再协商，全部按原始格式收发//
+// 同机部署时请求共享内存传输（见 shm_transport.h），此时不再需要条带化的数据连接//
+static bool hello_worker(SOCKET s, size_t w = 0) {
+    WorkerConn& wc = workers_ref()[w];
+    wc.features = 0;
+    if (wc.no_hello) return true;
+    const bool shm = !wc.shm_broken && shm_wanted(wc.addr.ip.c_str());
+    const uint32_t streams_want = shm ? 0u : STRIPE_STREAMS;
+    const uint32_t want = (USE_SORT_CODEC ? FEATURE_SORT_CODEC : 0u) | (streams_want >= 2 ? FEATURE_STRIPE : 0u)
+        | (shm ? FEATURE_SHM : 0u);
+    if (!want) return true;
+    MsgHeader h{ MAGIC, (uint32_t)Op::HELLO, (uint64_t)want, (uint64_t)streams_want, 0 };
+    HelloReply hr{};
+    if (!send_all(s, &h, sizeof(h)) || !recv_all(s, &hr, sizeof(hr))) {
+        wc.no_hello = true;
+        return false;
+    }
+    // 应答含 FEATURE_STRIPE 时 worker 正在等待数据连接，逐条建立并发送序号//
+    std::vector<SOCKET>& streams = wc.streams;
+    if ((hr.features & FEATURE_STRIPE) && hr.streams >= 1 && hr.streams <= STRIPE_MAX_STREAMS) {
+        try {
+            for (uint32_t k = 0; k < hr.streams; ++k) {
+                streams.push_back(tcp_connect(wc.addr.ip.c_str(), wc.addr.port));
+                StreamHello sh{ MAGIC, k };
+                if (!send_all(streams.back(), &sh, sizeof(sh))) throw std::runtime_error("stream hello failed");
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[Master] data streams unavailable: " << e.what() << "\n";
+            for (SOCKET d : streams) close_sock(d);
+            streams.clear();
+            return false;
+        }
+    }
+    wc.features = hr.features & want & (streams.empty() ? ~FEATURE_STRIPE : ~0u);
+    return true;
+}
+
+static void settle_proxy(size_t w);
+
 // 取到已连接的 worker socket，必要时建立连接//
-static SOCKET get_worker_sock() {
-    SOCKET& s = worker_sock_ref();
+static SOCKET get_worker_sock(size_t w = 0) {
+    settle_proxy(w);
+    SOCKET& s = worker_sock_ref(w);
+    const WorkerAddr& a = workers_ref()[w].addr;
     if (s == INVALID_SOCKET) {
-        s = tcp_connect(WORKER_IP, PORT);
+        s = tcp_connect(a.ip.c_str(), a.port);
+        if (s != INVALID_SOCKET && !hello_worker(s, w)) {
+            close_sock(s);
+            s = tcp_connect(a.ip.c_str(), a.port);
+        }
     }
     return s;
 }
 
-// 关闭并重置 worker socket，供下次重连//
-static void reset_worker_sock() {
-    SOCKET& s = worker_sock_ref();
+// 接收一帧排序结果的正文（SortChunkHeader 之后的部分）到 dst；协商了压缩时先收 CodecFrameHeader 再解码//
+static bool recv_sort_frame(SOCKET c, uint32_t count, float* dst, std::vector<uint8_t>& scratch, size_t w = 0) {
+    if (!(worker_features_ref(w) & FEATURE_SORT_CODEC)) return recv_all(c, dst, count * sizeof(float));
+    CodecFrameHeader cf{};
+    if (!recv_all(c, &cf, sizeof(cf)) || cf.bytes > codec_max_bytes(count)) return false;
+    if (cf.bytes == 0) return recv_all(c, dst, count * sizeof(float));
+    scratch.resize(codec_max_bytes(SORT_CHUNK));
+    return recv_all(c, scratch.data(), cf.bytes) && codec_decode(scratch.data(), cf.bytes, count, dst);
+}
+
+// 协商了 FEATURE_SHM 时先收 ShmNotice：结果在共享内存中时映射区域并返回 true，//
+// 否则（未协商、或 worker 退回主连接发送）返回 false 且 shm 保持未映射；ok 为 false 表示主连接或映射失败//
+static bool recv_shm_notice(SOCKET c, uint64_t count, ShmRegion& shm, bool& ok, size_t w = 0) {
+    ok = true;
+    if (!(worker_features_ref(w) & FEATURE_SHM)) return false;
+    ShmNotice sn{};
+    if (!recv_all(c, &sn, sizeof(sn))) {
+        ok = false;
+        return false;
+    }
+    sn.name[SHM_NAME_MAX - 1] = 0;
+    if (!sn.name[0]) return false;
+    if (!shm.open(sn.name)) {
+        std::cerr << "[Master] shm region unavailable, fallback to tcp\n";
+        workers_ref()[w].shm_broken = true;
+        ok = false;
+    }
+    else if (sn.count != count || shm.size() != count) {
+        ok = false;
+    }
+    return true;
+}
+
+// 共享内存中的 Worker 结果作为一路有序输入：每次交出 worker 已发布而尚未消费的部分；//
+// 等待期间按 SHM_WAIT_MS 检查主连接，worker 异常退出时结束输入，由调用方按总量不符处理//
+struct ShmSource final : SortedSource {
+    ShmRegion& shm;
+    const SOCKET c;
+    uint64_t seen = 0;
+    ShmSource(ShmRegion& r, SOCKET s) : shm(r), c(s) {}
+    const float* next_block(size_t& n) override {
+        n = 0;
+        uint64_t ready = shm.wait_ready(seen, SHM_WAIT_MS);
+        while (ready <= seen && !shm.finished()) {
+            if (peer_closed(c)) return nullptr;
+            ready = shm.wait_ready(seen, SHM_WAIT_MS);
+        }
+        if (ready <= seen) return nullptr;
+        n = (size_t)(ready - seen);
+        const float* p = shm.data() + seen;
+        seen = ready;
+        return p;
+    }
+};
+
+// 关闭并重置 worker socket（连同数据连接），供下次重连//
+static void reset_worker_sock(size_t w = 0) {
+    workers_ref()[w].proxy.join();  // 先等代理线程放开这条连接//
+    SOCKET& s = worker_sock_ref(w);
     if (s != INVALID_SOCKET) {
         close_sock(s);
         s = INVALID_SOCKET;
     }
+    for (SOCKET d : worker_streams_ref(w)) close_sock(d);
+    worker_streams_ref(w).clear();
+}
+
+// 等上一次拉取式调度的代理线程结束；它在连接上出过错时关闭连接，供下次重连//
+static void settle_proxy(size_t w) {
+    ProxyThread& px = workers_ref()[w].proxy;
+    if (px.joinable() && !px.join()) reset_worker_sock(w);
+}
+
+// 等待 worker 的标量结果并喂给代价模型（见 load_balance.h）：node 为节点号（worker w 为 w + 1），n 为它负责的元素数，//
+// sent 为请求发出的时刻。只有 master 确实在空等时，收到时刻 - sent - compute_ms 才是网络耗时//
+template <class R>
+static bool recv_timed(SOCKET c, R& r, size_t node, Op op, uint64_t n, const LARGE_INTEGER& sent) {
+    LARGE_INTEGER st, ed;
+    QueryPerformanceCounter(&st);
+    if (!recv_all(c, &r, sizeof(r))) return false;
+    QueryPerformanceCounter(&ed);
+    cost_model().observe_compute(node, op, n, r.compute_ms);
+    if ((ed.QuadPart - st.QuadPart) * freqInvMs() > LB_WAIT_MIN_MS) {
+        cost_model().observe_net(node, op, n, (ed.QuadPart - sent.QuadPart) * freqInvMs() - r.compute_ms);
+    }
+    return true;
+}
+
+// ========== 多 worker 集群（worker 多于一个时，见 cluster.h）==========//
+// 树形汇聚的分叉数：0 为平铺（master 直接连接全部 worker），K > 0 时 worker 排成 K 叉树，master 只连接自己的孩子//
+static constexpr size_t TREE_ARITY = 0;   // TODO：可切换，启动参数 --tree K 可覆盖
+static size_t g_tree_arity = TREE_ARITY;
+
+// 调度方式：STATIC 按份额一次切定（cluster_plan）；PULL 切成 SCHED_CHUNK 大小的块，各节点空闲时领取下一块，//
+// 并窃取慢节点手上的块（见 chunk_sched.h）。PULL 优先于树形汇聚，只有一个 worker 时同样生效//
+enum class SchedMode : uint32_t {
+    STATIC = 0,
+    PULL = 1,
+};
+static constexpr SchedMode SCHED_MODE = SchedMode::STATIC;   // TODO：可切换，启动参数 --sched pull 可覆盖
+static SchedMode g_sched = SCHED_MODE;
+static_assert(SCHED_CHUNK % DET_BLOCK == 0, "SCHED_CHUNK must be a multiple of DET_BLOCK");
+
+// [0, totalN) 切成 1 + W 段：master 负责第 0 段，worker 按 tree_preorder 的先序依次负责之后各段；//
+// 平铺时各段份额按代价模型使预测完成时间相等（见 load_balance.h），树形汇聚时中间节点的耗时含整棵子树，仍均分//
+static void cluster_bounds(Op op, uint64_t totalN, uint64_t align, std::vector<uint64_t>& bounds) {
+    std::vector<double> weights(workers_ref().size() + 1, 1.0);
+    if (USE_ADAPTIVE_SPLIT && g_tree_arity == 0) cost_model().plan(op, weights.size(), totalN, weights);
+    split_ranges(totalN, weights, align, bounds);
+}
+
+// master 的一个直接下游：worker w 自己负责 [b, own_e)，它的后代（树形汇聚时，先序排列）负责 [own_e, e)//
+struct ClusterPart {
+    size_t w;
+    uint64_t b, own_e, e;
+    std::vector<TreeNode> sub;
+};
+
+// 按份额与树形切分 [0, totalN)，返回 master 自己的段尾；平铺时每个 worker 都是 master 的直接下游//
+static uint64_t cluster_plan(Op op, uint64_t totalN, uint64_t align, std::vector<ClusterPart>& parts) {
+    const std::vector<WorkerConn>& ws = workers_ref();
+    std::vector<uint64_t> bounds;
+    cluster_bounds(op, totalN, align, bounds);
+    std::vector<TreeSlot> order;
+    tree_preorder(ws.size(), g_tree_arity ? g_tree_arity : ws.size(), order);
+    parts.clear();
+    for (size_t p = 0; p < order.size(); p += order[p].subtree) {
+        ClusterPart cp{ order[p].worker, bounds[p + 1], bounds[p + 2], bounds[p + 1 + order[p].subtree], {} };
+        for (size_t q = p + 1; q < p + order[p].subtree; ++q) {
+            TreeNode n{};
+            std::snprintf(n.ip, sizeof(n.ip), "%s", ws[order[q].worker].addr.ip.c_str());
+            n.port = ws[order[q].worker].addr.port;
+            n.subtree = order[q].subtree;
+            n.begin = bounds[q + 1];
+            n.end = bounds[q + 2];
+            cp.sub.push_back(n);
+        }
+        parts.push_back(cp);
+    }
+    return bounds[1];
+}
+
+// 向 p.w 下发 p 的整个区间上的 op（有后代时包成 Op::TREE 连同子树一起发出）；//
+// 空段、连接不上或发送失败时返回 false，该段由 master 补算//
+static bool cluster_dispatch(const ClusterPart& p, Op op) {
+    if (p.b >= p.e) return false;
+    try {
+        SOCKET c = get_worker_sock(p.w);
+        if (c != INVALID_SOCKET && p.sub.empty()) {
+            MsgHeader h{ MAGIC, (uint32_t)op, p.e - p.b, p.b, p.e };
+            if (send_all(c, &h, sizeof(h))) return true;
+        }
+        else if (c != INVALID_SOCKET) {
+            MsgHeader h{ MAGIC, (uint32_t)Op::TREE, (uint64_t)op, p.b, p.own_e };
+            TreeHeader th{ (uint32_t)p.sub.size() };
+            const NetBuf tb[3] = { { &h, sizeof(h) }, { &th, sizeof(th) }, { p.sub.data(), p.sub.size() * sizeof(TreeNode) } };
+            if (send_iov(c, tb, 3)) return true;
+        }
+    }
+    catch (const std::exception& ex) {
+        const WorkerAddr& a = workers_ref()[p.w].addr;
+        std::cerr << "[Master] worker " << a.ip << ":" << a.port << " unavailable: " << ex.what() << "\n";
+    }
+    reset_worker_sock(p.w);
+    return false;
+}
+
+// ========== 拉取式分块调度 ==========//
+// 取 worker w 的连接交给代理线程；上一次的代理线程还在等迟到的应答、或连接不上时返回 INVALID_SOCKET，本次不参与//
+static SOCKET sched_sock(size_t w) {
+    if (workers_ref()[w].proxy.running()) return INVALID_SOCKET;
+    try {
+        return get_worker_sock(w);
+    }
+    catch (const std::exception& ex) {
+        const WorkerAddr& a = workers_ref()[w].addr;
+        std::cerr << "[Master] worker " << a.ip << ":" << a.port << " unavailable: " << ex.what() << "\n";
+    }
+    reset_worker_sock(w);
+    return INVALID_SOCKET;
+}
+
+// 拉取式标量运算：每个可用 worker 由一个代理线程替它领取块，上一块的应答一到就发出下一块的请求；//
+// master 本地也按块领取。执行者 0 为 master，worker w 为 w + 1。worker 中途失败时它手上的块放回池中，由其他节点接着算；//
+// 返回值按块号排列，调用方按顺序合并，结果与哪块由谁计算无关//
+template <class R, class LocalFn>
+static std::vector<R> sched_scalar(Op op, uint64_t totalN, LocalFn local) {
+    // 代理线程可能比本次调用活得更久（被窃取的块的应答迟到），共享状态放在 shared_ptr 里//
+    struct Shared {
+        ChunkPool pool;
+        std::vector<R> parts;
+        std::vector<double> busy_ms;    // 各执行者生效的块的计算耗时之和//
+        Shared(uint64_t n, size_t nodes) : pool(n, SCHED_CHUNK, nodes), parts(pool.size()), busy_ms(nodes, 0.0) {}
+    };
+    const size_t W = workers_ref().size();
+    std::shared_ptr<Shared> sh = std::make_shared<Shared>(totalN, W + 1);
+    for (size_t w = 0; w < W; ++w) {
+        const SOCKET c = sched_sock(w);
+        if (c == INVALID_SOCKET) continue;
+        workers_ref()[w].proxy.start([sh, c, w, op]() {
+            size_t i;
+            bool stolen;
+            while (sh->pool.acquire(w + 1, i, stolen)) {
+                const uint64_t b = sh->pool.begin(i), e = sh->pool.end(i);
+                MsgHeader h{ MAGIC, (uint32_t)op, e - b, b, e };
+                R r{};
+                if (!send_all(c, &h, sizeof(h)) || !recv_all(c, &r, sizeof(r))) {
+                    sh->pool.release(i, w + 1);
+                    return false;
+                }
+                sh->pool.complete(i, w + 1, [&]() {
+                    sh->parts[i] = r;
+                    sh->busy_ms[w + 1] += r.compute_ms;
+                });
+            }
+            return true;
+        });
+    }
+
+    size_t i;
+    bool stolen;
+    LARGE_INTEGER st, ed;
+    while (sh->pool.acquire(0, i, stolen)) {
+        QueryPerformanceCounter(&st);
+        const R r = local(sh->pool.begin(i), sh->pool.end(i));
+        QueryPerformanceCounter(&ed);
+        const double ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
+        sh->pool.complete(i, 0, [&]() {
+            sh->parts[i] = r;
+            sh->busy_ms[0] += ms;
+        });
+    }
+    // 全部块已完成，之后迟到的结果都被丢弃，这里读不会与代理线程冲突//
+    g_last_stats.local_ms += sh->busy_ms[0];
+    for (size_t w = 1; w <= W; ++w) {
+        if (sh->busy_ms[w] > g_last_stats.worker_ms) g_last_stats.worker_ms = sh->busy_ms[w];
+    }
+    return sh->parts;
+}
+
+// 集群版标量运算：先向全部直接下游下发，再计算本地段，最后逐个收结果（各 worker 同时计算）；//
+// worker 不可用或中途失败时由 master 补算它的整个区间，结果仍然完整。local(b, e) 返回与 worker 应答同类型的部分结果；//
+// 返回值第 0 项为 master 自己的段，之后依次为各直接下游（树形汇聚时已在中间 worker 上合并过）；//
+// 拉取式调度时转给 sched_scalar，返回值按块号排列//
+template <class R, class LocalFn>
+static std::vector<R> cluster_scalar(Op op, uint64_t totalN, uint64_t align, LocalFn local) {
+    if (g_sched == SchedMode::PULL) return sched_scalar<R>(op, totalN, local);
+    std::vector<ClusterPart> plan;
+    const uint64_t mine = cluster_plan(op, totalN, align, plan);
+    std::vector<char> sent(plan.size(), 0);
+    std::vector<LARGE_INTEGER> sent_at(plan.size());
+    for (size_t k = 0; k < plan.size(); ++k) {
+        sent[k] = cluster_dispatch(plan[k], op);
+        QueryPerformanceCounter(&sent_at[k]);
+    }
+
+    std::vector<R> parts(plan.size() + 1);
+    LARGE_INTEGER st, ed;
+    QueryPerformanceCounter(&st);
+    parts[0] = local(0, mine);
+    QueryPerformanceCounter(&ed);
+    g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+    cost_model().observe_compute(0, op, mine, (ed.QuadPart - st.QuadPart) * freqInvMs());
+
+    for (size_t k = 0; k < plan.size(); ++k) {
+        if (sent[k] && recv_timed(worker_sock_ref(plan[k].w), parts[k + 1], plan[k].w + 1, op, plan[k].e - plan[k].b, sent_at[k])) {
+            // 各 worker 同时计算，取最慢的一个//
+            if (parts[k + 1].compute_ms > g_last_stats.worker_ms) g_last_stats.worker_ms = parts[k + 1].compute_ms;
+            continue;
+        }
+        if (sent[k]) reset_worker_sock(plan[k].w);
+        QueryPerformanceCounter(&st);
+        parts[k + 1] = local(plan[k].b, plan[k].e);
+        QueryPerformanceCounter(&ed);
+        g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+    }
+    return parts;
+}
+
+// master 上 [b, e) 的数据：有 data 时直接用 data[b, e)，否则为空（由调用方按生成器融合计算）；//
+// 未开启生成器融合时先生成到 tmp//
+static const float* cluster_local_data(const float data[], uint64_t b, uint64_t e, FirstTouchVec& tmp) {
+    if (data) return data + b;
+    if (USE_GEN_FUSED) return nullptr;
+    init_local(tmp, b, e);
+    return tmp.data();
+}
+
+static float sumSpeedUpCluster(const float data[], uint64_t totalN) {
+    const bool det = (SUM_ENGINE == SumEngine::DET_OMP);
+    const RangeGenerator& gen = default_generator();
+    std::vector<WorkerSumResult> parts = cluster_scalar<WorkerSumResult>(Op::SUM, totalN, det ? DET_BLOCK : 1, [&](uint64_t b, uint64_t e) {
+        WorkerSumResult r{};
+        r.det = det ? 1u : 0u;
+        if (b >= e) return r;
+        FirstTouchVec tmp;
+        const float* p = cluster_local_data(data, b, e, tmp);
+        if (det) {
+            const DetSum d = p ? cpu_sum_log_sqrt_det_omp(p, e - b) : cpu_sum_log_sqrt_det_gen(gen, b, e);
+            r.value = (float)det_value(d);
+            r.det_fixed = d.fixed;
+            r.det_special = d.special;
+        }
+        else {
+            r.value = p ? cpu_sum_log_sqrt_engine(SUM_ENGINE, p, e - b) : cpu_sum_log_sqrt_gen(SUM_ENGINE, gen, b, e);
+        }
+        return r;
+    });
+
+    // 确定性引擎：定点部分和做整数加法，结果与切分位置、节点数无关//
+    DetSum d = det_identity();
+    double v = 0.0;
+    bool all_det = det;
+    for (const WorkerSumResult& r : parts) {
+        all_det = all_det && r.det;
+        d = det_combine(d, DetSum{ r.det_fixed, r.det_special });
+        v += r.value;
+    }
+    return all_det ? (float)det_value(d) : (float)v;
+}
+
+static float maxSpeedUpCluster(const float data[], uint64_t totalN) {
+    const RangeGenerator& gen = default_generator();
+    std::vector<WorkerScalarResult> parts = cluster_scalar<WorkerScalarResult>(Op::MAX, totalN, 1, [&](uint64_t b, uint64_t e) {
+        WorkerScalarResult r{ -INFINITY, 0.0 };
+        if (b >= e) return r;
+        FirstTouchVec tmp;
+        const float* p = cluster_local_data(data, b, e, tmp);
+        r.value = p ? cpu_max_transformed_omp<LogSqrtTransform>(p, e - b) : cpu_max_transformed_gen<LogSqrtTransform>(gen, b, e);
+        return r;
+    });
+    float m = -INFINITY;
+    for (const WorkerScalarResult& r : parts) m = (r.value > m ? r.value : m);
+    return m;
+}
+
+static StatsResult statsSpeedUpCluster(const float data[], uint64_t totalN) {
+    const RangeGenerator& gen = default_generator();
+    std::vector<WorkerStatsResult> parts = cluster_scalar<WorkerStatsResult>(Op::STATS, totalN, 1, [&](uint64_t b, uint64_t e) {
+        StatsResult v = stats_identity();
+        if (b < e) {
+            FirstTouchVec tmp;
+            const float* p = cluster_local_data(data, b, e, tmp);
+            v = p ? cpu_stats_log_sqrt_omp(p, e - b) : cpu_stats_log_sqrt_gen(gen, b, e);
+            stats_offset(v, b);    // 与 worker 一致，argmax 换算为全局下标//
+        }
+        return WorkerStatsResult{ v.count, v.sum, v.m2, v.min, v.max, v.argmax, 0.0 };
+    });
+    StatsResult all = stats_identity();
+    for (const WorkerStatsResult& r : parts) {
+        all = StatsReducer::combine(all, StatsResult{ r.count, r.sum, r.m2, r.min, r.max, r.argmax });
+    }
+    return all;
 }
 
 // 双机版 sum：master 计算前半段，worker 计算后半段再求和//
@@ -141,25 +598,34 @@ float sumSpeedUp(const float data[], const int len) {
     ensure_wsa_inited();
     g_last_stats = SpeedStats{};
     if (len <= 0) return 0.0f;
+    if (workers_ref().size() > 1 || g_sched == SchedMode::PULL) return sumSpeedUpCluster(data, (uint64_t)len);
 
     const uint64_t totalN = (uint64_t)len;
-    const uint64_t mid = totalN / 2; // TODO: 可切换为 split_mid_30_70(totalN)，worker\master可以调整比例
-    //const uint64_t mid = split_mid_30_70(totalN);
+    uint64_t mid = adaptive_mid(Op::SUM, totalN); // TODO: 按实测吞吐自适应（见 load_balance.h），可切换为 totalN / 2 或 split_mid_30_70(totalN)
+    //uint64_t mid = totalN / 2;//
+    //uint64_t mid = split_mid_30_70(totalN);
+    const bool det = (SUM_ENGINE == SumEngine::DET_OMP);
+    if (det) mid = align_split_det(mid);
 
     // 优先使用用户给的数据//
-    std::vector<float> localA;
+    // 未给出 data 时默认边生成边计算（见 range_gen.h），不物化 [0, mid)//
+    const bool fused = USE_GEN_FUSED && !(data && (uint64_t)len >= mid);
+    const RangeGenerator& gen = default_generator();
+    FirstTouchVec localA;
     const float* aPtr = nullptr;
     int64_t aN = (int64_t)mid;
+    double gen_ms = 0.0;    // 生成 [0, mid) 的耗时（只在未融合时非 0）//
 
     if (data && (uint64_t)len >= mid) {
         aPtr = data; // 直接用 data[0..mid)
     }
-    else {
+    else if (!fused) {
         LARGE_INTEGER st, ed;
         QueryPerformanceCounter(&st);
         init_local(localA, 0, mid);
         QueryPerformanceCounter(&ed);
-        g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+        gen_ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
+        g_last_stats.local_ms += gen_ms;
         aPtr = localA.data();
         aN = (int64_t)localA.size();
     }
@@ -169,7 +635,7 @@ float sumSpeedUp(const float data[], const int len) {
         // Worker 不可用则退化为单机
         LARGE_INTEGER st, ed;
         QueryPerformanceCounter(&st);
-        float v = sum(aPtr, (int)aN);
+        float v = fused ? cpu_sum_log_sqrt_gen(SumEngine::SCALAR, gen, 0, mid) : sum(aPtr, (int)aN);
         QueryPerformanceCounter(&ed);
         g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
         return v;
@@ -177,11 +643,13 @@ float sumSpeedUp(const float data[], const int len) {
 
     // 通知 Worker 处理 [mid, totalN)
     MsgHeader h{ MAGIC, (uint32_t)Op::SUM, (uint64_t)(totalN - mid), mid, totalN };
+    LARGE_INTEGER sent;
+    QueryPerformanceCounter(&sent);
     if (!send_all(c, &h, sizeof(h))) {
         reset_worker_sock();
         LARGE_INTEGER st, ed;
         QueryPerformanceCounter(&st);
-        float v = sum(aPtr, (int)aN);
+        float v = fused ? cpu_sum_log_sqrt_gen(SumEngine::SCALAR, gen, 0, mid) : sum(aPtr, (int)aN);
         QueryPerformanceCounter(&ed);
         g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
         return v;
@@ -192,21 +660,39 @@ float sumSpeedUp(const float data[], const int len) {
     QueryPerformanceCounter(&st);
     //float aPart = cpu_sum_log_sqrt(aPtr, aN);//
     //float aPart = cpu_sum_log_sqrt_sse(aPtr, (uint64_t)aN);// 
-    float aPart = cpu_sum_log_sqrt_sse_omp(aPtr, (uint64_t)aN);    //TODO：可选择无SSE和OpenMP版本或单独启用SSE
+    //float aPart = cpu_sum_log_sqrt_sse_omp(aPtr, (uint64_t)aN);//
+    DetSum aDet = det_identity();
+    float aPart = 0.0f;
+    if (det) {
+        aDet = fused ? cpu_sum_log_sqrt_det_gen(gen, 0, mid) : cpu_sum_log_sqrt_det_omp(aPtr, (uint64_t)aN);
+        aPart = (float)det_value(aDet);
+    }
+    else if (fused) {
+        aPart = cpu_sum_log_sqrt_gen(SUM_ENGINE, gen, 0, mid);
+    }
+    else {
+        aPart = cpu_sum_log_sqrt_engine(SUM_ENGINE, aPtr, (uint64_t)aN);    //TODO：可选择无SSE和OpenMP版本或单独启用SSE；引擎由 cpu_ops.h 中的 SUM_ENGINE 决定
+    }
     QueryPerformanceCounter(&ed);
     g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+    // worker 的 compute_ms 含生成数据（未融合时），这里同样只计生成与计算两段，不含连接与下发//
+    cost_model().observe_compute(0, Op::SUM, mid, gen_ms + (ed.QuadPart - st.QuadPart) * freqInvMs());
 
 
 
     
     // 等待 Worker 的结果//
-    WorkerScalarResult wres{};
-    if (!recv_all(c, &wres, sizeof(wres))) {
+    WorkerSumResult wres{};
+    if (!recv_timed(c, wres, 1, Op::SUM, totalN - mid, sent)) {
         reset_worker_sock();
         return aPart;
     }
     g_last_stats.worker_ms = wres.compute_ms;
 
+    // 确定性引擎：定点部分和做整数加法，结果与切分位置无关//
+    if (det && wres.det) {
+        return (float)det_value(det_combine(aDet, DetSum{ wres.det_fixed, wres.det_special }));
+    }
     return aPart + wres.value;
 }
 
@@ -215,24 +701,31 @@ float maxSpeedUp(const float data[], const int len) {
     ensure_wsa_inited();
     g_last_stats = SpeedStats{};
     if (len <= 0) return -INFINITY;
+    if (workers_ref().size() > 1 || g_sched == SchedMode::PULL) return maxSpeedUpCluster(data, (uint64_t)len);
 
     const uint64_t totalN = (uint64_t)len;
-    const uint64_t mid = totalN / 2; // TODO: 可切换为 split_mid_30_70(totalN)
+    const uint64_t mid = adaptive_mid(Op::MAX, totalN); // TODO: 按实测吞吐自适应（见 load_balance.h），可切换为 totalN / 2 或 split_mid_30_70(totalN)
+    //const uint64_t mid = totalN / 2;//
     //const uint64_t mid = split_mid_30_70(totalN);
 
-    std::vector<float> localA;
+    // 未给出 data 时默认边生成边计算（见 range_gen.h），不物化 [0, mid)//
+    const bool fused = USE_GEN_FUSED && !(data && (uint64_t)len >= mid);
+    const RangeGenerator& gen = default_generator();
+    FirstTouchVec localA;
     const float* aPtr = nullptr;
     int64_t aN = (int64_t)mid;
+    double gen_ms = 0.0;    // 生成 [0, mid) 的耗时（只在未融合时非 0）//
 
     if (data && (uint64_t)len >= mid) {
         aPtr = data; // data[0..mid)
     }
-    else {
+    else if (!fused) {
         LARGE_INTEGER st, ed;
         QueryPerformanceCounter(&st);
         init_local(localA, 0, mid);
         QueryPerformanceCounter(&ed);
-        g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+        gen_ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
+        g_last_stats.local_ms += gen_ms;
         aPtr = localA.data();
         aN = (int64_t)localA.size();
     }
@@ -241,7 +734,7 @@ float maxSpeedUp(const float data[], const int len) {
     if (c == INVALID_SOCKET) {
         LARGE_INTEGER st, ed;
         QueryPerformanceCounter(&st);
-        float v = max_function(aPtr, (int)aN);
+        float v = fused ? cpu_max_transformed_gen<LogSqrtTransform>(gen, 0, mid) : max_function(aPtr, (int)aN);
         QueryPerformanceCounter(&ed);
         g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
         return v;
@@ -249,11 +742,13 @@ float maxSpeedUp(const float data[], const int len) {
     //
     // 通知 Worker 处理 [mid, totalN)//
     MsgHeader h{ MAGIC, (uint32_t)Op::MAX, (uint64_t)(totalN - mid), mid, totalN };
+    LARGE_INTEGER sent;
+    QueryPerformanceCounter(&sent);
     if (!send_all(c, &h, sizeof(h))) {
         reset_worker_sock();
         LARGE_INTEGER st, ed;
         QueryPerformanceCounter(&st);
-        float v = max_function(aPtr, (int)aN);
+        float v = fused ? cpu_max_transformed_gen<LogSqrtTransform>(gen, 0, mid) : max_function(aPtr, (int)aN);
         QueryPerformanceCounter(&ed);
         g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
         return v;
@@ -264,15 +759,19 @@ float maxSpeedUp(const float data[], const int len) {
     QueryPerformanceCounter(&st);
     //float aMax = cpu_max_log_sqrt(aPtr, aN);//
     //float aMax = cpu_max_log_sqrt_sse(aPtr, (uint64_t)aN);//
-    float aMax = cpu_max_log_sqrt_sse_omp(aPtr, (uint64_t)aN);    //TODO：可选择无SSE和OpenMP版本或单独启用SSE
+    //float aMax = cpu_max_log_sqrt_sse_omp(aPtr, (uint64_t)aN);//
+    float aMax = fused ? cpu_max_transformed_gen<LogSqrtTransform>(gen, 0, mid)
+        : cpu_max_transformed_omp<LogSqrtTransform>(aPtr, (uint64_t)aN);    //TODO：可选择无SSE和OpenMP版本或单独启用SSE；单调变换下推，只对原始最大值取一次 log
     QueryPerformanceCounter(&ed);
     g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+    // worker 的 compute_ms 含生成数据（未融合时），这里同样只计生成与计算两段，不含连接与下发//
+    cost_model().observe_compute(0, Op::MAX, mid, gen_ms + (ed.QuadPart - st.QuadPart) * freqInvMs());
 
 
 
     // 等待 Worker 的结果//
     WorkerScalarResult wres{};
-    if (!recv_all(c, &wres, sizeof(wres))) {
+    if (!recv_timed(c, wres, 1, Op::MAX, totalN - mid, sent)) {
         reset_worker_sock();
         return aMax;
     }
@@ -281,105 +780,747 @@ float maxSpeedUp(const float data[], const int len) {
     return (aMax > wres.value ? aMax : wres.value);
 }
 
-// 双机版 sort：两端各自排序后再归并，result 写入 log(sqrt(.))//
-float sortSpeedUp(const float data[], const int len, float result[]) {
+// 双机版 stats：一次遍历得到 min/max/sum/均值/方差/argmax，两端结果用 Welford/Chan 公式合并//
+StatsResult statsSpeedUp(const float data[], const int len) {
     ensure_wsa_inited();
     g_last_stats = SpeedStats{};
-    if (len <= 0 || !result) return 0.0f;
+    if (len <= 0) return stats_identity();
+    if (workers_ref().size() > 1 || g_sched == SchedMode::PULL) return statsSpeedUpCluster(data, (uint64_t)len);
 
     const uint64_t totalN = (uint64_t)len;
-    const uint64_t mid = totalN / 2; // TODO: 可切换为 split_mid_30_70(totalN)
+    const uint64_t mid = adaptive_mid(Op::STATS, totalN); // TODO: 按实测吞吐自适应（见 load_balance.h），可切换为 totalN / 2 或 split_mid_30_70(totalN)
+    //const uint64_t mid = totalN / 2;//
     //const uint64_t mid = split_mid_30_70(totalN);
 
-    // 尽可能直接复用用户数据//
-    std::vector<float> localA;
+    // 未给出 data 时默认边生成边计算（见 range_gen.h），不物化 [0, mid)//
+    const bool fused = USE_GEN_FUSED && !(data && (uint64_t)len >= mid);
+    const RangeGenerator& gen = default_generator();
+    FirstTouchVec localA;
+    const float* aPtr = nullptr;
+    int64_t aN = (int64_t)mid;
+    double gen_ms = 0.0;    // 生成 [0, mid) 的耗时（只在未融合时非 0）//
+
     if (data && (uint64_t)len >= mid) {
+        aPtr = data; // data[0..mid)
+    }
+    else if (!fused) {
         LARGE_INTEGER st, ed;
         QueryPerformanceCounter(&st);
-        localA.assign(data, data + mid);
+        init_local(localA, 0, mid);
         QueryPerformanceCounter(&ed);
-        g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+        gen_ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
+        g_last_stats.local_ms += gen_ms;
+        aPtr = localA.data();
+        aN = (int64_t)localA.size();
     }
-    else {
+
+    SOCKET c = get_worker_sock();
+    MsgHeader h{ MAGIC, (uint32_t)Op::STATS, (uint64_t)(totalN - mid), mid, totalN };
+    LARGE_INTEGER sent;
+    QueryPerformanceCounter(&sent);
+    if (c == INVALID_SOCKET || !send_all(c, &h, sizeof(h))) {
+        // Worker 不可用时只统计本地段（与 sum/max 的退化方式一致）
+        if (c != INVALID_SOCKET) reset_worker_sock();
         LARGE_INTEGER st, ed;
         QueryPerformanceCounter(&st);
-        init_local(localA, 0, mid);
+        StatsResult v = fused ? cpu_stats_log_sqrt_gen(gen, 0, mid) : cpu_stats_log_sqrt_omp(aPtr, (uint64_t)aN);
         QueryPerformanceCounter(&ed);
         g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+        return v;
     }
 
-    //错误处理
-    SOCKET c = get_worker_sock();
-    if (c == INVALID_SOCKET) {
-        // Worker 不可用时，全量单机排序//
-        LARGE_INTEGER st, ed;
-        std::vector<float> full;
-        if (data && (uint64_t)len >= totalN) {
-            QueryPerformanceCounter(&st);
-            full.assign(data, data + totalN);
-            QueryPerformanceCounter(&ed);
-            g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
-        }
-        else {
-            QueryPerformanceCounter(&st);
-            init_local(full, 0, totalN);
-            QueryPerformanceCounter(&ed);
-            g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
-        }
+    // 本地计算前半段（master 负责 [0, mid)，argmax 已是全局下标）//
+    LARGE_INTEGER st, ed;
+    QueryPerformanceCounter(&st);
+    //StatsResult aStats = cpu_stats_log_sqrt(aPtr, (uint64_t)aN);//
+    StatsResult aStats = fused ? cpu_stats_log_sqrt_gen(gen, 0, mid)
+        : cpu_stats_log_sqrt_omp(aPtr, (uint64_t)aN);    //TODO：可选择标量 Welford 基线
+    QueryPerformanceCounter(&ed);
+    g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+    // worker 的 compute_ms 含生成数据（未融合时），这里同样只计生成与计算两段，不含连接与下发//
+    cost_model().observe_compute(0, Op::STATS, mid, gen_ms + (ed.QuadPart - st.QuadPart) * freqInvMs());
+
+    // 等待 Worker 的结果//
+    WorkerStatsResult wres{};
+    if (!recv_timed(c, wres, 1, Op::STATS, totalN - mid, sent)) {
+        reset_worker_sock();
+        return aStats;
+    }
+    g_last_stats.worker_ms = wres.compute_ms;
 
+    StatsResult bStats{ wres.count, wres.sum, wres.m2, wres.min, wres.max, wres.argmax };
+    return StatsReducer::combine(aStats, bStats);
+}
+
+// 双机排序方式//
+enum class SortMode : uint32_t {
+    MERGE = 0,      // 按下标对半切分，worker 回传有序的一半，master 归并
+    SPLITTER = 1    // 样本排序：按键分割点划分，worker 的结果直接收进 result 尾部，无归并
+};
+static constexpr SortMode SORT_MODE = SortMode::SPLITTER;   // TODO：可切换双机排序方式
+
+// 样本排序版 sort（见 cpu_sort.h 与 common.h 中的 SORT_SPLIT 协议）：//
+// master 负责 key code < splitter 的元素并写入 result 开头，worker 的有序结果由接收线程直接写入 result 尾部，//
+// 接收与 master 自己的排序重叠进行。数据由两端按下标各自生成，要求 data 为空。//
+static float sortSpeedUpSplit(const uint64_t totalN, float result[]) {
+    const uint64_t mid = adaptive_mid(Op::SORT_SPLIT, totalN); // TODO: 按实测吞吐自适应（见 load_balance.h），可切换为 totalN / 2 或 split_mid_30_70(totalN)，决定 master 负责的键比例
+    //const uint64_t mid = totalN / 2;//
+    const RangeGenerator& gen = default_generator();
+    FirstTouchVec localA;
+
+    // 任一步网络失败时全量单机排序//
+    auto local_all = [&]() {
+        LARGE_INTEGER st, ed;
         QueryPerformanceCounter(&st);
-        if (full.size() > 1) quicksort_by_key(full.data(), 0, (int64_t)full.size() - 1);
-        for (int i = 0; i < len; ++i) result[i] = key_log_sqrt(full[(size_t)i]);
+        select_by_code(gen, 0, totalN, 0, 0x100000000ULL, localA);
+        sort_with_engine<LogSqrtTransform>(SORT_ENGINE, localA.data(), (int64_t)localA.size());
+        transform_log_sqrt_sse_omp(localA.data(), result, (uint64_t)localA.size());
         QueryPerformanceCounter(&ed);
         g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
         return 0.0f;
-    }
-    
-    
-    MsgHeader h{ MAGIC, (uint32_t)Op::SORT, (uint64_t)(totalN - mid), mid, totalN };
+    };
+
+    SOCKET c = get_worker_sock();
+    if (c == INVALID_SOCKET) return local_all();
+    MsgHeader h{ MAGIC, (uint32_t)Op::SORT_SPLIT, (uint64_t)(totalN - mid), mid, totalN };
     if (!send_all(c, &h, sizeof(h))) {
         reset_worker_sock();
-        return sortSpeedUp(data, len, result); // Fallback 重试连接 Worker
+        return local_all();
     }
 
-    // 等待 Worker 返回排序结果的字节数//
-    WorkerSortHeader wh{};
-    if (!recv_all(c, &wh, sizeof(wh))) {
+    // 1) 合并两端样本，按 master 应负责的比例选分割点//
+    LARGE_INTEGER st, ed;
+    QueryPerformanceCounter(&st);
+    WorkerSortSample ws{};
+    if (!recv_all(c, &ws, sizeof(ws)) || ws.count > SORT_SAMPLE) {
         reset_worker_sock();
-        return sort(data, len, result);
+        return local_all();
     }
-    g_last_stats.worker_ms = wh.compute_ms;
-    uint64_t bBytes = wh.bytes;
-    if (bBytes % sizeof(float) != 0) {
+    const uint32_t aCount = (uint32_t)SORT_SAMPLE - (uint32_t)((uint64_t)SORT_SAMPLE * (totalN - mid) / totalN);
+    std::vector<uint32_t> sample((size_t)aCount + ws.count);
+    if (ws.count && !recv_all(c, sample.data() + aCount, ws.count * sizeof(uint32_t))) {
         reset_worker_sock();
-        return sort(data, len, result);
+        return local_all();
     }
-    uint64_t bN = bBytes / sizeof(float);
+    sample_codes(gen, 0, mid, aCount, 0x5A3D1E5ULL, sample.data());
+    SortSplitter sp{ choose_splitter(sample, (double)mid / (double)totalN) };
+    LARGE_INTEGER sent;
+    QueryPerformanceCounter(&sent);
+    if (!send_all(c, &sp, sizeof(sp))) {
+        reset_worker_sock();
+        return local_all();
+    }
+    // 样本交换（含等待 worker 的样本）计入 local_ms，但不算作计算耗时：worker 的 compute_ms 从收到分割点开始，//
+    // master 的计算计时同样从分割点发出之后开始//
+    LARGE_INTEGER cst;
+    QueryPerformanceCounter(&cst);
+    g_last_stats.local_ms += (cst.QuadPart - st.QuadPart) * freqInvMs();
+
+    // 2) 挑出自己键区间内的元素，由此确定 worker 结果在 result 中的偏移//
+    select_by_code(gen, 0, totalN, 0, sp.code, localA);
+    const uint64_t aN = (uint64_t)localA.size();
+
+    // 3) 接收线程：worker 的结果直接写入 result[aN, totalN)，与下面的本地排序重叠//
+    bool recv_ok = false;
+    double worker_ms = 0.0;
+    LARGE_INTEGER recv_done{};
+    auto receive = [&]() {
+        // 结果在共享内存中：worker 写完后才发 ShmNotice，映射后直接拷到 result 尾部//
+        ShmRegion shm;
+        bool notice_ok = true;
+        if (recv_shm_notice(c, totalN - aN, shm, notice_ok)) {
+            if (!notice_ok || !shm.ok()) return;
+            worker_ms = shm.compute_ms();
+            std::memcpy(result + aN, shm.data(), (size_t)shm.size() * sizeof(float));
+            recv_ok = true;
+            return;
+        }
+        if (!notice_ok) return;
+        WorkerSortHeader wh{};
+        if (!recv_all(c, &wh, sizeof(wh))) return;
+        worker_ms = wh.compute_ms;
+        if (wh.bytes != (totalN - aN) * sizeof(float)) return;
+        if (worker_features_ref() & FEATURE_STRIPE) {
+            // 各数据连接的接收线程把自己的块直接写入（或解码到）result 的对应偏移//
+            recv_ok = stripe_recv(worker_streams_ref(), result + aN, totalN - aN, (worker_features_ref() & FEATURE_SORT_CODEC) != 0);
+            return;
+        }
+        if (!(worker_features_ref() & FEATURE_SORT_CODEC)) {
+            recv_ok = wh.bytes == 0 || recv_all(c, result + aN, (size_t)wh.bytes);
+            return;
+        }
+        // 压缩格式：按帧解码到各自的位置//
+        std::vector<uint8_t> scratch;
+        uint64_t got = 0;
+        for (;;) {
+            SortChunkHeader ch{};
+            if (!recv_all(c, &ch, sizeof(ch)) || ch.count > SORT_CHUNK || got + ch.count > totalN - aN) return;
+            if (ch.count == 0) break;
+            if (!recv_sort_frame(c, ch.count, result + aN + got, scratch)) return;
+            got += ch.count;
+        }
+        recv_ok = got == totalN - aN;
+    };
+    std::thread receiver([&]() {
+        numa_release_thread();  // 不继承主线程绑定的单个 CPU（见 numa_mem.h）//
+        receive();
+        QueryPerformanceCounter(&recv_done);
+    });
+
+    // 本地乱序一次后排序，变换结果直接写入 result 开头//
+    shuffle_fisher_yates(localA.data(), aN, 0x1234ULL);
+    sort_with_engine<LogSqrtTransform>(SORT_ENGINE, localA.data(), (int64_t)aN);    //TODO：排序引擎由 cpu_sort.h 中的 SORT_ENGINE 决定
+    transform_log_sqrt_sse_omp(localA.data(), result, aN);
+    QueryPerformanceCounter(&ed);
+    g_last_stats.local_ms += (ed.QuadPart - cst.QuadPart) * freqInvMs();
 
-    std::vector<float> sortedB((size_t)bN);
-    if (bBytes > 0 && !recv_all(c, sortedB.data(), (size_t)bBytes)) {
+    receiver.join();
+    g_last_stats.worker_ms = worker_ms;
+    if (!recv_ok) {
         reset_worker_sock();
-        return sort(data, len, result);
+        return local_all();
     }
+    // 接收线程不受本地排序牵制，收完的时刻 - 分割点发出的时刻 - compute_ms 即网络耗时（见 load_balance.h）//
+    cost_model().observe_compute(0, Op::SORT_SPLIT, aN, (ed.QuadPart - cst.QuadPart) * freqInvMs());
+    cost_model().observe_compute(1, Op::SORT_SPLIT, totalN - aN, worker_ms);
+    cost_model().observe_net(1, Op::SORT_SPLIT, totalN - aN, (recv_done.QuadPart - sent.QuadPart) * freqInvMs() - worker_ms);
+    return 0.0f;
+}
 
-    // 本地乱序一次后按 key 排序，避免与 Worker 排序完全一致//
+// 双机版 sort：两端各自排序后再归并，result 写入 log(sqrt(.))//
+// 外部排序归并的两端：Worker 数据流作为一路有序输入，归并结果变换后写入 result//
+struct RingSource final : SortedSource {
+    SpscRing<float, SORT_RING_SLOTS>& ring;
+    const uint64_t cap;
+    uint64_t seen = 0;
+    bool held = false;
+    RingSource(SpscRing<float, SORT_RING_SLOTS>& r, uint64_t c) : ring(r), cap(c) {}
+    const float* next_block(size_t& n) override {
+        if (held) ring.consumer_release();
+        held = false;
+        const float* p = ring.consumer_acquire(n);
+        // 防御：worker 发来的总量超过预期时停止消费，不越界写 result//
+        if (p && seen + n > cap) {
+            ring.abandon();
+            return nullptr;
+        }
+        if (p) {
+            seen += n;
+            held = true;
+        }
+        return p;
+    }
+};
+
+struct TransformSink final : MergeSink {
+    float* out;
+    const uint64_t cap;
+    uint64_t off = 0;
+    TransformSink(float* o, uint64_t c) : out(o), cap(c) {}
+    bool consume(const float* raw, size_t n) override {
+        if (off + n > cap) return false;
+        transform_log_sqrt_sse_omp(raw, out + off, (uint64_t)n);
+        off += n;
+        return true;
+    }
+};
+
+// 一个 Worker 的 SORT 结果流（请求已发出）：接收线程把结果帧依次放进环形缓冲，除 result 外只占//
+// SORT_RING_SLOTS * SORT_CHUNK 个 float；同机部署时 Worker 的结果直接排序在共享内存中，//
+// 接收线程只映射区域，归并时边等 worker 发布边读//
+class WorkerSortStream {
+public:
+    SpscRing<float, SORT_RING_SLOTS> ring;
+    ShmRegion shm;
+
+    WorkerSortStream(size_t w, uint64_t count)
+        : ring(SORT_CHUNK), w_(w), c_(worker_sock_ref(w)), cap_(count), route_f_(route_.get_future()) {}
+    ~WorkerSortStream() {
+        if (rx_.joinable()) rx_.join();
+    }
+    WorkerSortStream(const WorkerSortStream&) = delete;
+    WorkerSortStream& operator=(const WorkerSortStream&) = delete;
+
+    void start() {
+        rx_ = std::thread([this]() {
+            numa_release_thread();  // 不继承主线程绑定的单个 CPU（见 numa_mem.h）//
+            receive();
+        });
+    }
+
+    // 结果是否在共享内存中（等到接收线程收到 ShmNotice）；主连接或映射失败时为 false，环形缓冲已关闭//
+    bool in_shm() {
+        if (!routed_) {
+            from_shm_ = route_f_.get() && shm_ok_;
+            routed_ = true;
+        }
+        return from_shm_;
+    }
+
+    // 作为 k 路归并的一路输入//
+    std::unique_ptr<SortedSource> source() {
+        if (in_shm()) return std::unique_ptr<SortedSource>(new ShmSource(shm, c_));
+        return std::unique_ptr<SortedSource>(new RingSource(ring, cap_));
+    }
+
+    // 等接收线程结束；结果完整时返回 true//
+    bool finish() {
+        in_shm();
+        if (rx_.joinable()) rx_.join();
+        if (from_shm_) {
+            worker_ms_ = shm.compute_ms();
+            return shm.ok();
+        }
+        return shm_ok_ && ring.ok() && got_ == cap_;
+    }
+
+    size_t worker() const { return w_; }
+    uint64_t cap() const { return cap_; }
+    SOCKET sock() const { return c_; }
+    double worker_ms() const { return worker_ms_; }
+
+private:
+    void receive() {
+        const bool notice = recv_shm_notice(c_, cap_, shm, shm_ok_, w_);
+        route_.set_value(notice || !shm_ok_);  // 映射失败也算确定，之后按失败处理//
+        if (notice || !shm_ok_) {
+            if (!shm_ok_) ring.close(false);
+            return;
+        }
+        // 等待 Worker 返回排序结果的字节数//
+        WorkerSortHeader wh{};
+        if (!recv_all(c_, &wh, sizeof(wh)) || wh.bytes % sizeof(float) != 0 || wh.bytes / sizeof(float) != cap_) {
+            ring.close(false);
+            return;
+        }
+        worker_ms_ = wh.compute_ms;
+        std::vector<uint8_t> scratch;
+        uint64_t got = 0;
+        for (;;) {
+            SortChunkHeader ch{};
+            if (!recv_all(c_, &ch, sizeof(ch)) || ch.count > SORT_CHUNK || got + ch.count > cap_) break;
+            if (ch.count == 0) {
+                got_ = got;
+                ring.close(got == cap_);
+                return;
+            }
+            float* slot = ring.producer_acquire();
+            if (!slot || !recv_sort_frame(c_, ch.count, slot, scratch, w_)) break;
+            ring.producer_commit(ch.count);
+            got += ch.count;
+        }
+        ring.close(false);
+    }
+
+    const size_t w_;
+    const SOCKET c_;
+    const uint64_t cap_;
+    std::promise<bool> route_;
+    std::future<bool> route_f_;
+    bool routed_ = false;
+    bool from_shm_ = false;
+    bool shm_ok_ = true;
+    uint64_t got_ = 0;
+    double worker_ms_ = 0.0;
+    std::thread rx_;
+};
+
+// 全量单机排序（Worker 不可用或集群排序失败时）//
+static float sortLocalAll(const float data[], const uint64_t totalN, float result[]) {
     LARGE_INTEGER st, ed;
+    if (!data && ext_sort_wanted(totalN)) {
+        // 超出内存预算：外部排序，归并结果变换后直接写入 result//
+        QueryPerformanceCounter(&st);
+        ExtRunSet runs("master");
+        std::vector<std::unique_ptr<SortedSource>> src;
+        TransformSink sink(result, totalN);
+        const bool ok = runs.build(default_generator(), 0, totalN, 0x1234ULL) && runs.open(src)
+            && ext_merge(src, sink) == totalN;
+        QueryPerformanceCounter(&ed);
+        g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+        if (ok) return 0.0f;
+    }
+    FirstTouchVec full;
+    if (data) {
+        QueryPerformanceCounter(&st);
+        full.assign(data, data + totalN);
+        QueryPerformanceCounter(&ed);
+        g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+    }
+    else {
+        QueryPerformanceCounter(&st);
+        init_local(full, 0, totalN);
+        QueryPerformanceCounter(&ed);
+        g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+    }
+
     QueryPerformanceCounter(&st);
-    shuffle_fisher_yates(localA.data(), (uint64_t)localA.size(), 0x1234ULL);
-    if (localA.size() > 1) quicksort_by_key(localA.data(), 0, (int64_t)localA.size() - 1);
+    //sort_by_transform<LogSqrtTransform>(full.data(), (int64_t)full.size());//
+    sort_with_engine<LogSqrtTransform>(SORT_ENGINE, full.data(), (int64_t)full.size());    //TODO：排序引擎由 cpu_sort.h 中的 SORT_ENGINE 决定
+    transform_log_sqrt_sse_omp(full.data(), result, totalN);
     QueryPerformanceCounter(&ed);
     g_last_stats.local_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+    return 0.0f;
+}
+
+// 集群版 sort：各 worker 排序自己的段，master 排序第 0 段（以及下发失败的段），//
+// 全部有序流做 k 路败者树归并（见 ext_sort.h），边收边归并并变换写入 result；//
+// 树形汇聚时中间 worker 已把子树归并成一条有序流，master 只归并 1 + K 路//
+static float sortSpeedUpCluster(const float data[], const uint64_t totalN, float result[]) {
+    std::vector<ClusterPart> plan;
+    const uint64_t mine_e = cluster_plan(Op::SORT, totalN, 1, plan);
+
+    // 先向全部直接下游下发，接收线程随即开始收结果//
+    std::vector<std::unique_ptr<WorkerSortStream>> streams;
+    std::vector<std::pair<uint64_t, uint64_t>> mine{ { 0, mine_e } };
+    for (const ClusterPart& p : plan) {
+        if (!cluster_dispatch(p, Op::SORT)) {
+            if (p.b < p.e) mine.push_back({ p.b, p.e });
+            continue;
+        }
+        streams.emplace_back(new WorkerSortStream(p.w, p.e - p.b));
+        streams.back()->start();
+    }
+    uint64_t localN = 0;
+    for (const auto& r : mine) localN += r.second - r.first;
+
+    // 本地各段：超出内存预算时落盘为顺串，否则生成到 localA 后排序//
+    LARGE_INTEGER st, ed;
+    double mine_ms = 0.0;   // 本地段的生成与排序耗时，与 worker 的 compute_ms 口径一致//
+    std::vector<std::unique_ptr<ExtRunSet>> runs;
+    std::vector<std::unique_ptr<SortedSource>> src;
+    bool ext = !data && ext_sort_wanted(localN);
+    if (ext) {
+        QueryPerformanceCounter(&st);
+        for (size_t i = 0; ext && i < mine.size(); ++i) {
+            if (mine[i].first >= mine[i].second) continue;
+            runs.emplace_back(new ExtRunSet(("master" + std::to_string(i)).c_str()));
+            ext = runs.back()->build(default_generator(), mine[i].first, mine[i].second, 0x1234ULL) && runs.back()->open(src);
+        }
+        QueryPerformanceCounter(&ed);
+        mine_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+        if (!ext) {
+            src.clear();    // 磁盘不可用时退回内存排序//
+            runs.clear();
+        }
+    }
+    FirstTouchVec localA;
+    if (!ext) {
+        QueryPerformanceCounter(&st);
+        localA.resize((size_t)localN);
+        uint64_t off = 0;
+        for (const auto& r : mine) {
+            if (data) std::copy(data + r.first, data + r.second, localA.data() + off);
+            else {
+                float* p = localA.data() + off;
+#if defined(USE_OPENMP)
+#pragma omp parallel
+#endif
+                {
+                    uint64_t b, e;
+                    omp_static_range(r.second - r.first, b, e);
+                    for (uint64_t i = b; i < e; ++i) p[i] = (float)(r.first + i + 1);
+                }
+            }
+            off += r.second - r.first;
+        }
+        shuffle_fisher_yates(localA.data(), localN, 0x1234ULL);
+        sort_with_engine<LogSqrtTransform>(SORT_ENGINE, localA.data(), (int64_t)localN);    //TODO：排序引擎由 cpu_sort.h 中的 SORT_ENGINE 决定
+        QueryPerformanceCounter(&ed);
+        mine_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+        src.emplace_back(new ArraySource(localA.data(), localN));
+    }
+    g_last_stats.local_ms += mine_ms;
+    cost_model().observe_compute(0, Op::SORT, localN, mine_ms);
+
+    // k 路归并：本地 + 各 worker 的有序流；主连接或映射失败的流立即结束，随后按失败处理//
+    QueryPerformanceCounter(&st);
+    for (auto& ws : streams) src.push_back(ws->source());
+    TransformSink sink(result, totalN);
+    const uint64_t written = ext_merge(src, sink);
+    QueryPerformanceCounter(&ed);
+    g_last_stats.merge_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+
+    bool ok = (written == totalN);
+    for (auto& ws : streams) {
+        const bool rok = ws->finish();
+        if (ws->worker_ms() > g_last_stats.worker_ms) g_last_stats.worker_ms = ws->worker_ms();
+        if (rok) cost_model().observe_compute(ws->worker() + 1, Op::SORT, ws->cap(), ws->worker_ms());
+        if (!rok) {
+            reset_worker_sock(ws->worker());
+            ok = false;
+        }
+    }
+    src.clear();
+    if (!ok) return sortLocalAll(data, totalN, result);
+    return 0.0f;
+}
+
+// 接收 worker 对一块 SORT 请求的应答（count 个有序的原始值）到 dst：结果在共享内存中时边等 worker 发布边拷出，//
+// 否则按 WorkerSortHeader + 分帧格式接收（与 WorkerSortStream 相同）//
+static bool recv_sort_reply(SOCKET c, size_t w, uint64_t count, float* dst, double& compute_ms) {
+    ShmRegion shm;
+    bool ok = true;
+    if (recv_shm_notice(c, count, shm, ok, w)) {
+        if (!ok) return false;
+        ShmSource src(shm, c);
+        uint64_t got = 0;
+        size_t n = 0;
+        while (const float* p = src.next_block(n)) {
+            if (got + n > count) return false;
+            std::memcpy(dst + got, p, n * sizeof(float));
+            got += n;
+        }
+        compute_ms = shm.compute_ms();
+        return shm.ok() && got == count;
+    }
+    if (!ok) return false;
+    WorkerSortHeader wh{};
+    if (!recv_all(c, &wh, sizeof(wh)) || wh.bytes != count * sizeof(float)) return false;
+    compute_ms = wh.compute_ms;
+    std::vector<uint8_t> scratch;
+    uint64_t got = 0;
+    for (;;) {
+        SortChunkHeader ch{};
+        if (!recv_all(c, &ch, sizeof(ch)) || ch.count > SORT_CHUNK || got + ch.count > count) return false;
+        if (ch.count == 0) return got == count;
+        if (!recv_sort_frame(c, ch.count, dst + got, scratch, w)) return false;
+        got += ch.count;
+    }
+}
+
+// 拉取式 sort（见 sched_scalar）：各节点按块领取，每块排成一条有序顺串。自己领取的块直接写进 staging 中该块的位置，//
+// 窃取来的块写到自己的缓冲区，完成时才交给共享状态，先完成者的顺串生效；全部完成后 k 路归并各块顺串并变换写入 result//
+static float sortSpeedUpPull(const float data[], const uint64_t totalN, float result[]) {
+    struct Shared {
+        ChunkPool pool;
+        FirstTouchVec staging;
+        std::vector<std::unique_ptr<float[]>> spare;    // 窃取者生效的顺串//
+        std::vector<const float*> run;                  // 各块生效的顺串//
+        std::vector<double> busy_ms;
+        Shared(uint64_t n, size_t nodes) : pool(n, SCHED_CHUNK, nodes), staging((size_t)n), spare(pool.size()),
+            run(pool.size(), nullptr), busy_ms(nodes, 0.0) {}
+    };
+    const size_t W = workers_ref().size();
+    std::shared_ptr<Shared> sh = std::make_shared<Shared>(totalN, W + 1);
+    for (size_t w = 0; w < W; ++w) {
+        const SOCKET c = sched_sock(w);
+        if (c == INVALID_SOCKET) continue;
+        workers_ref()[w].proxy.start([sh, c, w]() {
+            size_t i;
+            bool stolen;
+            while (sh->pool.acquire(w + 1, i, stolen)) {
+                const uint64_t b = sh->pool.begin(i), e = sh->pool.end(i);
+                std::unique_ptr<float[]> own(stolen ? new float[(size_t)(e - b)] : nullptr);
+                float* dst = stolen ? own.get() : sh->staging.data() + b;
+                MsgHeader h{ MAGIC, (uint32_t)Op::SORT, e - b, b, e };
+                double ms = 0.0;
+                if (!send_all(c, &h, sizeof(h)) || !recv_sort_reply(c, w, e - b, dst, ms)) {
+                    sh->pool.release(i, w + 1);
+                    return false;
+                }
+                sh->pool.complete(i, w + 1, [&]() {
+                    sh->spare[i] = std::move(own);
+                    sh->run[i] = dst;
+                    sh->busy_ms[w + 1] += ms;
+                });
+            }
+            return true;
+        });
+    }
+
+    // master 本地的块：生成（或拷贝）、打乱、排序，与 sortSpeedUpCluster 的本地段相同//
+    size_t i;
+    bool stolen;
+    LARGE_INTEGER st, ed;
+    while (sh->pool.acquire(0, i, stolen)) {
+        const uint64_t b = sh->pool.begin(i), e = sh->pool.end(i);
+        QueryPerformanceCounter(&st);
+        std::unique_ptr<float[]> own(stolen ? new float[(size_t)(e - b)] : nullptr);
+        float* dst = stolen ? own.get() : sh->staging.data() + b;
+        if (data) std::copy(data + b, data + e, dst);
+        else {
+#if defined(USE_OPENMP)
+#pragma omp parallel
+#endif
+            {
+                uint64_t lb, le;
+                omp_static_range(e - b, lb, le);
+                for (uint64_t k = lb; k < le; ++k) dst[k] = (float)(b + k + 1);
+            }
+        }
+        shuffle_fisher_yates(dst, e - b, 0x1234ULL ^ b);
+        sort_with_engine<LogSqrtTransform>(SORT_ENGINE, dst, (int64_t)(e - b));    //TODO：排序引擎由 cpu_sort.h 中的 SORT_ENGINE 决定
+        QueryPerformanceCounter(&ed);
+        const double ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
+        sh->pool.complete(i, 0, [&]() {
+            sh->spare[i] = std::move(own);
+            sh->run[i] = dst;
+            sh->busy_ms[0] += ms;
+        });
+    }
+    g_last_stats.local_ms += sh->busy_ms[0];
+    for (size_t w = 1; w <= W; ++w) {
+        if (sh->busy_ms[w] > g_last_stats.worker_ms) g_last_stats.worker_ms = sh->busy_ms[w];
+    }
+
+    // k 路归并全部块的顺串//
+    QueryPerformanceCounter(&st);
+    std::vector<std::unique_ptr<SortedSource>> src;
+    for (size_t k = 0; k < sh->pool.size(); ++k) {
+        src.emplace_back(new ArraySource(sh->run[k], sh->pool.end(k) - sh->pool.begin(k)));
+    }
+    TransformSink sink(result, totalN);
+    const uint64_t written = ext_merge(src, sink);
+    QueryPerformanceCounter(&ed);
+    g_last_stats.merge_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+    if (written != totalN) return sortLocalAll(data, totalN, result);
+    return 0.0f;
+}
+
+float sortSpeedUp(const float data[], const int len, float result[]) {
+    ensure_wsa_inited();
+    g_last_stats = SpeedStats{};
+    if (len <= 0 || !result) return 0.0f;
+    // 拉取式调度要把全部顺串放在内存里，超出内存预算时仍走静态切分（外部排序）//
+    if (g_sched == SchedMode::PULL && (data || !ext_sort_wanted((uint64_t)len))) return sortSpeedUpPull(data, (uint64_t)len, result);
+    if (workers_ref().size() > 1) return sortSpeedUpCluster(data, (uint64_t)len, result);
+    if (SORT_MODE == SortMode::SPLITTER && !data) return sortSpeedUpSplit((uint64_t)len, result);
+
+    const uint64_t totalN = (uint64_t)len;
+    const uint64_t mid = adaptive_mid(Op::SORT, totalN); // TODO: 按实测吞吐自适应（见 load_balance.h），可切换为 totalN / 2 或 split_mid_30_70(totalN)
+    //const uint64_t mid = totalN / 2;//
+    //const uint64_t mid = split_mid_30_70(totalN);
+
+    //错误处理
+    SOCKET c = get_worker_sock();
+    if (c == INVALID_SOCKET) {
+        // Worker 不可用时，全量单机排序//
+        return sortLocalAll(data, totalN, result);
+    }
+    
+    
+    // 先下发任务再准备本地数据，Worker 的生成/排序与 master 的准备同时进行//
+    MsgHeader h{ MAGIC, (uint32_t)Op::SORT, (uint64_t)(totalN - mid), mid, totalN };
+    if (!send_all(c, &h, sizeof(h))) {
+        // 重连 Worker 重试一次；仍失败时全量单机排序，对端接受连接后立即断开时不会无限重试//
+        reset_worker_sock();
+        c = get_worker_sock();
+        if (c == INVALID_SOCKET || !send_all(c, &h, sizeof(h))) {
+            reset_worker_sock();
+            return sortLocalAll(data, totalN, result);
+        }
+    }
+
+    // 接收线程收 Worker 的结果（见 WorkerSortStream），master 同时生成并排序自己的一半，之后边收边归并//
+    WorkerSortStream ws(0, totalN - mid);
+    ws.start();
+
+    // 超出内存预算时不生成 localA：本地顺串落盘，之后与 Worker 的数据流一起做 k 路归并（见 ext_sort.h）//
+    LARGE_INTEGER st, ed;
+    double mine_ms = 0.0;   // 本地段的生成与排序耗时，与 worker 的 compute_ms 口径一致//
+    ExtRunSet runs("master");
+    std::vector<std::unique_ptr<SortedSource>> src;
+    bool ext = !(data && (uint64_t)len >= mid) && ext_sort_wanted(mid);
+    if (ext) {
+        QueryPerformanceCounter(&st);
+        ext = runs.build(default_generator(), 0, mid, 0x1234ULL) && runs.open(src);
+        QueryPerformanceCounter(&ed);
+        mine_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+        if (!ext) src.clear();     // 磁盘不可用时退回内存排序//
+    }
+
+    // 尽可能直接复用用户数据//
+    FirstTouchVec localA;
+    if (!ext && data && (uint64_t)len >= mid) {
+        QueryPerformanceCounter(&st);
+        localA.assign(data, data + mid);
+        QueryPerformanceCounter(&ed);
+        mine_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+    }
+    else if (!ext) {
+        QueryPerformanceCounter(&st);
+        init_local(localA, 0, mid);
+        QueryPerformanceCounter(&ed);
+        mine_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+    }
+
+    // 本地乱序一次后按 key 排序，避免与 Worker 排序完全一致//
+    // 单调变换下推：按原始值排序，log 留到归并输出时每个元素只算一次//
+    if (!ext) {
+        QueryPerformanceCounter(&st);
+        shuffle_fisher_yates(localA.data(), (uint64_t)localA.size(), 0x1234ULL);
+        //sort_by_transform<LogSqrtTransform>(localA.data(), (int64_t)localA.size());//
+        sort_with_engine<LogSqrtTransform>(SORT_ENGINE, localA.data(), (int64_t)localA.size());    //TODO：排序引擎由 cpu_sort.h 中的 SORT_ENGINE 决定
+        QueryPerformanceCounter(&ed);
+        mine_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
+    }
+
+    g_last_stats.local_ms += mine_ms;
+    cost_model().observe_compute(0, Op::SORT, mid, mine_ms);
 
-    // 归并后直接向 result 写入 log(sqrt(.)) 结果//
+    // 边收边归并，直接向 result 写入 log(sqrt(.)) 结果；merge_ms 只包含未被网络接收掩盖的部分//
     QueryPerformanceCounter(&st);
-    merge_to_transformed(
-        localA.data(), (int64_t)localA.size(),
-        sortedB.data(), (int64_t)sortedB.size(),
-        result
-    );
+    //merge_to_transformed(localA.data(), (int64_t)localA.size(), sortedB.data(), (int64_t)sortedB.size(), result);//
+    //merge_to_transformed_omp(localA.data(), (int64_t)localA.size(), sortedB.data(), (int64_t)sortedB.size(), result);// 需先收齐 sortedB
+    const uint64_t cap = totalN - mid;
+    uint64_t written = 0;
+    const bool from_shm = ws.in_shm();
+    ShmRegion& shm = ws.shm;
+    SpscRing<float, SORT_RING_SLOTS>& ring = ws.ring;
+    // 主连接或映射失败时环形缓冲已关闭，下面的归并立即结束，随后按失败处理//
+    if (ext) {
+        // 本地顺串 + Worker 数据流的 k 路归并//
+        src.push_back(ws.source());
+        TransformSink sink(result, totalN);
+        written = ext_merge(src, sink);
+    }
+    else if (from_shm && shm.finished()) {
+        // worker 已全部排好：两段都在内存中，直接用合并路径并行归并//
+        if (shm.ok()) {
+            merge_to_transformed_omp(localA.data(), (int64_t)localA.size(), shm.data(), (int64_t)cap, result);
+            written = totalN;
+        }
+    }
+    else if (from_shm) {
+        ShmSource b(shm, c);
+        written = (uint64_t)merge_stream_to_transformed(
+            localA.data(), (int64_t)localA.size(),
+            [&](size_t& cnt) { return b.next_block(cnt); },
+            []() {},
+            result
+        );
+    }
+    else {
+        uint64_t seen = 0;
+        written = (uint64_t)merge_stream_to_transformed(
+            localA.data(), (int64_t)localA.size(),
+            [&](size_t& cnt) -> const float* {
+                const float* p = ring.consumer_acquire(cnt);
+                // 防御：worker 发来的总量超过预期时停止消费，不越界写 result//
+                if (p && seen + cnt > cap) {
+                    ring.abandon();
+                    return nullptr;
+                }
+                seen += cnt;
+                return p;
+            },
+            [&]() { ring.consumer_release(); },
+            result
+        );
+    }
     QueryPerformanceCounter(&ed);
     g_last_stats.merge_ms += (ed.QuadPart - st.QuadPart) * freqInvMs();
 
+    const bool recv_ok = ws.finish();
+    g_last_stats.worker_ms = ws.worker_ms();
+    // 结果流受归并速度牵制，收完的时刻不代表网络耗时，这里只记录计算耗时//
+    if (recv_ok) cost_model().observe_compute(1, Op::SORT, totalN - mid, ws.worker_ms());
+    if (!recv_ok || written != totalN) {
+        reset_worker_sock();
+        return sortLocalAll(data, totalN, result);
+    }
+
     return 0.0f;
 }
 
@@ -394,16 +1535,90 @@ static double freqInvMs() {
     return v;
 }
 
+// SUM 引擎精度报告：以双精度累加的基线 sum() 为参照，打印各引擎的误差与耗时//
+static void report_sum_engines(const FirstTouchVec& raw) {
+    const int N = (int)raw.size();
+    const double ref = (double)sum(raw.data(), N);
+    const SumEngine engines[] = { SumEngine::SSE, SumEngine::SSE_OMP, SumEngine::PROD_OMP, SumEngine::DET_OMP };
+    std::cout << "[ACC][SUM ] baseline=" << std::setprecision(12) << ref << "\n";
+    for (SumEngine e : engines) {
+        LARGE_INTEGER st, ed;
+        QueryPerformanceCounter(&st);
+        float v = cpu_sum_log_sqrt_engine(e, raw.data(), (uint64_t)N);
+        QueryPerformanceCounter(&ed);
+        double abs_err = (double)v - ref;
+        std::cout << "[ACC][SUM ][" << sum_engine_name(e) << "] value=" << (double)v
+            << " abs_err=" << abs_err
+            << " rel_err=" << (ref != 0.0 ? std::fabs(abs_err / ref) : 0.0)
+            << " time=" << (ed.QuadPart - st.QuadPart) * freqInvMs() << " ms"
+            << (e == SUM_ENGINE ? "  <- SUM_ENGINE" : "") << "\n";
+    }
+    std::cout << std::setprecision(6) << "\n";
+}
+
 // 主流程：单机基线、双机性能和结果校验//
-int main() {
+// 命令行：--workers ip[:port],... 或 --workers-file 文件，指定多个 worker（见 cluster.h）；不给时为 WORKER_IP 单个 worker；//
+// --tree K 让 worker 排成 K 叉树做树形汇聚；--sched pull 改为拉取式分块调度（见 chunk_sched.h）//
+static bool parse_args(int argc, char** argv) {
+    std::vector<WorkerAddr> addrs;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const bool list = (a == "--workers" || a == "-w");
+        const bool file = (a == "--workers-file" || a == "-f");
+        const bool tree = (a == "--tree" || a == "-t");
+        const bool sched = (a == "--sched" || a == "-s");
+        if ((!list && !file && !tree && !sched) || i + 1 >= argc) {
+            std::cerr << "usage: Master [--workers ip[:port],...] [--workers-file path] [--tree arity] [--sched static|pull]\n";
+            return false;
+        }
+        const std::string v = argv[++i];
+        if (sched) {
+            if (v != "static" && v != "pull") {
+                std::cerr << "[Master] bad sched mode: " << v << "\n";
+                return false;
+            }
+            g_sched = (v == "pull") ? SchedMode::PULL : SchedMode::STATIC;
+            continue;
+        }
+        if (tree) {
+            char* end = nullptr;
+            const unsigned long k = std::strtoul(v.c_str(), &end, 10);
+            if (v.empty() || *end || k > TREE_MAX_NODES) {
+                std::cerr << "[Master] bad tree arity: " << v << "\n";
+                return false;
+            }
+            g_tree_arity = (size_t)k;
+            continue;
+        }
+        if (list ? !parse_worker_list(v, PORT, addrs) : !load_worker_file(v, PORT, addrs)) {
+            std::cerr << "[Master] bad worker list: " << v << "\n";
+            return false;
+        }
+    }
+    if (!addrs.empty()) {
+        std::vector<WorkerConn>& ws = workers_ref();
+        ws.clear();
+        for (const WorkerAddr& x : addrs) ws.push_back(WorkerConn{ x });
+    }
+    std::cout << "[Master] workers: " << workers_ref().size();
+    if (g_sched == SchedMode::PULL) std::cout << " (pull, chunk " << SCHED_CHUNK << ")";
+    else if (g_tree_arity && workers_ref().size() > 1) std::cout << " (tree arity " << g_tree_arity << ")";
+    std::cout << "\n";
+    return true;
+}
+
+int main(int argc, char** argv) {
 
     try {
 
+        if (!parse_args(argc, argv)) return 1;
         
         // 单机测试（5 次取平均值）//
         const int N = (int)DATANUM;
-        std::vector<float> raw;
+        numa_init();
+        FirstTouchVec raw;
         init_local(raw, 0, (uint64_t)N);  //
+        numa_report("master raw", raw.data(), (uint64_t)raw.size());
 
         auto run5_avg_ms = [&](auto&& fn) {
             double total = 0;
@@ -451,6 +1666,8 @@ int main() {
             (void)result;
             });
 
+        report_sum_engines(raw);
+
         shuffle_fisher_yates(raw.data(), (uint64_t)raw.size(), 0x20251216ULL); // 增加洗牌次数
         double t_sort_base = run5_avg_ms([&] { (void)sort(raw.data(), N, out.data()); });
 
@@ -571,6 +1788,13 @@ int main() {
             max_ans = maxSpeedUp(nullptr, N);
             }, max_stats);
 
+        // 多统计量（不计入作业要求的 TOTAL）//
+        StatsResult stats_ans = stats_identity();
+        SpeedStats stats_stats;
+        double t_stats_dual_avg = run5_avg_ms_stats([&] {
+            stats_ans = statsSpeedUp(nullptr, N);
+            }, stats_stats);
+
         t_sort_dual_avg = run5_avg_ms_stats([&] {
             sortSpeedUp(nullptr, N, out_dual.data());
             // 访问一次结果，确保 out_dual 在 Release 下不会被认为未使用//
@@ -581,7 +1805,8 @@ int main() {
         // 计时结果输出（均值）//
         double sum_compute_no_net = (sum_stats.local_ms > sum_stats.worker_ms ? sum_stats.local_ms : sum_stats.worker_ms);
         double max_compute_no_net = (max_stats.local_ms > max_stats.worker_ms ? max_stats.local_ms : max_stats.worker_ms);
-        double sort_compute_no_net = sort_stats.local_ms + sort_stats.worker_ms + sort_stats.merge_ms;
+        // SORT 的本地排序与 Worker 排序/回传重叠进行，不含网络的耗时取两者较大值再加归并//
+        double sort_compute_no_net = (sort_stats.local_ms > sort_stats.worker_ms ? sort_stats.local_ms : sort_stats.worker_ms) + sort_stats.merge_ms;
         double total_no_net = sum_compute_no_net + max_compute_no_net + sort_compute_no_net;
 
         double sum_comm = t_sum_dual_avg - sum_compute_no_net;
@@ -597,6 +1822,14 @@ int main() {
         std::cout << "[DUAL][RUN5_AVG][MAX ] result=" << max_ans
             << " avg=" << t_max_dual_avg << " ms"
             << "\n (no_net=" << max_compute_no_net << " ms, comm=" << max_comm << " ms)\n";
+        std::cout << "[DUAL][RUN5_AVG][STAT] min=" << stats_ans.min
+            << " max=" << stats_ans.max
+            << " argmax=" << stats_ans.argmax
+            << " sum=" << stats_ans.sum
+            << " mean=" << stats_mean(stats_ans)
+            << " var=" << stats_variance(stats_ans)
+            << " avg=" << t_stats_dual_avg << " ms"
+            << "\n (local=" << stats_stats.local_ms << " ms, worker=" << stats_stats.worker_ms << " ms)\n";
         std::cout << "[DUAL][RUN5_AVG][SORT] done   avg=" << t_sort_dual_avg
             << " ms"
             << "\n (no_net=" << sort_compute_no_net << " ms, comm=" << sort_comm << " ms)\n";
@@ -626,7 +1859,7 @@ int main() {
 
 
         // 结束时断开 socket，配合 worker.cpp//
-        reset_worker_sock();
+        for (size_t w = 0; w < workers_ref().size(); ++w) reset_worker_sock(w);
 
         return 0;
     }
@@ -640,6 +1873,8 @@ int main() {
     }
 
     std::cout << "\n ";
+#if defined(_WIN32)
     system("pause");
+#endif
 
 }
@@ -2,24 +2,62 @@
 /**
  * @file net.cpp
  * @brief 网络通信库实现
- * * 实现了 net.h 中声明的网络接口。
+ * * 实现了 net.h 中声明的网络接口，分 Windows（Winsock2）与 Linux（BSD socket）两个后端，
+ * 上层只看到同一组 tcp_* / send_* / recv_all 函数。
  * 负责处理 WSAStartup/WSACleanup 的生命周期管理，
  * 并封装了底层的 socket、bind、listen、connect、send、recv 等系统调用，
  * 为上层业务逻辑提供简单的阻塞式 TCP 数据传输服务。
+ * 连接建立后统一调优：TCP_NODELAY（控制消息很小，不能被 Nagle 与延迟确认拖住）与 NET_SOCK_BUF 大小的收发缓冲区。
+ * Linux 后端的大块发送使用 sendmsg 聚合多段数据，并在支持时用 MSG_ZEROCOPY 免去用户态到内核的拷贝。
  */
-#pragma comment(lib, "Ws2_32.lib")
-
 #include "net.h"
 #include <stdexcept>
+#include <sstream>
+
+#if defined(_WIN32)
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <atomic>
+#include <linux/errqueue.h>
+#endif
+#endif
+
+// 单次系统调用最多携带的分段数（不超过 Linux 的 IOV_MAX = 1024）与每段字节数（WSABUF 长度为 32 位）
+#define NET_IOV_BATCH 64
+#define NET_IOV_MAX_BYTES (1u << 30)
 
 // 初始化/清理 WinSock2
 // 通过 RAII 管理 WSAStartup/WSACleanup 的生命周期，避免忘记清理。
+#if defined(_WIN32)
 WsaInit::WsaInit() {
     // 要求使用 WinSock 2.2
     WSADATA wsa{};
     if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) throw std::runtime_error("WSAStartup failed");
 }
 WsaInit::~WsaInit() { WSACleanup(); }
+#else
+// Linux 不需要初始化；对端关闭后继续写入会产生 SIGPIPE，这里改为让 send 返回错误
+WsaInit::WsaInit() { signal(SIGPIPE, SIG_IGN); }
+WsaInit::~WsaInit() {}
+#endif
+
+static int last_net_error() {
+#if defined(_WIN32)
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
 
 // 创建基础 TCP 套接字
 // 失败时抛异常，调用方无需检查 INVALID_SOCKET。
@@ -30,17 +68,32 @@ static SOCKET mk_socket() {
     return s;
 }
 
-// net.cpp
-#include <sstream>
-
-// 将 WSAGetLastError() 包装进异常消息，便于定位 WinSock 错误原因
+// 将 WSAGetLastError()（Linux 为 errno）包装进异常消息，便于定位错误原因
 static void throw_wsa(const char* msg) {
-    int e = WSAGetLastError();
+    int e = last_net_error();
     std::ostringstream oss;
+#if defined(_WIN32)
     oss << msg << " (WSA=" << e << ")";
+#else
+    oss << msg << " (errno=" << e << ")";
+#endif
     throw std::runtime_error(oss.str());
 }
 
+// 收发缓冲区需在 listen/connect 之前设置，窗口扩大因子在握手时协商
+static void set_sock_bufs(SOCKET s) {
+    int buf = NET_SOCK_BUF;
+    setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*)&buf, sizeof(buf));
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&buf, sizeof(buf));
+}
+
+// 已连接套接字：关闭 Nagle，控制消息（头部、标量结果、样本、分割点）立即发出
+static void tune_connected(SOCKET s) {
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+    set_sock_bufs(s);
+}
+
 
 // 启动监听（返回监听套接字）
 SOCKET tcp_listen(uint16_t port) {
@@ -54,10 +107,13 @@ SOCKET tcp_listen(uint16_t port) {
     // 允许地址复用：服务端重启时避免 TIME_WAIT 导致 bind 失败
     int opt = 1;
     setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
+    // accept 得到的套接字继承监听套接字的缓冲区设置
+    set_sock_bufs(s);
 
     // 绑定并进入监听状态，失败则抛出带 WSA 错误码的异常
     if (bind(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) throw_wsa("bind failed");
-    if (listen(s, 1) == SOCKET_ERROR) throw_wsa("listen failed");
+    // HELLO 之后 master 会连续建立多条数据连接（见 stripe.h），等待队列要留足
+    if (listen(s, NET_LISTEN_BACKLOG) == SOCKET_ERROR) throw_wsa("listen failed");
     return s;
 }
 
@@ -66,6 +122,7 @@ SOCKET tcp_accept(SOCKET listenSock) {
     // 阻塞等待客户端连接；忽略对端地址信息
     SOCKET c = accept(listenSock, nullptr, nullptr);
     if (c == INVALID_SOCKET) throw std::runtime_error("accept failed");
+    tune_connected(c);
     return c;
 }
 
@@ -79,39 +136,227 @@ SOCKET tcp_connect(const char* ip, uint16_t port) {
     // 将点分十进制 IP 转换为网络地址结构
     if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1) throw std::runtime_error("inet_pton failed");
 
+    set_sock_bufs(s);
     // connect 失败时带上 WSA 错误码
     if (connect(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) throw_wsa("connect failed");
+    tune_connected(s);
     return s;
 }
 
-// 发送指定长度的数据，直到发完
-bool send_all(SOCKET s, const void* data, size_t bytes) {
-    // 循环发送直到字节数耗尽，确保完整发出
-    const char* p = (const char*)data;
-    while (bytes) {
-        // send 可能出现部分发送，因此需要累计推进指针
-        int n = send(s, p, (int)bytes, 0);
-        if (n <= 0) return false;
-        p += n; bytes -= (size_t)n;
+// ---- 聚合发送 ----
+// 发送一批分段（k <= NET_IOV_BATCH，每段 <= NET_IOV_MAX_BYTES），返回实际发出的字节数，失败返回 -1
+#if defined(_WIN32)
+static int64_t sys_sendv(SOCKET s, const NetBuf* p, int k, int /*flags*/) {
+    WSABUF wb[NET_IOV_BATCH];
+    for (int i = 0; i < k; ++i) {
+        wb[i].buf = (CHAR*)p[i].data;
+        wb[i].len = (ULONG)p[i].bytes;
+    }
+    DWORD sent = 0;
+    if (WSASend(s, wb, (DWORD)k, &sent, 0, nullptr, nullptr) == SOCKET_ERROR) return -1;
+    return (int64_t)sent;
+}
+#else
+static int64_t sys_sendv(SOCKET s, const NetBuf* p, int k, int flags) {
+    iovec iov[NET_IOV_BATCH];
+    for (int i = 0; i < k; ++i) {
+        iov[i].iov_base = (void*)p[i].data;
+        iov[i].iov_len = p[i].bytes;
+    }
+    msghdr m{};
+    m.msg_iov = iov;
+    m.msg_iovlen = (size_t)k;
+    for (;;) {
+        ssize_t n = sendmsg(s, &m, flags | MSG_NOSIGNAL);
+        if (n >= 0) return (int64_t)n;
+        if (errno != EINTR) return -1;
+    }
+}
+#endif
+
+// 把 bufs 中从 (i, skip) 开始的数据切成一批分段：跳过空段，超长段按 NET_IOV_MAX_BYTES 截断
+static int fill_batch(const NetBuf* bufs, size_t count, size_t i, size_t skip, NetBuf* out) {
+    int k = 0;
+    for (; i < count && k < NET_IOV_BATCH; ++i, skip = 0) {
+        size_t left = bufs[i].bytes - skip;
+        if (left == 0) continue;
+        out[k].data = (const char*)bufs[i].data + skip;
+        out[k].bytes = (left < NET_IOV_MAX_BYTES ? left : NET_IOV_MAX_BYTES);
+        ++k;
+        if (out[k - 1].bytes < left) break;     // 本段没放完，下一批从这里继续
+    }
+    return k;
+}
+
+// 发出 n 字节后推进 (i, skip)
+static void advance(const NetBuf* bufs, size_t count, size_t& i, size_t& skip, uint64_t n) {
+    while (i < count) {
+        const size_t left = bufs[i].bytes - skip;
+        if (n < left) {
+            skip += (size_t)n;
+            return;
+        }
+        n -= left;
+        ++i;
+        skip = 0;
+    }
+}
+
+// 零拷贝发送的进度：每次成功的 MSG_ZEROCOPY 调用对应一个完成序号
+struct ZcState {
+    uint32_t calls = 0;     // 已提交
+    uint32_t done = 0;      // 已完成
+    bool copied = false;    // 内核报告退化为拷贝（回环、网卡不支持分散/聚集等）
+};
+
+#if defined(__linux__) && defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define NET_HAVE_ZEROCOPY 1
+
+// 内核退化为拷贝后，之后的发送不再尝试零拷贝（页锁定与完成通知只剩额外开销）
+static std::atomic<bool> g_zc_disabled{ false };
+
+// 从错误队列读取完成通知，直到 done == calls
+static bool zc_reap(SOCKET s, ZcState& z) {
+    while (z.done != z.calls) {
+        pollfd p{ s, 0, 0 };        // 错误队列非空时 poll 总会报告 POLLERR
+        if (poll(&p, 1, 1000) < 0 && errno != EINTR) return false;
+        char ctrl[128];
+        msghdr m{};
+        m.msg_control = ctrl;
+        m.msg_controllen = sizeof(ctrl);
+        if (recvmsg(s, &m, MSG_ERRQUEUE) < 0) {
+            if (errno != EAGAIN && errno != EINTR) return false;
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (getsockopt(s, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err != 0) return false;
+            continue;
+        }
+        for (cmsghdr* c = CMSG_FIRSTHDR(&m); c; c = CMSG_NXTHDR(&m, c)) {
+            if (!((c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR)
+                || (c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR))) continue;
+            const sock_extended_err* e = (const sock_extended_err*)CMSG_DATA(c);
+            if (e->ee_origin != SO_EE_ORIGIN_ZEROCOPY || e->ee_errno != 0) continue;
+            z.done += e->ee_data - e->ee_info + 1;      // 完成序号区间 [ee_info, ee_data]
+            if (e->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) z.copied = true;
+        }
     }
     return true;
 }
+#endif
+
+// 循环发送直到全部分段发完；zc 非空时使用 MSG_ZEROCOPY
+static bool send_gather(SOCKET s, const NetBuf* bufs, size_t count, ZcState* zc) {
+    NetBuf batch[NET_IOV_BATCH];
+    size_t i = 0, skip = 0;
+    for (;;) {
+        const int k = fill_batch(bufs, count, i, skip, batch);
+        if (k == 0) return true;
+#if defined(NET_HAVE_ZEROCOPY)
+        int64_t n = sys_sendv(s, batch, k, zc ? MSG_ZEROCOPY : 0);
+        if (n < 0 && zc && errno == ENOBUFS) {
+            // 锁定页超过 optmem 限制：先等已提交的完成；没有可等的就改为普通发送
+            if (zc->done != zc->calls) {
+                if (!zc_reap(s, *zc)) return false;
+            }
+            else {
+                zc = nullptr;
+            }
+            continue;
+        }
+        if (n > 0 && zc) ++zc->calls;
+#else
+        (void)zc;
+        int64_t n = sys_sendv(s, batch, k, 0);
+#endif
+        if (n <= 0) return false;
+        advance(bufs, count, i, skip, (uint64_t)n);
+    }
+}
+
+// 聚合发送：多段数据依次发出
+bool send_iov(SOCKET s, const NetBuf* bufs, size_t count) {
+    return send_gather(s, bufs, count, nullptr);
+}
+
+// 大块发送：满足条件时走零拷贝，返回前等待全部完成通知
+bool send_bulk(SOCKET s, const NetBuf* bufs, size_t count) {
+#if defined(NET_HAVE_ZEROCOPY)
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; ++i) total += bufs[i].bytes;
+    int one = 1;
+    if (USE_ZEROCOPY && total >= NET_ZEROCOPY_MIN && !g_zc_disabled.load(std::memory_order_relaxed)
+        && setsockopt(s, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+        ZcState z;
+        const bool ok = send_gather(s, bufs, count, &z);
+        // 发送失败时也要等已提交部分的通知，之后调用方才能释放缓冲区
+        const bool reaped = zc_reap(s, z);
+        if (z.copied) g_zc_disabled.store(true, std::memory_order_relaxed);
+        return ok && reaped;
+    }
+#endif
+    return send_iov(s, bufs, count);
+}
+
+// 发送指定长度的数据，直到发完
+bool send_all(SOCKET s, const void* data, size_t bytes) {
+    // 部分发送的累计推进由 send_iov 处理，确保完整发出
+    NetBuf b{ data, bytes };
+    return send_iov(s, &b, 1);
+}
 
 // 接收指定长度的数据，直到收满
 bool recv_all(SOCKET s, void* data, size_t bytes) {
     // 循环接收直到拿满指定字节，确保数据完整
     char* p = (char*)data;
     while (bytes) {
-        // recv 可能出现部分接收，需循环直到满足长度
-        int n = recv(s, p, (int)bytes, 0);
+        // recv 可能出现部分接收，需循环直到满足长度；MSG_WAITALL 让内核尽量一次收满，减少系统调用
+        const size_t want = (bytes < NET_IOV_MAX_BYTES ? bytes : NET_IOV_MAX_BYTES);
+#if defined(_WIN32)
+        int n = recv(s, p, (int)want, MSG_WAITALL);
+#else
+        ssize_t n = recv(s, p, want, MSG_WAITALL);
+        if (n < 0 && errno == EINTR) continue;
+#endif
         if (n <= 0) return false;
         p += n; bytes -= (size_t)n;
     }
     return true;
 }
 
+// 中断收发：对端与本进程其它线程中阻塞的调用都会返回
+void abort_sock(SOCKET s) {
+#if defined(_WIN32)
+    if (s != INVALID_SOCKET) shutdown(s, SD_BOTH);
+#else
+    if (s != INVALID_SOCKET) shutdown(s, SHUT_RDWR);
+#endif
+}
+
+// 可读即表示对端已关闭（recv 返回 0）或出错；有数据可读时按 MSG_PEEK 查看，不取走
+bool peer_closed(SOCKET s) {
+    char b;
+#if defined(_WIN32)
+    fd_set r;
+    FD_ZERO(&r);
+    FD_SET(s, &r);
+    timeval tv{ 0, 0 };
+    if (select(0, &r, nullptr, nullptr, &tv) <= 0) return false;
+    return recv(s, &b, 1, MSG_PEEK) <= 0;
+#else
+    pollfd p{ s, POLLIN, 0 };
+    if (poll(&p, 1, 0) <= 0) return false;
+    if (p.revents & (POLLERR | POLLHUP | POLLNVAL)) return true;
+    const ssize_t n = recv(s, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+#endif
+}
+
 // 安全关闭套接字
 void close_sock(SOCKET s) {
     // 忽略 INVALID_SOCKET，避免重复关闭
+#if defined(_WIN32)
     if (s != INVALID_SOCKET) closesocket(s);
+#else
+    if (s != INVALID_SOCKET) close(s);
+#endif
 }
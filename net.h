@@ -1,22 +1,47 @@
 /**
  * @file net.h
  * @brief 网络通信库头文件
- * * 声明了基于 Windows Socket (Winsock2) 的 TCP 网络通信接口。
+ * * 声明了 TCP 网络通信接口，Windows 下基于 Winsock2，Linux 下基于 BSD socket（见 net.cpp 的两个后端）。
  * 提供了 Socket 的初始化 (WsaInit)、监听、连接、以及确保数据完整性的
- * 发送 (send_all) 和接收 (recv_all) 函数封装。
+ * 发送 (send_all) 和接收 (recv_all) 函数封装；
+ * send_iov 把头部与正文合成一次系统调用发出，send_bulk 用于大块数据（Linux 上可走 MSG_ZEROCOPY）。
  */
 
 #pragma once
+#if defined(_WIN32)
 #define WIN32_LEAN_AND_MEAN
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+using SOCKET = int;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#endif
+#include <cstddef>
 #include <cstdint>
 
+// 连接建立后设置的收发缓冲区大小（字节）
+#define NET_SOCK_BUF (4 << 20)
+// 监听队列长度：主连接之后还会连续建立多条数据连接
+#define NET_LISTEN_BACKLOG 32
+// send_bulk 单次总量不小于该值时才尝试零拷贝（小块的页锁定与完成通知开销比拷贝更大）
+#define NET_ZEROCOPY_MIN (1 << 20)
+
+static constexpr bool USE_ZEROCOPY = true;     // TODO：Linux 大块发送是否使用 MSG_ZEROCOPY（内核 >= 4.14）
+
+// Windows 下初始化/清理 WinSock；Linux 下忽略 SIGPIPE（对端断开时 send 返回错误而不是终止进程）
 struct WsaInit {
     WsaInit();
     ~WsaInit();
 };
 
+// 一段待发送的数据（聚合发送用）
+struct NetBuf {
+    const void* data;
+    size_t bytes;
+};
+
 SOCKET tcp_listen(uint16_t port);
 SOCKET tcp_accept(SOCKET listenSock);
 SOCKET tcp_connect(const char* ip, uint16_t port);
@@ -24,4 +49,17 @@ SOCKET tcp_connect(const char* ip, uint16_t port);
 bool send_all(SOCKET s, const void* data, size_t bytes);
 bool recv_all(SOCKET s, void* data, size_t bytes);
 
+// 聚合发送：多段数据按顺序一次发出（Linux: sendmsg，Windows: WSASend），不需要先拷到一块连续内存
+bool send_iov(SOCKET s, const NetBuf* bufs, size_t count);
+
+// 大块发送：语义同 send_iov。Linux 上开启 USE_ZEROCOPY、总量 >= NET_ZEROCOPY_MIN 且内核支持时使用 MSG_ZEROCOPY，
+// 页面直接交给网卡而不拷贝进内核；返回前等待全部完成通知，因此返回后缓冲区即可修改或释放
+bool send_bulk(SOCKET s, const NetBuf* bufs, size_t count);
+
+// 中断套接字上的收发（shutdown），其它线程中阻塞的 send/recv 随即返回失败；之后仍需 close_sock
+void abort_sock(SOCKET s);
+
+// 对端是否已关闭连接或连接出错（不阻塞，不消费数据）；只用于本端不期待对端再发数据时的存活检查
+bool peer_closed(SOCKET s);
+
 void close_sock(SOCKET s);
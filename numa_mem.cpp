@@ -0,0 +1,403 @@
+﻿/**
+ * @file numa_mem.cpp
+ * @brief NUMA 拓扑检测、线程绑定与本地内存比例统计
+ * * Windows 用 GetNumaNodeProcessorMaskEx / SetThreadGroupAffinity / QueryWorkingSetEx，
+ * Linux 读 /sys/devices/system/node 并用 sched_setaffinity / move_pages。
+ * 绑定在一个 OpenMP 并行区内完成：OpenMP 运行时复用线程池，之后同样线程数的并行区中
+ * 第 t 号线程仍是同一个系统线程，因此绑定对后续所有内核生效。
+ * （MSVC 只支持 OpenMP 2.0，没有 OMP_PROC_BIND/OMP_PLACES，所以在这里手动绑定。）
+ * 0 号线程就是进程主线程，绑定后之后由它创建的 std::thread 在 Linux 上会继承单个 CPU 的掩码；
+ * 绑定前保存进程原来的亲和性，接收、发送、写盘等辅助线程启动时调用 numa_release_thread 恢复。
+ */
+#include "numa_mem.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+#if defined(USE_OPENMP)
+#include <omp.h>
+#endif
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "Psapi.lib")
+#else
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+struct CpuId {
+    uint16_t group;     // Windows 处理器组；Linux 恒为 0
+    uint16_t cpu;       // 组内编号（Linux 为全局 CPU 编号）
+};
+
+struct NumaState {
+    bool inited = false;
+    AffinityPolicy policy = AffinityPolicy::NONE;
+    std::vector<std::vector<CpuId>> node_cpus;  // 每个节点的 CPU 列表
+    std::vector<int> thread_node;               // OpenMP 线程号 -> 节点（-1：未知）
+};
+
+NumaState g_numa;
+
+const char* policy_name(AffinityPolicy p) {
+    switch (p) {
+    case AffinityPolicy::NONE: return "none";
+    case AffinityPolicy::CLOSE: return "close";
+    case AffinityPolicy::SPREAD: return "spread";
+    }
+    return "?";
+}
+
+// DPC_AFFINITY 环境变量覆盖编译期默认策略
+AffinityPolicy policy_from_env() {
+    const char* v = std::getenv("DPC_AFFINITY");
+    if (!v) return AFFINITY_POLICY;
+    if (std::strcmp(v, "none") == 0) return AffinityPolicy::NONE;
+    if (std::strcmp(v, "close") == 0) return AffinityPolicy::CLOSE;
+    if (std::strcmp(v, "spread") == 0) return AffinityPolicy::SPREAD;
+    return AFFINITY_POLICY;
+}
+
+int omp_threads() {
+#if defined(USE_OPENMP)
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// ---------- 平台相关：拓扑 / 绑定 / 当前 CPU / 页所在节点 ----------
+#if defined(_WIN32)
+
+void detect_nodes(std::vector<std::vector<CpuId>>& nodes) {
+    ULONG hi = 0;
+    if (!GetNumaHighestNodeNumber(&hi)) hi = 0;
+    for (ULONG nd = 0; nd <= hi; ++nd) {
+        GROUP_AFFINITY ga{};
+        std::vector<CpuId> cpus;
+        if (GetNumaNodeProcessorMaskEx((USHORT)nd, &ga)) {
+            for (uint16_t b = 0; b < 64; ++b) {
+                if (ga.Mask & ((KAFFINITY)1 << b)) cpus.push_back(CpuId{ ga.Group, b });
+            }
+        }
+        if (!cpus.empty()) nodes.push_back(cpus);
+    }
+}
+
+bool pin_current_thread(const CpuId& c) {
+    GROUP_AFFINITY ga{};
+    ga.Group = c.group;
+    ga.Mask = (KAFFINITY)1 << c.cpu;
+    return SetThreadGroupAffinity(GetCurrentThread(), &ga, nullptr) != 0;
+}
+
+// 线程的亲和性快照
+struct SavedAffinity {
+    GROUP_AFFINITY ga{};
+    bool ok = false;
+};
+
+SavedAffinity save_affinity() {
+    SavedAffinity s;
+    s.ok = GetThreadGroupAffinity(GetCurrentThread(), &s.ga) != 0;
+    return s;
+}
+
+void restore_affinity(const SavedAffinity& s) {
+    if (s.ok) SetThreadGroupAffinity(GetCurrentThread(), &s.ga, nullptr);
+}
+
+CpuId current_cpu() {
+    PROCESSOR_NUMBER pn{};
+    GetCurrentProcessorNumberEx(&pn);
+    return CpuId{ pn.Group, pn.Number };
+}
+
+// 查询 [pages, pages+cnt) 各页所在节点，未驻留的页记为 -1
+void query_page_nodes(void* const* pages, size_t cnt, int* node) {
+    std::vector<PSAPI_WORKING_SET_EX_INFORMATION> info(cnt);
+    for (size_t i = 0; i < cnt; ++i) info[i].VirtualAddress = pages[i];
+    if (!QueryWorkingSetEx(GetCurrentProcess(), info.data(), (DWORD)(cnt * sizeof(info[0])))) {
+        for (size_t i = 0; i < cnt; ++i) node[i] = -1;
+        return;
+    }
+    for (size_t i = 0; i < cnt; ++i) {
+        node[i] = info[i].VirtualAttributes.Valid ? (int)info[i].VirtualAttributes.Node : -1;
+    }
+}
+
+size_t page_size() {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (size_t)si.dwPageSize;
+}
+
+#else
+
+// 解析 "0-3,8-11" 形式的 CPU 列表
+std::vector<CpuId> parse_cpulist(const char* s) {
+    std::vector<CpuId> cpus;
+    while (*s) {
+        char* p = nullptr;
+        long a = std::strtol(s, &p, 10);
+        if (p == s) break;
+        long b = a;
+        if (*p == '-') b = std::strtol(p + 1, &p, 10);
+        for (long c = a; c <= b; ++c) cpus.push_back(CpuId{ 0, (uint16_t)c });
+        s = (*p == ',') ? p + 1 : p;
+        if (*s == '\n') break;
+    }
+    return cpus;
+}
+
+void detect_nodes(std::vector<std::vector<CpuId>>& nodes) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    for (int nd = 0; nd < 1024; ++nd) {
+        char path[96];
+        std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", nd);
+        FILE* f = std::fopen(path, "r");
+        if (!f) {
+            if (nd == 0) break;
+            continue;   // 节点编号可能不连续
+        }
+        char buf[4096] = {};
+        size_t got = std::fread(buf, 1, sizeof(buf) - 1, f);
+        std::fclose(f);
+        buf[got] = '\0';
+        std::vector<CpuId> cpus;
+        for (const CpuId& c : parse_cpulist(buf)) {
+            if (!have_mask || CPU_ISSET(c.cpu, &allowed)) cpus.push_back(c);
+        }
+        if (!cpus.empty()) nodes.push_back(cpus);
+    }
+    if (nodes.empty() && have_mask) {
+        // 没有 sysfs 信息时视为单节点
+        std::vector<CpuId> cpus;
+        for (int c = 0; c < CPU_SETSIZE; ++c) {
+            if (CPU_ISSET(c, &allowed)) cpus.push_back(CpuId{ 0, (uint16_t)c });
+        }
+        if (!cpus.empty()) nodes.push_back(cpus);
+    }
+}
+
+bool pin_current_thread(const CpuId& c) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(c.cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// 线程的亲和性快照
+struct SavedAffinity {
+    cpu_set_t set;
+    bool ok = false;
+};
+
+SavedAffinity save_affinity() {
+    SavedAffinity s;
+    CPU_ZERO(&s.set);
+    s.ok = sched_getaffinity(0, sizeof(s.set), &s.set) == 0;
+    return s;
+}
+
+void restore_affinity(const SavedAffinity& s) {
+    if (s.ok) sched_setaffinity(0, sizeof(s.set), &s.set);
+}
+
+CpuId current_cpu() {
+    int c = sched_getcpu();
+    return CpuId{ 0, (uint16_t)(c < 0 ? 0 : c) };
+}
+
+void query_page_nodes(void* const* pages, size_t cnt, int* node) {
+    std::vector<int> status(cnt, -1);
+    long rc = syscall(SYS_move_pages, 0, (unsigned long)cnt, const_cast<void**>(pages), nullptr, status.data(), 0);
+    for (size_t i = 0; i < cnt; ++i) node[i] = (rc == 0 && status[i] >= 0) ? status[i] : -1;
+}
+
+size_t page_size() {
+    long v = sysconf(_SC_PAGESIZE);
+    return v > 0 ? (size_t)v : 4096;
+}
+
+#endif
+
+SavedAffinity g_process_mask;   // 绑定前进程（主线程）的亲和性，辅助线程启动时恢复
+
+int node_of_cpu(const CpuId& c) {
+    for (size_t nd = 0; nd < g_numa.node_cpus.size(); ++nd) {
+        for (const CpuId& x : g_numa.node_cpus[nd]) {
+            if (x.group == c.group && x.cpu == c.cpu) return (int)nd;
+        }
+    }
+    return -1;
+}
+
+// 按策略给出线程 t（共 nt 个）应绑定的 CPU
+CpuId cpu_for_thread(int t, int nt) {
+    const auto& nodes = g_numa.node_cpus;
+    const int nn = (int)nodes.size();
+    if (g_numa.policy == AffinityPolicy::SPREAD) {
+        // 线程按编号连续均分：节点 nd 负责线程 [nd*nt/nn, (nd+1)*nt/nn)
+        int nd = (int)((int64_t)t * nn / nt);
+        int first = (int)(((int64_t)nd * nt + nn - 1) / nn);
+        const auto& cpus = nodes[(size_t)nd];
+        return cpus[(size_t)(t - first) % cpus.size()];
+    }
+    // CLOSE：按节点顺序展开的 CPU 列表依次分配
+    size_t total = 0;
+    for (const auto& cpus : nodes) total += cpus.size();
+    size_t k = (size_t)t % total;
+    for (const auto& cpus : nodes) {
+        if (k < cpus.size()) return cpus[k];
+        k -= cpus.size();
+    }
+    return nodes[0][0];
+}
+
+// 与 omp_static_range 相同的切块：第 t 个线程负责 [t*chunk, (t+1)*chunk)
+uint64_t static_chunk(uint64_t n, int nt) {
+    return (n + (uint64_t)nt - 1) / (uint64_t)nt;
+}
+
+} // namespace
+
+void numa_init() {
+    if (g_numa.inited) return;
+    g_numa.inited = true;
+    g_numa.policy = policy_from_env();
+    detect_nodes(g_numa.node_cpus);
+
+    const int nt = omp_threads();
+    g_numa.thread_node.assign((size_t)nt, -1);
+    if (g_numa.node_cpus.empty()) {
+        g_numa.policy = AffinityPolicy::NONE;
+        std::cout << "[NUMA] topology unavailable, threads not pinned\n";
+        return;
+    }
+
+    int pinned = 0;
+    g_process_mask = save_affinity();
+#if defined(USE_OPENMP)
+#pragma omp parallel num_threads(nt) reduction(+:pinned)
+#endif
+    {
+#if defined(USE_OPENMP)
+        const int t = omp_get_thread_num();
+#else
+        const int t = 0;
+#endif
+        if (g_numa.policy != AffinityPolicy::NONE) {
+            CpuId c = cpu_for_thread(t, nt);
+            if (pin_current_thread(c)) ++pinned;
+            g_numa.thread_node[(size_t)t] = node_of_cpu(c);
+        }
+        else {
+            // 不绑定时只能记录线程当前所在节点，之后可能被迁移
+            g_numa.thread_node[(size_t)t] = node_of_cpu(current_cpu());
+        }
+    }
+
+    std::cout << "[NUMA] nodes=" << g_numa.node_cpus.size()
+        << " policy=" << policy_name(g_numa.policy)
+        << " threads=" << nt
+        << " pinned=" << pinned << "\n";
+    for (size_t nd = 0; nd < g_numa.node_cpus.size(); ++nd) {
+        int cnt = 0;
+        for (int x : g_numa.thread_node) cnt += (x == (int)nd);
+        std::cout << "[NUMA]   node " << nd << ": cpus=" << g_numa.node_cpus[nd].size()
+            << " threads=" << cnt << "\n";
+    }
+}
+
+void numa_release_thread() {
+    if (g_numa.inited && g_numa.policy != AffinityPolicy::NONE) restore_affinity(g_process_mask);
+}
+
+int numa_node_count() {
+    numa_init();
+    return g_numa.node_cpus.empty() ? 1 : (int)g_numa.node_cpus.size();
+}
+
+void numa_node_range(uint64_t n, int node, uint64_t& b, uint64_t& e) {
+    numa_init();
+    const int nt = (int)g_numa.thread_node.size();
+    const uint64_t chunk = static_chunk(n, nt);
+    b = n; e = 0;
+    for (int t = 0; t < nt; ++t) {
+        if (g_numa.thread_node[(size_t)t] != node) continue;
+        uint64_t tb = (uint64_t)t * chunk < n ? (uint64_t)t * chunk : n;
+        uint64_t te = tb + chunk < n ? tb + chunk : n;
+        if (tb < b) b = tb;
+        if (te > e) e = te;
+    }
+    if (b >= e) b = e = 0;
+}
+
+double numa_local_ratio(const float* data, uint64_t n) {
+    numa_init();
+    if (!data || n == 0 || g_numa.node_cpus.empty()) return -1.0;
+    const int nt = (int)g_numa.thread_node.size();
+    const uint64_t chunk = static_chunk(n, nt);
+    const uintptr_t ps = (uintptr_t)page_size();
+    const uintptr_t base = (uintptr_t)data;
+    const uintptr_t first = base & ~(ps - 1);
+    const uintptr_t last = (base + n * sizeof(float) - 1) & ~(ps - 1);
+
+    const size_t BATCH = 4096;
+    std::vector<void*> pages;
+    std::vector<int> owner, node(BATCH);
+    pages.reserve(BATCH);
+    owner.reserve(BATCH);
+    uint64_t local = 0, resident = 0;
+
+    auto flush = [&]() {
+        query_page_nodes(pages.data(), pages.size(), node.data());
+        for (size_t i = 0; i < pages.size(); ++i) {
+            if (node[i] < 0) continue;
+            ++resident;
+            local += (node[i] == owner[i]);
+        }
+        pages.clear();
+        owner.clear();
+    };
+
+    for (uintptr_t p = first; p <= last; p += ps) {
+        // 页的第一个元素决定由哪个线程处理（跨线程边界的页只有一个能是本地）
+        uintptr_t q = p < base ? base : p;
+        uint64_t idx = (uint64_t)(q - base) / sizeof(float);
+        int t = (int)(idx / chunk);
+        pages.push_back((void*)p);
+        owner.push_back(g_numa.thread_node[(size_t)(t < nt ? t : nt - 1)]);
+        if (pages.size() == BATCH) flush();
+    }
+    if (!pages.empty()) flush();
+    return resident ? (double)local / (double)resident : -1.0;
+}
+
+void numa_report(const char* tag, const float* data, uint64_t n) {
+    double r = numa_local_ratio(data, n);
+    std::cout << "[NUMA] " << tag << " n=" << n << " local_ratio=";
+    if (r < 0) std::cout << "n/a";
+    else std::cout << std::fixed << std::setprecision(4) << r << std::defaultfloat;
+    std::cout << "\n";
+    for (int nd = 0; nd < numa_node_count(); ++nd) {
+        uint64_t b, e;
+        numa_node_range(n, nd, b, e);
+        std::cout << "[NUMA]   node " << nd << " range=[" << b << ", " << e << ")\n";
+    }
+}
@@ -0,0 +1,58 @@
+﻿/**
+ * @file numa_mem.h
+ * @brief NUMA 感知的内存放置与线程绑定
+ * * 多路服务器上，单线程填充 512MB 的数据会让所有页落在 0 号节点，OpenMP 内核随后有一半数据要跨互连读取。
+ * 本模块提供：
+ * 1. 线程绑定策略（NONE / CLOSE / SPREAD，含义同 OpenMP 的 proc_bind）：启动时把 OpenMP 线程逐个绑定到 CPU，
+ *    SPREAD 把线程按编号连续地均分到各节点，使每个节点负责 [begin, end) 中连续的一段。
+ * 2. FirstTouchVec：resize 时不写内存的 vector，页面在第一次写入时才分配，
+ *    配合与内核相同的静态切块并行填充（见 init_local），每页落在之后处理它的线程所在节点。
+ * 3. 本地内存比例报告：查询每页实际所在节点（Windows: QueryWorkingSetEx，Linux: move_pages），
+ *    与按静态切块推算出的处理线程所在节点比较。
+ * 环境变量 DPC_AFFINITY（none/close/spread）可覆盖编译期默认策略。
+ */
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+enum class AffinityPolicy : uint32_t {
+    NONE = 0,       // 不绑定，由操作系统调度
+    CLOSE = 1,      // 线程依次占满节点 0 的 CPU，再到节点 1……
+    SPREAD = 2      // 线程按编号连续均分到各节点
+};
+
+static constexpr AffinityPolicy AFFINITY_POLICY = AffinityPolicy::SPREAD;   // TODO：可切换线程绑定策略
+
+// 默认初始化的分配器：resize 不写 0，避免由调用 resize 的单个线程完成首次访问
+template <class T>
+struct FirstTouchAllocator : std::allocator<T> {
+    template <class U> struct rebind { using other = FirstTouchAllocator<U>; };
+    FirstTouchAllocator() = default;
+    template <class U> FirstTouchAllocator(const FirstTouchAllocator<U>&) noexcept {}
+    template <class U> void construct(U* p) noexcept { ::new ((void*)p) U; }
+    template <class U, class... A> void construct(U* p, A&&... a) { ::new ((void*)p) U(std::forward<A>(a)...); }
+};
+
+using FirstTouchVec = std::vector<float, FirstTouchAllocator<float>>;
+
+// 检测拓扑并按策略绑定 OpenMP 线程（只执行一次，重复调用无副作用），打印 [NUMA] 摘要
+void numa_init();
+
+// 辅助线程（std::thread）启动时调用：恢复绑定前进程的亲和性。主线程即 OpenMP 0 号线程，已绑定到单个 CPU，
+// 它创建的线程在 Linux 上会继承这一个 CPU 的掩码；未绑定或 numa_init 尚未执行时不做任何事
+void numa_release_thread();
+
+// NUMA 节点数（无法检测时为 1）
+int numa_node_count();
+
+// 按静态切块，长度为 n 的数据中属于 node 的连续区间 [b, e)（SPREAD 策略下即该节点线程负责的部分）
+void numa_node_range(uint64_t n, int node, uint64_t& b, uint64_t& e);
+
+// data[0, n) 的各页中，位于"按静态切块处理该页的线程"所在节点上的比例；无法查询时返回负数
+double numa_local_ratio(const float* data, uint64_t n);
+
+// 打印 [NUMA] 本地内存比例与各节点负责的区间
+void numa_report(const char* tag, const float* data, uint64_t n);
@@ -0,0 +1,44 @@
+﻿/**
+ * @file range_gen.h
+ * @brief 可按下标区间生成数据的数据源（生成器融合计算用）
+ * * worker 只收到 (begin, end)，数据本来就是按下标生成的，没有必要先写满一个 O(n) 的数组再读一遍。
+ * RangeGenerator 按全局下标区间写出数据；cpu_ops.h 中的 *_gen 内核每次只生成 GEN_TILE 个元素到
+ * 线程栈上的 L1 大小缓冲区，立即交给分发得到的单线程内核归约，内存占用从 O(n) 降为 O(线程数)，
+ * 也省去了大数组的分配与缺页开销。
+ * 新的数据源只需实现 fill()；同一下标必须总是生成同一个值（master/worker 两端各自生成）。
+ */
+#pragma once
+#include <cstdint>
+
+// 每次生成的元素数：16KB，放得进 L1；等于 DET_BLOCK，保证确定性求和按块划分不变
+#define GEN_TILE 4096
+
+// SUM/MAX/STATS 是否走生成器融合路径（false：先 init_local 生成完整数组再计算，SORT 总是需要数组）
+static constexpr bool USE_GEN_FUSED = true;   // TODO：可切换为 false 对比物化数组的耗时
+
+// 可按下标随机访问的数据源
+struct RangeGenerator {
+    virtual ~RangeGenerator() = default;
+    // 写出全局下标 [first, first + count) 的元素到 dst
+    virtual void fill(float* dst, uint64_t first, uint64_t count) const = 0;
+};
+
+// 现有的合成数据：x[i] = i + 1（与 init_local 一致）
+// 下标 < 2^53 时 double 加法精确，再舍入到 float 一次，结果与 (float)(i + 1) 相同；
+// 块内用 int 偏移，编译器可以向量化 int -> double 转换（uint64 -> float 只能逐个转换）
+struct IotaGenerator final : RangeGenerator {
+    void fill(float* dst, uint64_t first, uint64_t count) const override {
+        for (uint64_t k0 = 0; k0 < count; k0 += GEN_TILE) {
+            const double base = (double)(first + k0 + 1);
+            const int m = (int)(count - k0 < GEN_TILE ? count - k0 : GEN_TILE);
+            float* out = dst + k0;
+            for (int k = 0; k < m; ++k) out[k] = (float)(base + (double)k);
+        }
+    }
+};
+
+// master/worker 默认使用的数据源
+static inline const RangeGenerator& default_generator() {
+    static const IotaGenerator g;
+    return g;
+}
@@ -0,0 +1,690 @@
+﻿/**
+ * @file reduce_kernel.h
+ * @brief "逐元素变换 + 归约" 内核模板
+ * * 原来的 sum/max 内核按 标量/SSE/AVX2 × sum/max × OpenMP 开/关 各写一份，循环几乎相同，
+ * 某个版本上的优化很容易漏到其它版本。这里把它们统一成一个编译期特化的模板：
+ *
+ *     reduce_transform<Transform, Reducer, Isa, Threading>(data, n)
+ *
+ * - Transform：逐元素变换（LogSqrtTransform / IdentityTransform），提供 vapply<Isa>(v)。
+ * - Reducer：归约方式（SumReducer / MaxReducer），定义累加器类型、单位元与合并规则。
+ * - Isa：指令集特征（IsaScalar / IsaSse2 / IsaAvx2 / IsaAvx512），封装加载、尾部掩码等基本操作。
+ * - Threading：线程策略（SerialThreads / OmpThreads）。
+ *
+ * 每个线程使用 4 个独立累加器隐藏指令延迟；尾部不足一个向量的元素同样走向量变换，
+ * 多余通道用 Reducer 的单位元替换。OmpThreads 把每个线程的部分结果写入按缓存行对齐的槽位，
+ * 并行区结束后按线程号顺序合并，不需要 critical/原子操作，合并顺序也是确定的。
+ *
+ * Isa 特征只在编译器开启对应指令集时定义（见 simd_log.h 的 SIMD_HAS_*），
+ * 因此各 ISA 的实例化放在 cpu_kernels_*.cpp 中，由 cpu_dispatch 在运行时选择。
+ *
+ * stats_transform_range<Transform, Isa> 是同一套特征上的多统计量内核（min/max/sum/方差/argmax 一次遍历）；
+ * det_sum_range<Transform, Isa> 是与线程数、切分方式、ISA 都无关的确定性求和内核；
+ * partition_by_code_range<Isa> 是排序用的无分支向量化原地划分（仅 AVX2 / AVX-512 提供 part_perm）。
+ */
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "cpu_dispatch.h"
+#include "cpu_kernels_scalar.h"
+#include "simd_log.h"
+
+//OpenMP 支持
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+// ==================== 指令集特征 ====================
+// 每个 Isa 提供：
+//   vf / W                      向量类型与通道数
+//   loadu / load_partial        完整加载 / 只加载前 r 个通道（r < W，其余为 0）
+//   storeu / store_partial      完整存储 / 只存储前 r 个通道
+//   keep_first(v, r, other)     前 r 个通道取 v，其余取 other
+//   set1 / max / hmax           广播、忽略 NaN 的最大值（a 为 NaN 时返回 b）、水平最大值
+//   add / sub / min             加减法、忽略 NaN 的最小值（a 为 NaN 时返回 b）
+//   argmax_step(m, mi, y, idx)  y > m（或该通道尚无下标、且 y == m）时用 (y, idx) 替换 (m, mi)；mi = -1 表示尚无下标
+//   dacc / dzero / dadd / dmerge / dhsum   双精度累加器（float 向量拆成 double 累加）
+//   dadd_sqdev(a, v, shift)     以 double 累加 (v - shift)^2
+//   log_sqrt                    向量化 0.5*ln(x)
+//   part_perm(v, pivot, c)      按 sort_key_code(v) < pivot 重排通道：满足的按原顺序排在前面（共 c 个），其余排在后面
+
+struct IsaScalar {
+    static constexpr int W = 1;
+    using vf = float;
+    static inline vf loadu(const float* p) { return *p; }
+    static inline vf load_partial(const float*, uint64_t) { return 0.0f; }
+    static inline void storeu(float* p, vf v) { *p = v; }
+    static inline void store_partial(float*, uint64_t, vf) {}
+    static inline vf keep_first(vf, uint64_t, vf other) { return other; }
+    static inline vf set1(float x) { return x; }
+    static inline vf max(vf a, vf b) { return (a > b ? a : b); }
+    static inline float hmax(vf v) { return v; }
+    static inline vf add(vf a, vf b) { return a + b; }
+    static inline vf sub(vf a, vf b) { return a - b; }
+    static inline vf min(vf a, vf b) { return (a < b ? a : b); }
+    static inline void argmax_step(vf& m, vf& mi, vf y, vf idx) {
+        if (y > m || (y == m && mi < 0.0f)) { m = y; mi = idx; }
+    }
+
+    using dacc = double;
+    static inline dacc dzero() { return 0.0; }
+    static inline void dadd(dacc& a, vf v) { a += v; }
+    static inline dacc dmerge(dacc a, dacc b) { return a + b; }
+    static inline double dhsum(dacc a) { return a; }
+    static inline void dadd_sqdev(dacc& a, vf v, double shift) {
+        double d = (double)v - shift;
+        a += d * d;
+    }
+
+    // 标量移植的 Cephes 版本，与 SIMD 版本逐位一致（基线 logf(sqrtf(x)) 见 cpu_ops.h）
+    static inline vf log_sqrt(vf x) { return log_sqrt_ss(x); }
+};
+
+#if defined(SIMD_HAS_SSE2)
+struct IsaSse2 {
+    static constexpr int W = 4;
+    using vf = __m128;
+    static inline vf loadu(const float* p) { return _mm_loadu_ps(p); }
+    static inline vf load_partial(const float* p, uint64_t r) {
+        alignas(16) float b[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (uint64_t k = 0; k < r; ++k) b[k] = p[k];
+        return _mm_load_ps(b);
+    }
+    static inline void storeu(float* p, vf v) { _mm_storeu_ps(p, v); }
+    static inline void store_partial(float* p, uint64_t r, vf v) {
+        alignas(16) float b[4];
+        _mm_store_ps(b, v);
+        for (uint64_t k = 0; k < r; ++k) p[k] = b[k];
+    }
+    static inline vf keep_first(vf v, uint64_t r, vf other) {
+        alignas(16) static const int32_t m[8] = { -1, -1, -1, -1, 0, 0, 0, 0 };
+        __m128 keep = _mm_loadu_ps((const float*)(m + 4 - r));
+        return _mm_or_ps(_mm_and_ps(keep, v), _mm_andnot_ps(keep, other));
+    }
+    static inline vf set1(float x) { return _mm_set1_ps(x); }
+    static inline vf max(vf a, vf b) { return _mm_max_ps(a, b); }
+    static inline vf add(vf a, vf b) { return _mm_add_ps(a, b); }
+    static inline vf sub(vf a, vf b) { return _mm_sub_ps(a, b); }
+    static inline vf min(vf a, vf b) { return _mm_min_ps(a, b); }
+    static inline void argmax_step(vf& m, vf& mi, vf y, vf idx) {
+        __m128 take = _mm_or_ps(_mm_cmpgt_ps(y, m),
+            _mm_and_ps(_mm_cmpeq_ps(y, m), _mm_cmplt_ps(mi, _mm_setzero_ps())));
+        m = _mm_or_ps(_mm_and_ps(take, y), _mm_andnot_ps(take, m));
+        mi = _mm_or_ps(_mm_and_ps(take, idx), _mm_andnot_ps(take, mi));
+    }
+    static inline float hmax(vf v) {
+        alignas(16) float b[4];
+        _mm_store_ps(b, v);
+        float m = b[0];
+        for (int k = 1; k < 4; ++k) m = (b[k] > m ? b[k] : m);
+        return m;
+    }
+
+    struct dacc { __m128d lo, hi; };
+    static inline dacc dzero() { return { _mm_setzero_pd(), _mm_setzero_pd() }; }
+    static inline void dadd(dacc& a, vf v) {
+        a.lo = _mm_add_pd(a.lo, _mm_cvtps_pd(v));
+        a.hi = _mm_add_pd(a.hi, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+    }
+    static inline dacc dmerge(dacc a, dacc b) { return { _mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi) }; }
+    static inline double dhsum(dacc a) {
+        alignas(16) double b[2];
+        _mm_store_pd(b, _mm_add_pd(a.lo, a.hi));
+        return b[0] + b[1];
+    }
+    static inline void dadd_sqdev(dacc& a, vf v, double shift) {
+        const __m128d s = _mm_set1_pd(shift);
+        __m128d lo = _mm_sub_pd(_mm_cvtps_pd(v), s);
+        __m128d hi = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), s);
+        a.lo = _mm_add_pd(a.lo, _mm_mul_pd(lo, lo));
+        a.hi = _mm_add_pd(a.hi, _mm_mul_pd(hi, hi));
+    }
+
+    static inline vf log_sqrt(vf x) { return log_sqrt_ps_sse(x); }
+};
+#endif
+
+#if defined(SIMD_HAS_AVX2)
+// AVX2 没有 compress 指令：用 8 位比较掩码查表得到 permutevar8x32 的下标（256 项，约 9KB，编译期生成）
+struct PartitionLut8 {
+    alignas(32) int32_t perm[256][8];
+    int32_t count[256];
+};
+
+static constexpr PartitionLut8 make_partition_lut8() {
+    PartitionLut8 t{};
+    for (int m = 0; m < 256; ++m) {
+        int k = 0;
+        for (int j = 0; j < 8; ++j) if ((m >> j) & 1) t.perm[m][k++] = j;
+        t.count[m] = k;
+        for (int j = 0; j < 8; ++j) if (!((m >> j) & 1)) t.perm[m][k++] = j;
+    }
+    return t;
+}
+
+static constexpr PartitionLut8 PARTITION_LUT8 = make_partition_lut8();
+
+struct IsaAvx2 {
+    static constexpr int W = 8;
+    using vf = __m256;
+    static inline __m256i first_mask(uint64_t r) {
+        return _mm256_cmpgt_epi32(_mm256_set1_epi32((int)r), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    }
+    static inline vf loadu(const float* p) { return _mm256_loadu_ps(p); }
+    static inline vf load_partial(const float* p, uint64_t r) { return _mm256_maskload_ps(p, first_mask(r)); }
+    static inline void storeu(float* p, vf v) { _mm256_storeu_ps(p, v); }
+    static inline void store_partial(float* p, uint64_t r, vf v) { _mm256_maskstore_ps(p, first_mask(r), v); }
+    static inline vf keep_first(vf v, uint64_t r, vf other) {
+        return _mm256_blendv_ps(other, v, _mm256_castsi256_ps(first_mask(r)));
+    }
+    static inline vf set1(float x) { return _mm256_set1_ps(x); }
+    static inline vf max(vf a, vf b) { return _mm256_max_ps(a, b); }
+    static inline vf add(vf a, vf b) { return _mm256_add_ps(a, b); }
+    static inline vf sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+    static inline vf min(vf a, vf b) { return _mm256_min_ps(a, b); }
+    static inline void argmax_step(vf& m, vf& mi, vf y, vf idx) {
+        __m256 take = _mm256_or_ps(_mm256_cmp_ps(y, m, _CMP_GT_OQ),
+            _mm256_and_ps(_mm256_cmp_ps(y, m, _CMP_EQ_OQ), _mm256_cmp_ps(mi, _mm256_setzero_ps(), _CMP_LT_OQ)));
+        m = _mm256_blendv_ps(m, y, take);
+        mi = _mm256_blendv_ps(mi, idx, take);
+    }
+    static inline float hmax(vf v) {
+        alignas(32) float b[8];
+        _mm256_store_ps(b, v);
+        float m = b[0];
+        for (int k = 1; k < 8; ++k) m = (b[k] > m ? b[k] : m);
+        return m;
+    }
+
+    struct dacc { __m256d lo, hi; };
+    static inline dacc dzero() { return { _mm256_setzero_pd(), _mm256_setzero_pd() }; }
+    static inline void dadd(dacc& a, vf v) {
+        a.lo = _mm256_add_pd(a.lo, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+        a.hi = _mm256_add_pd(a.hi, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+    }
+    static inline dacc dmerge(dacc a, dacc b) { return { _mm256_add_pd(a.lo, b.lo), _mm256_add_pd(a.hi, b.hi) }; }
+    static inline double dhsum(dacc a) {
+        alignas(32) double b[4];
+        _mm256_store_pd(b, _mm256_add_pd(a.lo, a.hi));
+        return (b[0] + b[1]) + (b[2] + b[3]);
+    }
+    static inline void dadd_sqdev(dacc& a, vf v, double shift) {
+        const __m256d s = _mm256_set1_pd(shift);
+        __m256d lo = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(v)), s);
+        __m256d hi = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)), s);
+        a.lo = _mm256_add_pd(a.lo, _mm256_mul_pd(lo, lo));
+        a.hi = _mm256_add_pd(a.hi, _mm256_mul_pd(hi, hi));
+    }
+
+    static inline vf log_sqrt(vf x) { return log_sqrt_ps_avx2(x); }
+
+    // 键：-0 的位模式清零；无符号比较 = 两边异或符号位后做有符号比较
+    static inline vf part_perm(vf v, uint32_t pivot, int& c) {
+        const __m256i sign = _mm256_set1_epi32((int)0x80000000u);
+        const __m256i u = _mm256_castps_si256(v);
+        const __m256i code = _mm256_andnot_si256(_mm256_cmpeq_epi32(u, sign), u);
+        const __m256i lt = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(pivot ^ 0x80000000u)), _mm256_xor_si256(code, sign));
+        const int m = _mm256_movemask_ps(_mm256_castsi256_ps(lt));
+        c = PARTITION_LUT8.count[m];
+        return _mm256_permutevar8x32_ps(v, _mm256_load_si256((const __m256i*)PARTITION_LUT8.perm[m]));
+    }
+};
+#endif
+
+#if defined(SIMD_HAS_AVX512)
+struct IsaAvx512 {
+    static constexpr int W = 16;
+    using vf = __m512;
+    static inline __mmask16 first_mask(uint64_t r) { return (__mmask16)((1u << r) - 1u); }
+    static inline vf loadu(const float* p) { return _mm512_loadu_ps(p); }
+    static inline vf load_partial(const float* p, uint64_t r) { return _mm512_maskz_loadu_ps(first_mask(r), p); }
+    static inline void storeu(float* p, vf v) { _mm512_storeu_ps(p, v); }
+    static inline void store_partial(float* p, uint64_t r, vf v) { _mm512_mask_storeu_ps(p, first_mask(r), v); }
+    static inline vf keep_first(vf v, uint64_t r, vf other) { return _mm512_mask_mov_ps(other, first_mask(r), v); }
+    static inline vf set1(float x) { return _mm512_set1_ps(x); }
+    static inline vf max(vf a, vf b) { return _mm512_max_ps(a, b); }
+    static inline vf add(vf a, vf b) { return _mm512_add_ps(a, b); }
+    static inline vf sub(vf a, vf b) { return _mm512_sub_ps(a, b); }
+    static inline vf min(vf a, vf b) { return _mm512_min_ps(a, b); }
+    static inline void argmax_step(vf& m, vf& mi, vf y, vf idx) {
+        __mmask16 take = _mm512_cmp_ps_mask(y, m, _CMP_GT_OQ)
+            | (_mm512_cmp_ps_mask(y, m, _CMP_EQ_OQ) & _mm512_cmp_ps_mask(mi, _mm512_setzero_ps(), _CMP_LT_OQ));
+        m = _mm512_mask_mov_ps(m, take, y);
+        mi = _mm512_mask_mov_ps(mi, take, idx);
+    }
+    static inline float hmax(vf v) { return _mm512_reduce_max_ps(v); }
+
+    struct dacc { __m512d lo, hi; };
+    static inline dacc dzero() { return { _mm512_setzero_pd(), _mm512_setzero_pd() }; }
+    static inline void dadd(dacc& a, vf v) {
+        a.lo = _mm512_add_pd(a.lo, _mm512_cvtps_pd(_mm512_castps512_ps256(v)));
+        a.hi = _mm512_add_pd(a.hi, _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1))));
+    }
+    static inline dacc dmerge(dacc a, dacc b) { return { _mm512_add_pd(a.lo, b.lo), _mm512_add_pd(a.hi, b.hi) }; }
+    static inline double dhsum(dacc a) { return _mm512_reduce_add_pd(_mm512_add_pd(a.lo, a.hi)); }
+    static inline void dadd_sqdev(dacc& a, vf v, double shift) {
+        const __m512d s = _mm512_set1_pd(shift);
+        __m512d lo = _mm512_sub_pd(_mm512_cvtps_pd(_mm512_castps512_ps256(v)), s);
+        __m512d hi = _mm512_sub_pd(_mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1))), s);
+        a.lo = _mm512_add_pd(a.lo, _mm512_mul_pd(lo, lo));
+        a.hi = _mm512_add_pd(a.hi, _mm512_mul_pd(hi, hi));
+    }
+
+    static inline vf log_sqrt(vf x) { return log_sqrt_ps_avx512(x); }
+
+    // compress 得到两组下标，expand 把第二组接到第 c 个通道之后，再整体置换一次
+    // （不用 compressstoreu 写内存：部分 CPU 上它是微码实现，比寄存器内 compress 慢一个数量级）
+    static inline vf part_perm(vf v, uint32_t pivot, int& c) {
+        const __m512i u = _mm512_castps_si512(v);
+        const __m512i code = _mm512_mask_mov_epi32(u, _mm512_cmpeq_epi32_mask(u, _mm512_set1_epi32((int)0x80000000u)), _mm512_setzero_si512());
+        const __mmask16 m = _mm512_cmplt_epu32_mask(code, _mm512_set1_epi32((int)pivot));
+        uint32_t x = m;
+        x = x - ((x >> 1) & 0x5555u);
+        x = (x & 0x3333u) + ((x >> 2) & 0x3333u);
+        x = (x + (x >> 4)) & 0x0F0Fu;
+        c = (int)((x + (x >> 8)) & 0x1Fu);
+        const __m512i iota = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        const __m512i idx = _mm512_mask_expand_epi32(_mm512_maskz_compress_epi32(m, iota),
+            (__mmask16)(0xFFFFu << c), _mm512_maskz_compress_epi32((__mmask16)~m, iota));
+        return _mm512_permutexvar_ps(idx, v);
+    }
+};
+#endif
+
+// ==================== 变换 ====================
+// LogSqrtTransform（见 simd_log.h）的向量版本通过 Isa::log_sqrt 实现。
+
+// 恒等变换：用于原始值最大值（单调变换下推）
+struct IdentityTransform {
+    static constexpr bool monotone_increasing = true;
+    static inline float apply(float x) { return x; }
+    static inline float from_raw_max(float m) { return m; }
+    template <class Isa>
+    static inline typename Isa::vf vapply(typename Isa::vf v) { return v; }
+};
+
+// ==================== 归约 ====================
+
+// 求和：float 结果拆成 double 累加，减少长序列的舍入误差
+struct SumReducer {
+    using result_type = double;
+    static inline result_type identity() { return 0.0; }
+    static inline result_type combine(result_type a, result_type b) { return a + b; }
+
+    template <class Isa> using acc_type = typename Isa::dacc;
+    template <class Isa> static inline acc_type<Isa> init() { return Isa::dzero(); }
+    template <class Isa> static inline typename Isa::vf neutral() { return Isa::set1(0.0f); }
+    template <class Isa> static inline void step(acc_type<Isa>& a, typename Isa::vf v) { Isa::dadd(a, v); }
+    template <class Isa> static inline acc_type<Isa> merge(acc_type<Isa> a, acc_type<Isa> b) { return Isa::dmerge(a, b); }
+    template <class Isa> static inline result_type finish(acc_type<Isa> a) { return Isa::dhsum(a); }
+};
+
+// 最大值：与基线 (v > m ? v : m) 一样忽略 NaN
+struct MaxReducer {
+    using result_type = float;
+    static inline result_type identity() { return -INFINITY; }
+    static inline result_type combine(result_type a, result_type b) { return (a > b ? a : b); }
+
+    template <class Isa> using acc_type = typename Isa::vf;
+    template <class Isa> static inline acc_type<Isa> init() { return Isa::set1(-INFINITY); }
+    template <class Isa> static inline typename Isa::vf neutral() { return Isa::set1(-INFINITY); }
+    template <class Isa> static inline void step(acc_type<Isa>& a, typename Isa::vf v) { a = Isa::max(v, a); }
+    template <class Isa> static inline acc_type<Isa> merge(acc_type<Isa> a, acc_type<Isa> b) { return Isa::max(a, b); }
+    template <class Isa> static inline result_type finish(acc_type<Isa> a) { return Isa::hmax(a); }
+};
+
+// 多统计量的单位元与合并。写成 static 函数（内部链接）：各 ISA 内核文件以不同指令集编译，
+// 若用普通 inline 函数，链接器可能让 master/worker 共用 AVX 文件里生成的那一份。
+// combine(a, b) 要求 a 的下标在 b 之前：最大值相等时保留 a 的 argmax，即第一次出现的位置
+static inline StatsResult stats_identity() { return { 0, 0.0, 0.0, INFINITY, -INFINITY, STATS_NO_INDEX }; }
+
+static inline StatsResult stats_combine(const StatsResult& a, const StatsResult& b) {
+    if (a.count == 0) return b;
+    if (b.count == 0) return a;
+    StatsResult r;
+    const double na = (double)a.count, nb = (double)b.count;
+    const double delta = b.sum / nb - a.sum / na;
+    r.count = a.count + b.count;
+    r.sum = a.sum + b.sum;
+    r.m2 = a.m2 + b.m2 + delta * delta * (na * nb / (na + nb));
+    r.min = (b.min < a.min ? b.min : a.min);
+    if (b.argmax != STATS_NO_INDEX && (a.argmax == STATS_NO_INDEX || b.max > a.max)) {
+        r.max = b.max;
+        r.argmax = b.argmax;
+    }
+    else {
+        r.max = a.max;
+        r.argmax = a.argmax;
+    }
+    return r;
+}
+
+// 供线程策略使用的归约描述
+struct StatsReducer {
+    using result_type = StatsResult;
+    static inline result_type identity() { return stats_identity(); }
+    static inline result_type combine(const result_type& a, const result_type& b) { return stats_combine(a, b); }
+};
+
+// 把分段结果的 argmax 从段内下标平移为全局下标
+static inline void stats_offset(StatsResult& r, uint64_t base) {
+    if (r.argmax != STATS_NO_INDEX) r.argmax += base;
+}
+
+static inline double stats_mean(const StatsResult& r) { return r.count ? r.sum / (double)r.count : NAN; }
+static inline double stats_variance(const StatsResult& r) { return r.count ? r.m2 / (double)r.count : NAN; }
+
+// ==================== 线程策略 ====================
+
+// 当前线程负责的 [b, e)（与 schedule(static) 相同的连续切块）
+static inline void omp_static_range(uint64_t n, uint64_t& b, uint64_t& e) {
+#if defined(USE_OPENMP)
+    uint64_t nt = (uint64_t)omp_get_num_threads();
+    uint64_t t = (uint64_t)omp_get_thread_num();
+#else
+    uint64_t nt = 1, t = 0;
+#endif
+    uint64_t chunk = (n + nt - 1) / nt;
+    b = t * chunk < n ? t * chunk : n;
+    e = b + chunk < n ? b + chunk : n;
+}
+
+// 单线程：整段交给 body
+struct SerialThreads {
+    template <class Reducer, class Body>
+    static inline typename Reducer::result_type run(uint64_t n, Body body) { return body(0, n); }
+};
+
+// OpenMP：每个线程处理一段连续数据，部分结果写入独占缓存行的槽位，最后按线程号顺序合并
+struct OmpThreads {
+    template <class T>
+    struct alignas(64) Padded { T v; };
+
+    template <class Reducer, class Body>
+    static inline typename Reducer::result_type run(uint64_t n, Body body) {
+#if defined(USE_OPENMP)
+        using R = typename Reducer::result_type;
+        const int max_t = omp_get_max_threads();
+        std::vector<Padded<R>> part((size_t)max_t, Padded<R>{ Reducer::identity() });
+#pragma omp parallel num_threads(max_t)
+        {
+            uint64_t b, e;
+            omp_static_range(n, b, e);
+            part[(size_t)omp_get_thread_num()].v = body(b, e);
+        }
+        R r = Reducer::identity();
+        for (const auto& p : part) r = Reducer::combine(r, p.v);
+        return r;
+#else
+        return body(0, n);
+#endif
+    }
+};
+
+// ==================== 内核模板 ====================
+
+// 单线程主体：4 个独立累加器，尾部用部分加载 + 单位元补齐
+template <class Transform, class Reducer, class Isa>
+inline typename Reducer::result_type reduce_transform_range(const float* data, uint64_t n) {
+    using acc = typename Reducer::template acc_type<Isa>;
+    constexpr uint64_t W = (uint64_t)Isa::W;
+    acc a0 = Reducer::template init<Isa>(), a1 = a0, a2 = a0, a3 = a0;
+
+    uint64_t i = 0;
+    for (; i + 4 * W <= n; i += 4 * W) {
+        Reducer::template step<Isa>(a0, Transform::template vapply<Isa>(Isa::loadu(data + i)));
+        Reducer::template step<Isa>(a1, Transform::template vapply<Isa>(Isa::loadu(data + i + W)));
+        Reducer::template step<Isa>(a2, Transform::template vapply<Isa>(Isa::loadu(data + i + 2 * W)));
+        Reducer::template step<Isa>(a3, Transform::template vapply<Isa>(Isa::loadu(data + i + 3 * W)));
+    }
+    for (; i + W <= n; i += W) {
+        Reducer::template step<Isa>(a0, Transform::template vapply<Isa>(Isa::loadu(data + i)));
+    }
+    if (i < n) {
+        uint64_t r = n - i;
+        typename Isa::vf v = Transform::template vapply<Isa>(Isa::load_partial(data + i, r));
+        Reducer::template step<Isa>(a1, Isa::keep_first(v, r, Reducer::template neutral<Isa>()));
+    }
+    return Reducer::template finish<Isa>(
+        Reducer::template merge<Isa>(Reducer::template merge<Isa>(a0, a1), Reducer::template merge<Isa>(a2, a3)));
+}
+
+template <class Transform, class Reducer, class Isa, class Threading = SerialThreads>
+inline typename Reducer::result_type reduce_transform(const float* data, uint64_t n) {
+    return Threading::template run<Reducer>(n, [data](uint64_t b, uint64_t e) {
+        return reduce_transform_range<Transform, Reducer, Isa>(data + b, e - b);
+    });
+}
+
+// 把单线程内核（例如 cpu_kernels() 分发得到的函数指针）套上线程策略
+template <class Reducer, class Threading>
+inline typename Reducer::result_type reduce_with(typename Reducer::result_type (*kernel)(const float*, uint64_t),
+                                                 const float* data, uint64_t n) {
+    return Threading::template run<Reducer>(n, [kernel, data](uint64_t b, uint64_t e) {
+        return kernel(data + b, e - b);
+    });
+}
+
+// 逐元素变换输出（非归约），尾部同样走向量变换，保证与主循环结果逐位一致
+template <class Transform, class Isa>
+inline void map_transform(const float* in, float* out, uint64_t n) {
+    constexpr uint64_t W = (uint64_t)Isa::W;
+    uint64_t i = 0;
+    for (; i + W <= n; i += W) {
+        Isa::storeu(out + i, Transform::template vapply<Isa>(Isa::loadu(in + i)));
+    }
+    if (i < n) {
+        Isa::store_partial(out + i, n - i, Transform::template vapply<Isa>(Isa::load_partial(in + i, n - i)));
+    }
+}
+
+// 多统计量内核块长：块内数据留在 L1 中，块边界处做一次水平归约与 Welford 合并
+#define STATS_BLOCK 4096
+
+// 单线程多统计量：每块内
+// - min、max 和 argmax 按通道维护（argmax 用块内下标，float 可精确表示）；
+// - sum 与 (y - shift)^2 以 double 累加，shift 取块内第一个变换值，块的 m2 = sq - (sum - n*shift)^2 / n；
+// 块结束后折叠各通道，再用 stats_combine 并入结果，对内存只读一遍。
+template <class Transform, class Isa>
+inline StatsResult stats_transform_range(const float* data, uint64_t n) {
+    using vf = typename Isa::vf;
+    constexpr uint64_t W = (uint64_t)Isa::W;
+    static const float iota_f[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+    const vf iota = Isa::loadu(iota_f);
+    const vf step = Isa::set1((float)W);
+    const vf pos_inf = Isa::set1(INFINITY), neg_inf = Isa::set1(-INFINITY);
+
+    StatsResult r = stats_identity();
+    for (uint64_t b = 0; b < n; b += STATS_BLOCK) {
+        const uint64_t len = (n - b < STATS_BLOCK ? n - b : STATS_BLOCK);
+        const float* x = data + b;
+
+        // 平移量：块内第一个变换值（非有限值时取 0），用向量变换求得，与块内其它元素一致
+        float first[16];
+        Isa::storeu(first, Transform::template vapply<Isa>(len >= W ? Isa::loadu(x) : Isa::load_partial(x, len)));
+        const float shift_f = (first[0] - first[0] == 0.0f ? first[0] : 0.0f);
+        const double shift = (double)shift_f;
+
+        vf vmin = pos_inf, vmax = neg_inf, vidx = Isa::set1(-1.0f), idx = iota;
+        typename Isa::dacc s = Isa::dzero(), q = Isa::dzero();
+        uint64_t i = 0;
+        for (; i + W <= len; i += W) {
+            vf y = Transform::template vapply<Isa>(Isa::loadu(x + i));
+            vmin = Isa::min(y, vmin);
+            Isa::argmax_step(vmax, vidx, y, idx);
+            Isa::dadd(s, y);
+            Isa::dadd_sqdev(q, y, shift);
+            idx = Isa::add(idx, step);
+        }
+        if (i < len) {
+            const uint64_t rem = len - i;
+            vf y = Transform::template vapply<Isa>(Isa::load_partial(x + i, rem));
+            vmin = Isa::min(Isa::keep_first(y, rem, pos_inf), vmin);
+            Isa::argmax_step(vmax, vidx, Isa::keep_first(y, rem, neg_inf), Isa::keep_first(idx, rem, Isa::set1(-1.0f)));
+            Isa::dadd(s, Isa::keep_first(y, rem, Isa::set1(0.0f)));
+            Isa::dadd_sqdev(q, Isa::keep_first(y, rem, Isa::set1(shift_f)), shift);
+        }
+
+        // 折叠各通道
+        float mn[16], mx[16], mi[16];
+        Isa::storeu(mn, vmin);
+        Isa::storeu(mx, vmax);
+        Isa::storeu(mi, vidx);
+        StatsResult blk = stats_identity();
+        blk.count = len;
+        blk.sum = Isa::dhsum(s);
+        const double dev = blk.sum - (double)len * shift;
+        blk.m2 = Isa::dhsum(q) - dev * dev / (double)len;
+        if (blk.m2 < 0.0) blk.m2 = 0.0;
+        for (uint64_t k = 0; k < W; ++k) {
+            blk.min = (mn[k] < blk.min ? mn[k] : blk.min);
+            if (mi[k] < 0.0f) continue;
+            const uint64_t at = b + (uint64_t)mi[k];
+            if (blk.argmax == STATS_NO_INDEX || mx[k] > blk.max || (mx[k] == blk.max && at < blk.argmax)) {
+                blk.max = mx[k];
+                blk.argmax = at;
+            }
+        }
+        r = stats_combine(r, blk);
+    }
+    return r;
+}
+
+// ==================== 确定性求和 ====================
+// 目标：SUM 结果与线程数、master/worker 切分位置、所用 ISA 都无关（逐位相同），同时在 float 通道内累加。
+// - 数据按全局下标切成固定的 DET_BLOCK 块；调用方只在块边界处切分（线程、master/worker 都是如此）。
+// - 块内固定使用 16 个虚拟通道（元素 j 进入通道 j % 16），每个通道做 float Kahan 补偿求和；
+//   SSE2/AVX2/AVX-512/标量分别用 4/2/1/16 个寄存器承载这 16 个通道，各通道的运算序列完全相同。
+// - 块结束时按通道顺序把 (s - c) 以 double 相加，再舍入为定点数（量化步长 1/DET_SCALE）。
+// - 块之间用 int64 相加：整数加法满足结合律，任意合并顺序结果都相同。
+// 同一块内出现 inf/NaN 时（由并行的普通累加检测），该块记入 special 标志而不参与定点和。
+// 定点范围：每块 |sum| <= 4096 * 52，总和在 int64 内可容纳约 1e10 个元素。
+#define DET_LANES 16
+
+static inline DetSum det_identity() { return { 0, 0 }; }
+
+static inline DetSum det_combine(const DetSum& a, const DetSum& b) { return { a.fixed + b.fixed, a.special | b.special }; }
+
+// 定点和 + 特殊值标志 -> 结果（与普通求和的 inf/NaN 语义一致）
+static inline double det_value(const DetSum& r) {
+    if ((r.special & DET_SPECIAL_NAN) || (r.special & DET_SPECIAL_POS_INF && r.special & DET_SPECIAL_NEG_INF)) return NAN;
+    if (r.special & DET_SPECIAL_POS_INF) return INFINITY;
+    if (r.special & DET_SPECIAL_NEG_INF) return -INFINITY;
+    return (double)r.fixed / DET_SCALE;
+}
+
+struct DetSumReducer {
+    using result_type = DetSum;
+    static inline result_type identity() { return det_identity(); }
+    static inline result_type combine(const result_type& a, const result_type& b) { return det_combine(a, b); }
+};
+
+template <class Transform, class Isa>
+inline DetSum det_sum_range(const float* data, uint64_t n) {
+    using vf = typename Isa::vf;
+    constexpr uint64_t W = (uint64_t)Isa::W;
+    constexpr uint64_t U = DET_LANES / W;   // 承载 16 个通道所需的寄存器数
+    const vf zero = Isa::set1(0.0f);
+
+    DetSum r = det_identity();
+    for (uint64_t b = 0; b < n; b += DET_BLOCK) {
+        const uint64_t len = (n - b < DET_BLOCK ? n - b : DET_BLOCK);
+        const float* x = data + b;
+        vf s[U], c[U], p[U];
+        for (uint64_t u = 0; u < U; ++u) s[u] = c[u] = p[u] = zero;
+
+        for (uint64_t i = 0; i < len; i += DET_LANES) {
+            const uint64_t rem = len - i;
+            for (uint64_t u = 0; u < U; ++u) {
+                vf v;
+                if (rem >= (u + 1) * W) {
+                    v = Transform::template vapply<Isa>(Isa::loadu(x + i + u * W));
+                }
+                else if (rem > u * W) {
+                    const uint64_t k = rem - u * W;
+                    v = Isa::keep_first(Transform::template vapply<Isa>(Isa::load_partial(x + i + u * W, k)), k, zero);
+                }
+                else {
+                    v = zero;
+                }
+                // Kahan：y = v - c; t = s + y; c = (t - s) - y; s = t
+                vf y = Isa::sub(v, c[u]);
+                vf t = Isa::add(s[u], y);
+                c[u] = Isa::sub(Isa::sub(t, s[u]), y);
+                s[u] = t;
+                p[u] = Isa::add(p[u], v);
+            }
+        }
+
+        float sl[DET_LANES], cl[DET_LANES], pl[DET_LANES];
+        for (uint64_t u = 0; u < U; ++u) {
+            Isa::storeu(sl + u * W, s[u]);
+            Isa::storeu(cl + u * W, c[u]);
+            Isa::storeu(pl + u * W, p[u]);
+        }
+        uint32_t special = 0;
+        double blk = 0.0;
+        for (int k = 0; k < DET_LANES; ++k) {
+            if (pl[k] != pl[k]) special |= DET_SPECIAL_NAN;
+            else if (pl[k] == INFINITY) special |= DET_SPECIAL_POS_INF;
+            else if (pl[k] == -INFINITY) special |= DET_SPECIAL_NEG_INF;
+            blk += (double)sl[k] - (double)cl[k];
+        }
+        if (special) r.special |= special;
+        else r.fixed += (int64_t)std::llround(blk * DET_SCALE);
+    }
+    return r;
+}
+
+// ==================== 划分 ====================
+// 排序用的原地划分：[0, k) 的 sort_key_code < pivot，[k, n) 的 >= pivot，返回 k。
+// 设计说明（无分支、整向量读写）：
+// - 先把首尾各一个向量读进寄存器，两端各腾出 W 个空位；之后每次从空位较少的一端读入一个向量，
+//   part_perm 重排后把同一个向量整体写到左写指针处和右写指针之前，再按 c 移动两个写指针。
+//   每次读入后两端空位都 >= W，因此两次整向量写入中多余的通道只会落在空位里，不会覆盖未读数据。
+// - 不足一个向量的剩余元素先拷出再逐个放置，最后放回开始时读出的两个向量；
+//   放最后一个向量时空位恰好为 W，两次写入的位置与内容完全相同。
+// - n < 2W 时交给标量版本。
+template <class Isa>
+static uint64_t partition_by_code_range(float* a, uint64_t n, uint32_t pivot) {
+    using vf = typename Isa::vf;
+    constexpr uint64_t W = (uint64_t)Isa::W;
+    if (n < 2 * W) return scalar_partition_by_code(a, n, pivot);
+
+    const vf head = Isa::loadu(a);
+    const vf tail = Isa::loadu(a + n - W);
+    uint64_t rl = W, rr = n - W;    // 未读区间 [rl, rr)
+    uint64_t wl = 0, wr = n;        // 已写出：左段 [0, wl)，右段 [wr, n)
+    auto place = [&](vf v) {
+        int c;
+        const vf p = Isa::part_perm(v, pivot, c);
+        Isa::storeu(a + wl, p);
+        Isa::storeu(a + wr - W, p);
+        wl += (uint64_t)c;
+        wr -= W - (uint64_t)c;
+    };
+
+    while (rr - rl >= W) {
+        if (rl - wl <= wr - rr) {
+            const vf v = Isa::loadu(a + rl);
+            rl += W;
+            place(v);
+        }
+        else {
+            rr -= W;
+            place(Isa::loadu(a + rr));
+        }
+    }
+
+    float rest[Isa::W];
+    const uint64_t r = rr - rl;
+    for (uint64_t k = 0; k < r; ++k) rest[k] = a[rl + k];
+    for (uint64_t k = 0; k < r; ++k) {
+        if (sort_key_code(rest[k]) < pivot) a[wl++] = rest[k];
+        else a[--wr] = rest[k];
+    }
+    place(head);
+    place(tail);
+    return wl;
+}
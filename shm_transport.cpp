@@ -0,0 +1,246 @@
+﻿/**
+ * @file shm_transport.cpp
+ * @brief 共享内存结果区域的实现
+ * * Linux: POSIX shm_open + mmap(MAP_SHARED)，等待/唤醒用区域头部 seq 字上的 futex（跨进程，不加 FUTEX_PRIVATE_FLAG）；
+ * Windows: 分页文件支持的命名文件映射（Local\\ 名字空间）+ 同名自动复位事件。
+ * 数据区从页边界开始，生产者先写数据再以 release 语义推进 ready，消费者以 acquire 语义读取 ready 后访问数据。
+ */
+#include "shm_transport.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+// 区域头部占用的字节数（数据区从页边界开始）
+#define SHM_HEADER_BYTES 4096
+#define SHM_MAGIC 0x4D485344u   // 'DSHM'
+
+enum : uint32_t { SHM_RUNNING = 0, SHM_DONE = 1, SHM_FAILED = 2 };
+
+struct ShmRegion::Header {
+    uint32_t magic;
+    uint32_t pad;
+    uint64_t count;
+    std::atomic<uint64_t> ready;    // 已按顺序写好的元素个数
+    std::atomic<uint32_t> seq;      // 每次发布/结束加 1，等待方在其上睡眠
+    std::atomic<uint32_t> state;    // SHM_RUNNING / SHM_DONE / SHM_FAILED
+    double compute_ms;              // state 变为 SHM_DONE 之前写入
+};
+
+namespace {
+
+uint64_t process_id() {
+#if defined(_WIN32)
+    return (uint64_t)GetCurrentProcessId();
+#else
+    return (uint64_t)getpid();
+#endif
+}
+
+#if defined(__linux__)
+// 唤醒所有在 seq 上等待的线程（跨进程）
+void seq_wake(std::atomic<uint32_t>& seq) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+// seq 仍为 seen 时睡眠，最多 timeout_ms；被唤醒、值已变化或超时都直接返回
+void seq_wait(std::atomic<uint32_t>& seq, uint32_t seen, uint32_t timeout_ms) {
+    timespec ts{ (time_t)(timeout_ms / 1000), (long)(timeout_ms % 1000) * 1000000L };
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq), FUTEX_WAIT, seen, &ts, nullptr, 0);
+}
+#endif
+
+} // namespace
+
+bool shm_wanted(const char* ip) {
+    if (!USE_SHM_TRANSPORT) return false;
+    const char* v = std::getenv("DPC_SHM");
+    if (v && *v) return *v != '0';
+    return ip && std::strncmp(ip, "127.", 4) == 0;
+}
+
+ShmRegion::~ShmRegion() {
+    close_region();
+}
+
+void ShmRegion::close_region() {
+#if defined(_WIN32)
+    if (hdr_) UnmapViewOfFile(hdr_);
+    if (mapping_) CloseHandle(mapping_);
+    if (event_) CloseHandle(event_);
+    mapping_ = event_ = nullptr;
+#else
+    if (hdr_) munmap(hdr_, map_bytes_);
+    // master 映射后已删除名字，这里只处理 master 没来得及打开的情况（ENOENT 可忽略）
+    if (owner_ && name_[0]) shm_unlink(name_);
+#endif
+    hdr_ = nullptr;
+    data_ = nullptr;
+    count_ = 0;
+    map_bytes_ = 0;
+    owner_ = false;
+    name_[0] = 0;
+}
+
+bool ShmRegion::create(uint64_t count) {
+    close_region();
+    static std::atomic<uint32_t> serial{ 0 };
+    const size_t bytes = SHM_HEADER_BYTES + (size_t)count * sizeof(float);
+#if defined(_WIN32)
+    std::snprintf(name_, sizeof(name_), "Local\\dpc_sort_%llu_%u",
+        (unsigned long long)process_id(), serial.fetch_add(1));
+    char evt[SHM_NAME_MAX + 8];
+    std::snprintf(evt, sizeof(evt), "%s_evt", name_);
+    mapping_ = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        (DWORD)((uint64_t)bytes >> 32), (DWORD)bytes, name_);
+    const bool fresh = mapping_ && GetLastError() != ERROR_ALREADY_EXISTS;
+    event_ = CreateEventA(nullptr, FALSE, FALSE, evt);
+    void* p = fresh && event_ ? MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, bytes) : nullptr;
+    if (!p) {
+        close_region();
+        return false;
+    }
+#else
+    std::snprintf(name_, sizeof(name_), "/dpc_sort_%llu_%u",
+        (unsigned long long)process_id(), serial.fetch_add(1));
+    const int fd = shm_open(name_, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        name_[0] = 0;
+        return false;
+    }
+    void* p = ftruncate(fd, (off_t)bytes) == 0
+        ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(name_);
+        name_[0] = 0;
+        return false;
+    }
+#endif
+    owner_ = true;
+    map_bytes_ = bytes;
+    static_assert(sizeof(Header) <= SHM_HEADER_BYTES, "shm header too large");
+    hdr_ = new (p) Header{};
+    hdr_->magic = SHM_MAGIC;
+    hdr_->count = count;
+    data_ = reinterpret_cast<float*>(static_cast<char*>(p) + SHM_HEADER_BYTES);
+    count_ = count;
+    return true;
+}
+
+bool ShmRegion::open(const char* name) {
+    close_region();
+    std::snprintf(name_, sizeof(name_), "%s", name);
+#if defined(_WIN32)
+    char evt[SHM_NAME_MAX + 8];
+    std::snprintf(evt, sizeof(evt), "%s_evt", name_);
+    mapping_ = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name_);
+    event_ = OpenEventA(SYNCHRONIZE | EVENT_MODIFY_STATE, FALSE, evt);
+    void* p = mapping_ && event_ ? MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0) : nullptr;
+    MEMORY_BASIC_INFORMATION mi{};
+    const size_t bytes = p && VirtualQuery(p, &mi, sizeof(mi)) ? (size_t)mi.RegionSize : 0;
+#else
+    const int fd = shm_open(name_, O_RDWR, 0);
+    if (fd < 0) {
+        name_[0] = 0;
+        return false;
+    }
+    struct stat st {};
+    const size_t bytes = fstat(fd, &st) == 0 ? (size_t)st.st_size : 0;
+    void* p = bytes >= SHM_HEADER_BYTES ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    shm_unlink(name_);     // 双方都已映射，名字不再需要
+    if (p == MAP_FAILED) p = nullptr;
+#endif
+    if (!p) {
+        close_region();
+        return false;
+    }
+    map_bytes_ = bytes;
+    hdr_ = static_cast<Header*>(p);
+    if (bytes < SHM_HEADER_BYTES || hdr_->magic != SHM_MAGIC
+        || hdr_->count > (bytes - SHM_HEADER_BYTES) / sizeof(float)) {
+        close_region();
+        return false;
+    }
+    data_ = reinterpret_cast<float*>(static_cast<char*>(p) + SHM_HEADER_BYTES);
+    count_ = hdr_->count;
+    return true;
+}
+
+void ShmRegion::resize(size_t n) {
+    if (!hdr_ || n > count_) throw std::runtime_error("shm region too small");
+}
+
+void ShmRegion::publish(uint64_t ready) {
+    hdr_->ready.store(ready < count_ ? ready : count_, std::memory_order_release);
+    wake();
+}
+
+// 先推进 ready 再改 state：等待方看到结束时 ready 已是最终值
+void ShmRegion::finish(bool ok, double compute_ms) {
+    hdr_->compute_ms = compute_ms;
+    if (ok) hdr_->ready.store(count_, std::memory_order_release);
+    hdr_->state.store(ok ? SHM_DONE : SHM_FAILED, std::memory_order_release);
+    wake();
+}
+
+void ShmRegion::wake() {
+    hdr_->seq.fetch_add(1, std::memory_order_release);
+#if defined(_WIN32)
+    SetEvent(event_);
+#elif defined(__linux__)
+    seq_wake(hdr_->seq);
+#endif
+}
+
+uint64_t ShmRegion::wait_ready(uint64_t seen, uint32_t timeout_ms) {
+    const uint32_t s = hdr_->seq.load(std::memory_order_acquire);
+    const bool fin = finished();   // 先读 state：已结束时随后读到的 ready 即最终值
+    uint64_t r = hdr_->ready.load(std::memory_order_acquire);
+    if (r > seen || fin) return r < count_ ? r : count_;
+#if defined(_WIN32)
+    (void)s;
+    WaitForSingleObject(event_, timeout_ms);
+#elif defined(__linux__)
+    seq_wait(hdr_->seq, s, timeout_ms);
+#else
+    (void)s;
+    usleep(timeout_ms * 1000u);
+#endif
+    r = hdr_->ready.load(std::memory_order_acquire);
+    return r < count_ ? r : count_;
+}
+
+bool ShmRegion::finished() const {
+    return hdr_->state.load(std::memory_order_acquire) != SHM_RUNNING;
+}
+
+bool ShmRegion::ok() const {
+    return hdr_->state.load(std::memory_order_acquire) == SHM_DONE;
+}
+
+double ShmRegion::compute_ms() const {
+    return hdr_->compute_ms;
+}
@@ -0,0 +1,71 @@
+﻿/**
+ * @file shm_transport.h
+ * @brief 同机 master/worker 之间的共享内存结果传输
+ * * master 与 worker 在同一台机器上时（WORKER_IP 为回环地址，或环境变量 DPC_SHM=1），HELLO 协商 FEATURE_SHM，
+ * SORT/SORT_SPLIT 的结果不再经过回环 TCP：worker 创建一块共享内存（Linux: shm_open + mmap，Windows: 命名文件映射），
+ * 直接把结果排序（或变换）到其中，主连接上只发 ShmNotice 告知区域名；master 映射同一块内存后直接从中归并或拷贝。
+ * 区域头部的 ready 为已按顺序发布的元素个数：worker 每排好一个桶就推进 ready 并唤醒等待方
+ * （Linux: futex，Windows: 命名事件），master 可以在 worker 仍在排序时开始归并。
+ * master 映射后立即删除区域名，worker 持有自己的映射直到下一个请求，正常流程下系统中不会残留对象。
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "common.h"
+
+// master 等待 worker 发布时检查主连接是否断开的间隔（毫秒）
+#define SHM_WAIT_MS 50
+
+static constexpr bool USE_SHM_TRANSPORT = true;    // TODO：是否在握手时请求/接受共享内存传输，关闭后始终走 TCP
+
+// master 是否请求共享内存传输：环境变量 DPC_SHM=0/1 强制关闭/开启，否则 ip 为回环地址（127.x.x.x）时开启
+bool shm_wanted(const char* ip);
+
+// 一块共享内存结果区域：头部 + count 个 float。worker 用 create 创建并写入，master 用 open 映射后读取
+class ShmRegion {
+public:
+    ShmRegion() = default;
+    ~ShmRegion();
+    ShmRegion(const ShmRegion&) = delete;
+    ShmRegion& operator=(const ShmRegion&) = delete;
+
+    // worker：创建可容纳 count 个 float 的区域，名字自动生成；失败时返回 false（调用方退回 TCP）
+    bool create(uint64_t count);
+    // master：按名字映射 worker 创建的区域，随后删除名字；头部不符时返回 false
+    bool open(const char* name);
+
+    float* data() const { return data_; }
+    uint64_t size() const { return count_; }
+    const char* name() const { return name_; }
+    // 供 bucket_by_code 等按容器接口写出的函数直接写入区域（不能超过创建时的大小）
+    void resize(size_t n);
+
+    // ---- worker ----
+    // 前 ready 个元素已写好（单调不减），唤醒等待方
+    void publish(uint64_t ready);
+    // 结束：ok 为 false 表示结果不完整；compute_ms 为 worker 侧计算耗时
+    void finish(bool ok, double compute_ms);
+
+    // ---- master ----
+    // 等待已发布元素超过 seen，或 worker 结束，或超时（timeout_ms）；返回当前已发布的元素个数
+    uint64_t wait_ready(uint64_t seen, uint32_t timeout_ms);
+    bool finished() const;
+    bool ok() const;
+    double compute_ms() const;
+
+private:
+    struct Header;
+    void close_region();
+    void wake();
+
+    Header* hdr_ = nullptr;
+    float* data_ = nullptr;
+    uint64_t count_ = 0;
+    size_t map_bytes_ = 0;
+    bool owner_ = false;
+    char name_[SHM_NAME_MAX] = {};
+#if defined(_WIN32)
+    void* mapping_ = nullptr;
+    void* event_ = nullptr;
+#endif
+};
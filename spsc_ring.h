@@ -0,0 +1,92 @@
+﻿/**
+ * @file spsc_ring.h
+ * @brief 单生产者单消费者（SPSC）无锁环形缓冲
+ * * 用于 master 边接收边归并 worker 的排序结果：接收线程（生产者）把网络上的一帧写入空闲槽位，
+ * 归并线程（消费者）按顺序取出已填满的槽位，用完后归还。
+ * 槽位数与每槽容量固定，因此额外内存恒为 SLOTS * 容量，与数据规模无关。
+ * 只用两个单调递增的计数器（head 由生产者写、tail 由消费者写）做 acquire/release 同步，不需要锁；
+ * 等待时让出 CPU。
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+template <class T, size_t SLOTS>
+class SpscRing {
+public:
+    explicit SpscRing(size_t slot_capacity) : cap_(slot_capacity) {
+        for (auto& s : slots_) s.data.resize(slot_capacity);
+    }
+
+    size_t slot_capacity() const { return cap_; }
+
+    // ---- 生产者 ----
+    // 等待一个空闲槽位；消费者已放弃时返回 nullptr
+    T* producer_acquire() {
+        const uint64_t h = head_.load(std::memory_order_relaxed);
+        while (h - tail_.load(std::memory_order_acquire) >= SLOTS) {
+            if (abandoned_.load(std::memory_order_acquire)) return nullptr;
+            std::this_thread::yield();
+        }
+        return slots_[h % SLOTS].data.data();
+    }
+
+    // 发布刚写好的槽位（count 个元素）
+    void producer_commit(size_t count) {
+        const uint64_t h = head_.load(std::memory_order_relaxed);
+        slots_[h % SLOTS].count = count;
+        head_.store(h + 1, std::memory_order_release);
+    }
+
+    // 不再有新数据；ok=false 表示数据不完整（网络错误等）
+    void close(bool ok) {
+        ok_.store(ok, std::memory_order_relaxed);
+        closed_.store(true, std::memory_order_release);
+    }
+
+    // ---- 消费者 ----
+    // 等待下一个已填满的槽位；生产者关闭且已取完时返回 nullptr
+    const T* consumer_acquire(size_t& count) {
+        const uint64_t t = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            if (head_.load(std::memory_order_acquire) > t) {
+                count = slots_[t % SLOTS].count;
+                return slots_[t % SLOTS].data.data();
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                // 关闭前发布的槽位要先取完
+                if (head_.load(std::memory_order_acquire) > t) continue;
+                count = 0;
+                return nullptr;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    // 归还当前槽位
+    void consumer_release() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // 消费者提前退出时调用，避免生产者一直等待空闲槽位
+    void abandon() { abandoned_.store(true, std::memory_order_release); }
+
+    // 生产者关闭时数据是否完整（在 consumer_acquire 返回 nullptr 之后读取）
+    bool ok() const { return ok_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::vector<T> data;
+        size_t count = 0;
+    };
+
+    const size_t cap_;
+    Slot slots_[SLOTS];
+    alignas(64) std::atomic<uint64_t> head_{ 0 };   // 已发布的槽位数（生产者写）
+    alignas(64) std::atomic<uint64_t> tail_{ 0 };   // 已归还的槽位数（消费者写）
+    alignas(64) std::atomic<bool> closed_{ false };
+    std::atomic<bool> ok_{ false };
+    std::atomic<bool> abandoned_{ false };
+};
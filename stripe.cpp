@@ -0,0 +1,89 @@
+﻿/**
+ * @file stripe.cpp
+ * @brief 条带化收发：每条数据连接一个线程，按块号轮流分配
+ */
+#include "stripe.h"
+#include "numa_mem.h"
+#include "wire_codec.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+// 条带第 k 条连接负责的块：k, k + S, k + 2S, ...；fn(off, count) 依次处理，返回 false 时停止
+template <class Fn>
+bool for_each_block(uint64_t n, size_t k, size_t streams, Fn fn) {
+    const uint64_t blocks = (n + STRIPE_BLOCK - 1) / STRIPE_BLOCK;
+    for (uint64_t j = k; j < blocks; j += streams) {
+        const uint64_t off = j * STRIPE_BLOCK;
+        const size_t count = (size_t)(n - off < STRIPE_BLOCK ? n - off : STRIPE_BLOCK);
+        if (!fn(off, count)) return false;
+    }
+    return true;
+}
+
+// 每条连接一个线程（第 0 条由调用线程处理），全部成功时返回 true
+// 某条连接出错时中断全部数据连接，其余线程随即返回，不会一直阻塞在收发上
+template <class Fn>
+bool run_streams(const std::vector<SOCKET>& socks, Fn fn) {
+    std::atomic<bool> ok{ true };
+    auto one = [&](size_t k) {
+        if (fn(k)) return;
+        if (ok.exchange(false)) {
+            for (SOCKET s : socks) abort_sock(s);
+        }
+    };
+    std::vector<std::thread> th;
+    th.reserve(socks.size());
+    for (size_t k = 1; k < socks.size(); ++k) {
+        th.emplace_back([&one, k]() {
+            numa_release_thread();  // 各连接的线程不继承调用线程绑定的单个 CPU
+            one(k);
+        });
+    }
+    one(0);
+    for (auto& t : th) t.join();
+    return ok.load();
+}
+
+} // namespace
+
+bool stripe_send(const std::vector<SOCKET>& socks, const float* p, uint64_t n, bool codec) {
+    if (socks.empty()) return false;
+    return run_streams(socks, [&](size_t k) {
+        const SOCKET s = socks[k];
+        if (!codec) {
+            // 原始数据：本连接的全部块组成一个分段列表，一次大块发送（Linux 上可零拷贝）
+            std::vector<NetBuf> wb;
+            for_each_block(n, k, socks.size(), [&](uint64_t off, size_t count) {
+                wb.push_back({ p + off, count * sizeof(float) });
+                return true;
+            });
+            return wb.empty() || send_bulk(s, wb.data(), wb.size());
+        }
+        std::vector<uint8_t> enc(codec_max_bytes(STRIPE_BLOCK));
+        return for_each_block(n, k, socks.size(), [&](uint64_t off, size_t count) {
+            const size_t b = codec_encode(p + off, count, enc.data());
+            CodecFrameHeader cf{ b < count * sizeof(float) ? (uint32_t)b : 0 };
+            const NetBuf fb[2] = { { &cf, sizeof(cf) },
+                cf.bytes ? NetBuf{ enc.data(), b } : NetBuf{ p + off, count * sizeof(float) } };
+            return send_iov(s, fb, 2);
+        });
+    });
+}
+
+bool stripe_recv(const std::vector<SOCKET>& socks, float* dst, uint64_t n, bool codec) {
+    if (socks.empty()) return false;
+    return run_streams(socks, [&](size_t k) {
+        const SOCKET s = socks[k];
+        std::vector<uint8_t> scratch(codec ? codec_max_bytes(STRIPE_BLOCK) : 0);
+        return for_each_block(n, k, socks.size(), [&](uint64_t off, size_t count) {
+            if (!codec) return recv_all(s, dst + off, count * sizeof(float));
+            CodecFrameHeader cf{};
+            if (!recv_all(s, &cf, sizeof(cf)) || cf.bytes > codec_max_bytes(count)) return false;
+            if (cf.bytes == 0) return recv_all(s, dst + off, count * sizeof(float));
+            return recv_all(s, scratch.data(), cf.bytes) && codec_decode(scratch.data(), cf.bytes, count, dst + off);
+        });
+    });
+}
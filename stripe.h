@@ -0,0 +1,28 @@
+﻿/**
+ * @file stripe.h
+ * @brief 多条 TCP 数据连接上的条带化大块传输
+ * * 高带宽、高时延链路上单条 TCP 流受拥塞窗口限制跑不满带宽，接收端也只有一个核在处理。
+ * 协商了 FEATURE_STRIPE 的连接在 HELLO 之后额外建立若干条数据连接（每条先发 StreamHello 标明序号），
+ * 控制消息（请求头、样本、分割点、结果头）仍走主连接，只有大块结果走数据连接：
+ * 结果按 STRIPE_BLOCK 个 float 分块，第 j 块走第 j % streams 条连接，每条连接由独立线程收发，
+ * 接收线程把块直接写入（协商了压缩时解码到）目标数组的 j * STRIPE_BLOCK 处，不需要重排。
+ * 压缩时每块为 CodecFrameHeader + 编码数据（bytes 为 0 时为原始 float），否则为原始 float。
+ */
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "common.h"
+#include "net.h"
+
+// 条带块大小（float 个数），与 SORT 分帧一致
+#define STRIPE_BLOCK SORT_CHUNK
+// worker 最多接受的数据连接数
+#define STRIPE_MAX_STREAMS 16
+
+static constexpr uint32_t STRIPE_STREAMS = 4;   // TODO：master 请求的数据连接数，小于 2 时不建立数据连接
+
+// 把 p[0, n) 条带化发到 socks 上；codec 为 true 时各块先编码（由各连接的发送线程完成）
+bool stripe_send(const std::vector<SOCKET>& socks, const float* p, uint64_t n, bool codec);
+
+// 从 socks 上接收 stripe_send 发出的 n 个 float 到 dst；任一连接出错或数据格式不符时返回 false
+bool stripe_recv(const std::vector<SOCKET>& socks, float* dst, uint64_t n, bool codec);
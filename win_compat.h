@@ -0,0 +1,28 @@
+﻿/**
+ * @file win_compat.h
+ * @brief 非 Windows 平台上的 Win32 计时接口替代
+ * * master/worker 用 QueryPerformanceCounter 计时。Linux 节点上不引入 windows.h，
+ * 而由本文件提供同名的 LARGE_INTEGER / QueryPerformanceCounter / QueryPerformanceFrequency，
+ * 底层为 CLOCK_MONOTONIC（纳秒），因此计时代码两个平台完全相同。
+ */
+#pragma once
+#if !defined(_WIN32)
+#include <cstdint>
+#include <ctime>
+
+union LARGE_INTEGER {
+    int64_t QuadPart;
+};
+
+static inline bool QueryPerformanceCounter(LARGE_INTEGER* t) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    t->QuadPart = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    return true;
+}
+
+static inline bool QueryPerformanceFrequency(LARGE_INTEGER* f) {
+    f->QuadPart = 1000000000LL;
+    return true;
+}
+#endif
@@ -0,0 +1,277 @@
+﻿/**
+ * @file wire_codec.cpp
+ * @brief 有序 float 压缩传输格式的编码/解码
+ * * SSE2 可用时（x64 默认可用）打包、解包、zigzag 与前缀和都按 4 通道向量执行，否则走逐通道的标量实现；
+ * 两种实现产生的字节流完全相同，可以互相解码。
+ */
+#include "wire_codec.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WIRE_CODEC_SSE2 1
+#endif
+
+namespace {
+
+inline uint32_t load_bits(const float* p) {
+    uint32_t u;
+    std::memcpy(&u, p, sizeof(u));
+    return u;
+}
+
+inline uint32_t zigzag(uint32_t d) {
+    return (d << 1) ^ (uint32_t)((int32_t)d >> 31);
+}
+
+inline uint32_t unzigzag(uint32_t z) {
+    return (z >> 1) ^ (0u - (z & 1u));
+}
+
+// 块内最大值需要的位数（0..32）
+inline int bit_width(uint32_t v) {
+    int b = 0;
+    while (v) {
+        ++b;
+        v >>= 1;
+    }
+    return b;
+}
+
+// 块宽合法且总长度与 bytes 一致时返回 true
+bool check_widths(const uint8_t* widths, size_t blocks, size_t packed) {
+    size_t need = 0;
+    for (size_t k = 0; k < blocks; ++k) {
+        if (widths[k] > 32) return false;
+        need += (size_t)widths[k] * 16;
+    }
+    return need == packed;
+}
+
+#if defined(WIRE_CODEC_SSE2)
+
+// 一整块的差分 + zigzag，返回各值按位或的结果；prev 为上一个元素的位模式
+inline uint32_t delta_block(const float* in, uint32_t& prev, uint32_t* d) {
+    __m128i last = _mm_set1_epi32((int)prev);
+    __m128i any = _mm_setzero_si128();
+    for (int r = 0; r < CODEC_BLOCK / 4; ++r) {
+        const __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * r));
+        const __m128i prv = _mm_or_si128(_mm_slli_si128(cur, 4), _mm_srli_si128(last, 12));
+        const __m128i dd = _mm_sub_epi32(cur, prv);
+        const __m128i z = _mm_xor_si128(_mm_slli_epi32(dd, 1), _mm_srai_epi32(dd, 31));
+        _mm_store_si128(reinterpret_cast<__m128i*>(d + 4 * r), z);
+        any = _mm_or_si128(any, z);
+        last = cur;
+    }
+    any = _mm_or_si128(any, _mm_srli_si128(any, 8));
+    any = _mm_or_si128(any, _mm_srli_si128(any, 4));
+    prev = (uint32_t)_mm_cvtsi128_si32(_mm_shuffle_epi32(last, 0xFF));
+    return (uint32_t)_mm_cvtsi128_si32(any);
+}
+
+// 32 行、每行 4 个 b 位的值纵向打包，每凑满 32 位输出一行（16 字节）
+uint8_t* pack_block(const uint32_t* d, int b, uint8_t* o) {
+    if (b == 0) return o;
+    __m128i acc = _mm_setzero_si128();
+    int fill = 0;
+    for (int r = 0; r < CODEC_BLOCK / 4; ++r) {
+        const __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(d + 4 * r));
+        acc = _mm_or_si128(acc, _mm_sll_epi32(v, _mm_cvtsi32_si128(fill)));
+        fill += b;
+        if (fill >= 32) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o), acc);
+            o += 16;
+            fill -= 32;
+            acc = fill ? _mm_srl_epi32(v, _mm_cvtsi32_si128(b - fill)) : _mm_setzero_si128();
+        }
+    }
+    return o;
+}
+
+// 解包 + zigzag 还原 + 前缀和，一次写出 CODEC_BLOCK 个位模式；carry 为上一个元素（4 通道广播）
+const uint8_t* decode_block(const uint8_t* o, int b, __m128i& carry, uint32_t* dst) {
+    if (b == 0) {
+        for (int r = 0; r < CODEC_BLOCK / 4; ++r) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * r), carry);
+        }
+        return o;
+    }
+    const __m128i mask = _mm_set1_epi32(b == 32 ? -1 : (int)((1u << b) - 1));
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(o));
+    o += 16;
+    int fill = 0;
+    for (int r = 0; r < CODEC_BLOCK / 4; ++r) {
+        __m128i v = _mm_srl_epi32(acc, _mm_cvtsi32_si128(fill));
+        if (fill + b > 32) {
+            const __m128i nxt = _mm_loadu_si128(reinterpret_cast<const __m128i*>(o));
+            o += 16;
+            v = _mm_or_si128(v, _mm_sll_epi32(nxt, _mm_cvtsi32_si128(32 - fill)));
+            acc = nxt;
+            fill += b - 32;
+        }
+        else if (fill + b == 32) {
+            fill = 0;
+            if (r + 1 < CODEC_BLOCK / 4) {
+                acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(o));
+                o += 16;
+            }
+        }
+        else {
+            fill += b;
+        }
+        v = _mm_and_si128(v, mask);
+        __m128i x = _mm_xor_si128(_mm_srli_epi32(v, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(v, one)));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        carry = _mm_shuffle_epi32(x, 0xFF);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * r), x);
+    }
+    return o;
+}
+
+#else
+
+inline uint32_t delta_block(const float* in, uint32_t& prev, uint32_t* d) {
+    uint32_t any = 0;
+    for (int j = 0; j < CODEC_BLOCK; ++j) {
+        const uint32_t cur = load_bits(in + j);
+        d[j] = zigzag(cur - prev);
+        any |= d[j];
+        prev = cur;
+    }
+    return any;
+}
+
+inline void put_u32(uint8_t* o, uint32_t v) {
+    std::memcpy(o, &v, sizeof(v));
+}
+
+inline uint32_t get_u32(const uint8_t* o) {
+    uint32_t v;
+    std::memcpy(&v, o, sizeof(v));
+    return v;
+}
+
+// 与 SSE2 版本相同的纵向布局：通道 j 的第 k 个输出字位于 o + 16k + 4j
+uint8_t* pack_block(const uint32_t* d, int b, uint8_t* o) {
+    if (b == 0) return o;
+    for (int j = 0; j < 4; ++j) {
+        uint32_t acc = 0;
+        int fill = 0, k = 0;
+        for (int r = 0; r < CODEC_BLOCK / 4; ++r) {
+            const uint32_t v = d[4 * r + j];
+            acc |= v << fill;
+            fill += b;
+            if (fill >= 32) {
+                put_u32(o + 16 * k + 4 * j, acc);
+                ++k;
+                fill -= 32;
+                acc = fill ? v >> (b - fill) : 0;
+            }
+        }
+    }
+    return o + 16 * b;
+}
+
+const uint8_t* decode_block(const uint8_t* o, int b, uint32_t& carry, uint32_t* dst) {
+    uint32_t d[CODEC_BLOCK] = {};
+    if (b != 0) {
+        const uint32_t mask = b == 32 ? ~0u : ((1u << b) - 1);
+        for (int j = 0; j < 4; ++j) {
+            int k = 0, fill = 0;
+            uint32_t acc = get_u32(o + 4 * j);
+            for (int r = 0; r < CODEC_BLOCK / 4; ++r) {
+                uint32_t v = acc >> fill;
+                if (fill + b > 32) {
+                    const uint32_t nxt = get_u32(o + 16 * ++k + 4 * j);
+                    v |= nxt << (32 - fill);
+                    acc = nxt;
+                    fill += b - 32;
+                }
+                else if (fill + b == 32) {
+                    fill = 0;
+                    if (r + 1 < CODEC_BLOCK / 4) acc = get_u32(o + 16 * ++k + 4 * j);
+                }
+                else {
+                    fill += b;
+                }
+                d[4 * r + j] = v & mask;
+            }
+        }
+    }
+    for (int j = 0; j < CODEC_BLOCK; ++j) {
+        carry += unzigzag(d[j]);
+        std::memcpy(dst + j, &carry, sizeof(carry));
+    }
+    return o + 16 * b;
+}
+
+#endif
+
+} // namespace
+
+size_t codec_encode(const float* in, size_t n, uint8_t* out) {
+    if (n == 0) return 0;
+    const size_t blocks = (n + CODEC_BLOCK - 1) / CODEC_BLOCK;
+    uint32_t prev = load_bits(in);
+    std::memcpy(out, &prev, sizeof(prev));
+    uint8_t* widths = out + sizeof(uint32_t);
+    uint8_t* o = widths + blocks;
+    alignas(16) uint32_t d[CODEC_BLOCK];
+    for (size_t k = 0; k < blocks; ++k) {
+        const size_t i = k * CODEC_BLOCK;
+        uint32_t any = 0;
+        if (n - i >= CODEC_BLOCK) {
+            any = delta_block(in + i, prev, d);
+        }
+        else {
+            // 末块：不足部分补 0（解码时重复最后一个值，随后被截断）
+            for (size_t j = 0; j < CODEC_BLOCK; ++j) {
+                d[j] = 0;
+                if (i + j < n) {
+                    const uint32_t cur = load_bits(in + i + j);
+                    d[j] = zigzag(cur - prev);
+                    any |= d[j];
+                    prev = cur;
+                }
+            }
+        }
+        const int b = bit_width(any);
+        widths[k] = (uint8_t)b;
+        o = pack_block(d, b, o);
+    }
+    return (size_t)(o - out);
+}
+
+bool codec_decode(const uint8_t* in, size_t bytes, size_t n, float* out) {
+    if (n == 0) return bytes == 0;
+    const size_t blocks = (n + CODEC_BLOCK - 1) / CODEC_BLOCK;
+    if (bytes < sizeof(uint32_t) + blocks) return false;
+    const uint8_t* widths = in + sizeof(uint32_t);
+    if (!check_widths(widths, blocks, bytes - sizeof(uint32_t) - blocks)) return false;
+
+    uint32_t base;
+    std::memcpy(&base, in, sizeof(base));
+    const uint8_t* o = widths + blocks;
+    uint32_t* dst = reinterpret_cast<uint32_t*>(out);  // 只按字节写出位模式，不经过 float 运算
+    uint32_t tail[CODEC_BLOCK];
+#if defined(WIRE_CODEC_SSE2)
+    __m128i carry = _mm_set1_epi32((int)base);
+#else
+    uint32_t carry = base;
+#endif
+    for (size_t k = 0; k < blocks; ++k) {
+        const size_t i = k * CODEC_BLOCK;
+        if (n - i >= CODEC_BLOCK) {
+            o = decode_block(o, widths[k], carry, dst + i);
+        }
+        else {
+            o = decode_block(o, widths[k], carry, tail);
+            std::memcpy(dst + i, tail, (n - i) * sizeof(uint32_t));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+﻿/**
+ * @file wire_codec.h
+ * @brief 有序 float 结果的压缩传输格式（差分 + 分块定宽位打包）
+ * * SORT/SORT_SPLIT 回传的是有序数据，相邻元素的位模式非常接近。编码对每帧做：
+ * 1. 差分：d[i] = bits[i] - bits[i-1]（uint32 回绕），zigzag 映射为无符号数，
+ *    因此负数段（位模式随值增大而减小）与 -0/+0 交替等情况同样无损；
+ * 2. 分块定宽位打包（frame-of-reference）：每 CODEC_BLOCK 个差分为一块，块宽 b 取块内最大值的位数，
+ *    按 4 个 32 位通道纵向排列（第 j 个值属于通道 j % 4），每块恰好 16 * b 字节，SSE2 一次处理 4 个值。
+ * 解码为编码的逆过程：向量化解包、zigzag 还原后做 4 通道前缀和，逐位还原原始 float。
+ * 编码后的帧布局：[uint32 首元素位模式][每块 1 字节块宽][各块打包数据]，末块不足 CODEC_BLOCK 时以 0 补齐。
+ * 是否启用由连接建立时的 Op::HELLO 协商（见 common.h），对端不支持时退回原始 float。
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// 每块的差分个数（4 通道 x 32 行）
+#define CODEC_BLOCK 128
+
+static constexpr bool USE_SORT_CODEC = true;   // TODO：是否在握手时请求/接受压缩传输，关闭后两端都发送原始 float
+
+// n 个 float 编码后最多占用的字节数
+static inline size_t codec_max_bytes(size_t n) {
+    const size_t blocks = (n + CODEC_BLOCK - 1) / CODEC_BLOCK;
+    return sizeof(uint32_t) + blocks + blocks * CODEC_BLOCK * sizeof(uint32_t);
+}
+
+// 编码 in[0, n)，out 至少 codec_max_bytes(n) 字节；返回编码后的字节数（n 为 0 时返回 0）
+size_t codec_encode(const float* in, size_t n, uint8_t* out);
+
+// 把 bytes 字节的编码数据解码为 n 个 float；数据格式不符（块宽越界、长度不一致）时返回 false
+bool codec_decode(const uint8_t* in, size_t bytes, size_t n, float* out);
@@ -2,14 +2,31 @@
 #include "net.h"
 #include "cpu_ops.h"
 #include "cpu_sort.h"
+#include "ext_sort.h"
+#include "numa_mem.h"
+#include "shm_transport.h"
+#include "stripe.h"
+#include "wire_codec.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 #include <iostream>
 
 #include <exception>
+#if defined(_WIN32)
 #ifndef NOMINMAX
 #define NOMINMAX
 #endif
 #include <windows.h>
+#else
+#include "win_compat.h"
+#endif
 /**
  * @file worker.cpp
  * @brief 从节点 (Worker) 入口程序
@@ -23,11 +40,20 @@
 
 
 // 生成 [begin, end) 的递增数据（元素值为 begin+1 起步），便于 master/worker 双端保持一致
-static void init_local(std::vector<float>& data, uint64_t begin, uint64_t end) {
+// 并行首次写入（切块同 omp_static_range），使每个 NUMA 节点上的线程处理的数据位于本节点内存
+static void init_local(FirstTouchVec& data, uint64_t begin, uint64_t end) {
     uint64_t n = end - begin;
     data.resize((size_t)n);
-    for (uint64_t i = 0; i < n; ++i) {
-        data[(size_t)i] = (float)(begin + i + 1);
+    float* p = data.data();
+#if defined(USE_OPENMP)
+#pragma omp parallel
+#endif
+    {
+        uint64_t b, e;
+        omp_static_range(n, b, e);
+        for (uint64_t i = b; i < e; ++i) {
+            p[i] = (float)(begin + i + 1);
+        }
     }
 }
 
@@ -38,14 +64,89 @@ static void print_build_features() {
 #else
     std::cout << " OpenMP=OFF";
 #endif
-#if defined(USE_SSE)
-    std::cout << " SSE=ON";
-#else
-    std::cout << " SSE=OFF";
-#endif
+    std::cout << " SIMD=" << isa_name(cpu_kernels().isa);
     std::cout << "\n";
 }
 
+// 一次分帧发送用到的帧头与编码缓冲，需存活到 send_bulk 返回
+struct SortFrames {
+    std::vector<SortChunkHeader> fh;
+    std::vector<CodecFrameHeader> ch;
+    std::vector<uint8_t, FirstTouchAllocator<uint8_t>> enc;
+};
+
+// 把有序结果 p[0, n) 按 SORT_CHUNK 分帧追加到发送列表（不含结束帧）
+// codec 为 true 时各帧互不依赖，par 为 true 时 OpenMP 并行编码；编码后不比原始数据小的帧仍发送原始 float
+static void append_sort_frames(const float* p, uint64_t n, bool codec, bool par, SortFrames& sf, std::vector<NetBuf>& wb) {
+    const int frames = (int)((n + SORT_CHUNK - 1) / SORT_CHUNK);
+    const size_t slot = codec_max_bytes(SORT_CHUNK);
+    sf.fh.assign((size_t)frames, SortChunkHeader{ 0 });
+    sf.ch.assign((size_t)frames, CodecFrameHeader{ 0 });
+    for (int f = 0; f < frames; ++f) {
+        const uint64_t off = (uint64_t)f * SORT_CHUNK;
+        sf.fh[f].count = (uint32_t)(n - off < SORT_CHUNK ? n - off : SORT_CHUNK);
+    }
+    if (codec) {
+        sf.enc.resize((size_t)frames * slot);
+#if defined(USE_OPENMP)
+#pragma omp parallel for schedule(dynamic) if(par)
+#endif
+        for (int f = 0; f < frames; ++f) {
+            const size_t raw = sf.fh[f].count * sizeof(float);
+            const size_t b = codec_encode(p + (uint64_t)f * SORT_CHUNK, sf.fh[f].count, sf.enc.data() + (size_t)f * slot);
+            sf.ch[f].bytes = b < raw ? (uint32_t)b : 0;
+        }
+    }
+    wb.reserve(wb.size() + (size_t)frames * 3 + 1);
+    for (int f = 0; f < frames; ++f) {
+        const float* data = p + (uint64_t)f * SORT_CHUNK;
+        wb.push_back({ &sf.fh[f], sizeof(SortChunkHeader) });
+        if (codec) wb.push_back({ &sf.ch[f], sizeof(CodecFrameHeader) });
+        if (codec && sf.ch[f].bytes) wb.push_back({ sf.enc.data() + (size_t)f * slot, sf.ch[f].bytes });
+        else wb.push_back({ data, sf.fh[f].count * sizeof(float) });
+    }
+}
+
+// 协商了 FEATURE_SHM 时为 n 个 float 的结果创建共享内存区域；创建失败时返回空，结果退回 TCP 发送
+static std::unique_ptr<ShmRegion> make_shm(uint32_t features, uint64_t n) {
+    if (!(features & FEATURE_SHM)) return nullptr;
+    std::unique_ptr<ShmRegion> r(new ShmRegion);
+    if (!r->create(n)) {
+        std::cerr << "[Worker] shm create failed, fallback to tcp\n";
+        return nullptr;
+    }
+    return r;
+}
+
+// FEATURE_SHM 连接上结果应答的第一条消息；r 为空时区域名为空，表示结果随后仍走主连接
+static bool send_shm_notice(SOCKET c, const ShmRegion* r) {
+    ShmNotice sn{};
+    if (r) {
+        std::snprintf(sn.name, sizeof(sn.name), "%s", r->name());
+        sn.count = r->size();
+    }
+    return send_all(c, &sn, sizeof(sn));
+}
+
+// k 路归并的输出：每块直接作为一帧发出（外部排序与树形汇聚的 SORT 共用）
+struct FrameSink final : MergeSink {
+    SOCKET c;
+    std::vector<uint8_t> enc;       // 非空表示本连接使用压缩格式
+    FrameSink(SOCKET s, bool codec) : c(s), enc(codec ? codec_max_bytes(EXT_MERGE_BLOCK) : 0) {}
+    bool consume(const float* raw, size_t n) override {
+        SortChunkHeader ch{ (uint32_t)n };
+        if (enc.empty()) {
+            const NetBuf fb[2] = { { &ch, sizeof(ch) }, { raw, n * sizeof(float) } };
+            return send_iov(c, fb, 2);     // 归并缓冲区随即被复用，不能零拷贝
+        }
+        const size_t b = codec_encode(raw, n, enc.data());
+        CodecFrameHeader cf{ b < n * sizeof(float) ? (uint32_t)b : 0 };
+        const NetBuf fb[3] = { { &ch, sizeof(ch) }, { &cf, sizeof(cf) },
+            cf.bytes ? NetBuf{ enc.data(), b } : NetBuf{ raw, n * sizeof(float) } };
+        return send_iov(c, fb, 3);
+    }
+};
+
 // 获取 QueryPerformanceCounter 的倒频率（ms）
 static double freqInvMs() {
     static double v = [] {
@@ -56,18 +157,314 @@ static double freqInvMs() {
     return v;
 }
 
-int main() {
+// ========== 树形汇聚（Op::TREE，见 common.h 与 cluster.h）==========
+// 本 worker 作为中间节点：把请求转发给孩子，计算自己的区间，合并孩子的结果后向上应答。
+// 孩子连不上或中途失败时由本节点补算它的整棵子树；向上的应答已经开始发送后出错则断开连接，由上游补算
+
+// 到孩子的连接，按地址复用；孩子连接上不发 HELLO，应答都是原始格式
+class TreeLinks {
+public:
+    ~TreeLinks() {
+        for (auto& kv : socks_) close_sock(kv.second);
+    }
+    // 连接失败时返回 INVALID_SOCKET
+    SOCKET get(const TreeNode& n) {
+        const std::string key = std::string(n.ip) + ":" + std::to_string(n.port);
+        auto it = socks_.find(key);
+        if (it != socks_.end()) return it->second;
+        try {
+            SOCKET s = tcp_connect(n.ip, n.port);
+            socks_[key] = s;
+            return s;
+        }
+        catch (const std::exception& ex) {
+            std::cerr << "[Worker] child " << key << " unavailable: " << ex.what() << "\n";
+            return INVALID_SOCKET;
+        }
+    }
+    void drop(SOCKET s) {
+        for (auto it = socks_.begin(); it != socks_.end(); ++it) {
+            if (it->second != s) continue;
+            close_sock(s);
+            socks_.erase(it);
+            return;
+        }
+    }
+
+private:
+    std::map<std::string, SOCKET> socks_;
+};
+
+// 一个孩子的整棵子树：nodes[i] 为孩子本身，子树区间 [b, e)；s 为已下发请求的连接，INVALID_SOCKET 表示由本节点补算
+struct TreeChild {
+    size_t i;
+    uint64_t b, e;
+    SOCKET s;
+};
+
+// 按 TreeNode 的先序排列找出各孩子，并把请求转发下去（孩子没有后代时直接发实际的 Op）
+static std::vector<TreeChild> tree_forward(TreeLinks& links, const std::vector<TreeNode>& nodes, Op op) {
+    std::vector<TreeChild> kids;
+    for (size_t i = 0; i < nodes.size(); i += nodes[i].subtree) {
+        const TreeNode& n = nodes[i];
+        TreeChild k{ i, n.begin, nodes[i + n.subtree - 1].end, INVALID_SOCKET };
+        if (k.b < k.e) k.s = links.get(n);
+        if (k.s != INVALID_SOCKET) {
+            bool ok;
+            if (n.subtree == 1) {
+                MsgHeader h{ MAGIC, (uint32_t)op, k.e - k.b, k.b, k.e };
+                ok = send_all(k.s, &h, sizeof(h));
+            }
+            else {
+                MsgHeader h{ MAGIC, (uint32_t)Op::TREE, (uint64_t)op, n.begin, n.end };
+                TreeHeader th{ n.subtree - 1 };
+                const NetBuf tb[3] = { { &h, sizeof(h) }, { &th, sizeof(th) }, { &nodes[i + 1], (n.subtree - 1) * sizeof(TreeNode) } };
+                ok = send_iov(k.s, tb, 3);
+            }
+            if (!ok) {
+                links.drop(k.s);
+                k.s = INVALID_SOCKET;
+            }
+        }
+        kids.push_back(k);
+    }
+    return kids;
+}
+
+// 各 Op 在 [b, e) 上的部分结果（数据由生成器融合计算），以及两个部分结果的合并
+static WorkerSumResult tree_sum_part(const RangeGenerator& gen, uint64_t b, uint64_t e) {
+    WorkerSumResult r{};
+    r.det = (SUM_ENGINE == SumEngine::DET_OMP) ? 1u : 0u;
+    if (b >= e) return r;
+    if (r.det) {
+        const DetSum d = cpu_sum_log_sqrt_det_gen(gen, b, e);
+        r.value = (float)det_value(d);
+        r.det_fixed = d.fixed;
+        r.det_special = d.special;
+    }
+    else r.value = cpu_sum_log_sqrt_gen(SUM_ENGINE, gen, b, e);
+    return r;
+}
+
+static void tree_combine(WorkerSumResult& a, const WorkerSumResult& b) {
+    const DetSum d = det_combine(DetSum{ a.det_fixed, a.det_special }, DetSum{ b.det_fixed, b.det_special });
+    a.det = a.det && b.det;
+    a.value = a.det ? (float)det_value(d) : a.value + b.value;
+    a.det_fixed = d.fixed;
+    a.det_special = d.special;
+}
+
+static WorkerScalarResult tree_max_part(const RangeGenerator& gen, uint64_t b, uint64_t e) {
+    return WorkerScalarResult{ b < e ? cpu_max_transformed_gen<LogSqrtTransform>(gen, b, e) : -INFINITY, 0.0 };
+}
+
+static void tree_combine(WorkerScalarResult& a, const WorkerScalarResult& b) {
+    if (b.value > a.value) a.value = b.value;
+}
+
+static WorkerStatsResult tree_stats_part(const RangeGenerator& gen, uint64_t b, uint64_t e) {
+    StatsResult v = stats_identity();
+    if (b < e) {
+        v = cpu_stats_log_sqrt_gen(gen, b, e);
+        stats_offset(v, b);
+    }
+    return WorkerStatsResult{ v.count, v.sum, v.m2, v.min, v.max, v.argmax, 0.0 };
+}
+
+static void tree_combine(WorkerStatsResult& a, const WorkerStatsResult& b) {
+    const StatsResult v = StatsReducer::combine(StatsResult{ a.count, a.sum, a.m2, a.min, a.max, a.argmax },
+        StatsResult{ b.count, b.sum, b.m2, b.min, b.max, b.argmax });
+    a = WorkerStatsResult{ v.count, v.sum, v.m2, v.min, v.max, v.argmax, 0.0 };
+}
+
+// SUM/MAX/STATS：先转发，再算自己的区间，最后逐个收孩子的结果合并，向上只发一个结果；
+// compute_ms 为本节点从收到请求到合并完成的耗时（含整棵子树）
+template <class R, class PartFn>
+static bool tree_scalar(SOCKET up, const MsgHeader& h, const std::vector<TreeNode>& nodes, TreeLinks& links, PartFn part) {
+    LARGE_INTEGER st, ed;
+    QueryPerformanceCounter(&st);
+    const RangeGenerator& gen = default_generator();
+    std::vector<TreeChild> kids = tree_forward(links, nodes, (Op)h.len);
+    R out = part(gen, h.begin, h.end);
+    for (const TreeChild& k : kids) {
+        R r{};
+        if (k.s == INVALID_SOCKET || !recv_all(k.s, &r, sizeof(r))) {
+            if (k.s != INVALID_SOCKET) links.drop(k.s);
+            r = part(gen, k.b, k.e);
+        }
+        tree_combine(out, r);
+    }
+    QueryPerformanceCounter(&ed);
+    out.compute_ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
+    return send_all(up, &out, sizeof(out));
+}
+
+// 孩子的 SORT 结果流（原始帧格式）作为 k 路归并的一路输入；收完结束帧且总数正确时 ok()
+struct ChildSortSource final : SortedSource {
+    SOCKET s;
+    uint64_t left;
+    bool started = false;
+    bool done = false;
+    bool failed = false;
+    std::vector<float> buf;
+    ChildSortSource(SOCKET c, uint64_t n) : s(c), left(n), buf(SORT_CHUNK) {}
+    const float* next_block(size_t& n) override {
+        if (done || failed) return nullptr;
+        if (!started) {
+            WorkerSortHeader wh{};
+            started = true;
+            if (!recv_all(s, &wh, sizeof(wh)) || wh.bytes != left * sizeof(float)) {
+                failed = true;
+                return nullptr;
+            }
+        }
+        SortChunkHeader ch{};
+        if (!recv_all(s, &ch, sizeof(ch)) || ch.count > SORT_CHUNK || ch.count > left) {
+            failed = true;
+            return nullptr;
+        }
+        if (ch.count == 0) {
+            done = true;
+            failed = (left != 0);
+            return nullptr;
+        }
+        if (!recv_all(s, buf.data(), ch.count * sizeof(float))) {
+            failed = true;
+            return nullptr;
+        }
+        left -= ch.count;
+        n = ch.count;
+        return buf.data();
+    }
+    bool ok() const { return done && !failed; }
+};
+
+// SORT：先转发，再排序自己的区间（以及连不上的孩子的子树），与各孩子的有序流做一次 k 路归并，
+// 每块直接作为一帧向上发送，上游收到的是整棵子树的一条有序流
+static bool tree_sort(SOCKET up, uint32_t features, const MsgHeader& h, const std::vector<TreeNode>& nodes, TreeLinks& links) {
+    LARGE_INTEGER st, ed;
+    QueryPerformanceCounter(&st);
+    const RangeGenerator& gen = default_generator();
+    std::vector<TreeChild> kids = tree_forward(links, nodes, Op::SORT);
+    std::vector<std::pair<uint64_t, uint64_t>> mine{ { h.begin, h.end } };
+    for (const TreeChild& k : kids) {
+        if (k.s == INVALID_SOCKET && k.b < k.e) mine.push_back({ k.b, k.e });
+    }
+    uint64_t localN = 0;
+    for (const auto& r : mine) localN += r.second - r.first;
+
+    // 本节点负责的元素：超出内存预算时落盘为顺串（见 ext_sort.h），否则生成后打乱、排序
+    std::vector<std::unique_ptr<ExtRunSet>> runs;
+    std::vector<std::unique_ptr<SortedSource>> src;
+    bool ext = ext_sort_wanted(localN);
+    for (size_t i = 0; ext && i < mine.size(); ++i) {
+        if (mine[i].first >= mine[i].second) continue;
+        runs.emplace_back(new ExtRunSet(("tree" + std::to_string(i)).c_str()));
+        ext = runs.back()->build(gen, mine[i].first, mine[i].second, 0xBADC0FFEEULL ^ mine[i].first) && runs.back()->open(src);
+    }
+    FirstTouchVec local;
+    if (!ext) {
+        src.clear();
+        runs.clear();
+        local.resize((size_t)localN);
+        uint64_t off = 0;
+        for (const auto& r : mine) {
+            float* p = local.data() + off;
+#if defined(USE_OPENMP)
+#pragma omp parallel
+#endif
+            {
+                uint64_t b, e;
+                omp_static_range(r.second - r.first, b, e);
+                if (b < e) gen.fill(p + b, r.first + b, e - b);
+            }
+            off += r.second - r.first;
+        }
+        shuffle_fisher_yates(local.data(), localN, 0xBADC0FFEEULL ^ h.begin);
+        sort_with_engine<LogSqrtTransform>(SORT_ENGINE, local.data(), (int64_t)localN);    //TODO：排序引擎由 cpu_sort.h 中的 SORT_ENGINE 决定
+        src.emplace_back(new ArraySource(local.data(), localN));
+    }
+    QueryPerformanceCounter(&ed);
+    const uint64_t total = (nodes.empty() ? h.end : nodes.back().end) - h.begin;
+    WorkerSortHeader wh{ total * sizeof(float), (ed.QuadPart - st.QuadPart) * freqInvMs() };
+    if ((features & FEATURE_SHM) && !send_shm_notice(up, nullptr)) return false;   // 树形汇聚的结果不放进共享内存
+    if (!send_all(up, &wh, sizeof(wh))) return false;
+
+    std::vector<ChildSortSource*> streams;
+    for (const TreeChild& k : kids) {
+        if (k.s == INVALID_SOCKET) continue;
+        streams.push_back(new ChildSortSource(k.s, k.e - k.b));
+        src.emplace_back(streams.back());
+    }
+    FrameSink sink(up, (features & FEATURE_SORT_CODEC) != 0);
+    const uint64_t sent = ext_merge(src, sink);
+    bool ok = (sent == total);
+    for (ChildSortSource* cs : streams) {
+        if (cs->ok()) continue;
+        links.drop(cs->s);
+        ok = false;
+    }
+    SortChunkHeader endf{ 0 };
+    return ok && send_all(up, &endf, sizeof(endf));
+}
+
+// 收 Op::TREE 的后代列表并校验（先序下各节点区间首尾相接，子树大小不越界），按实际的 Op 处理
+static bool serve_tree(SOCKET up, uint32_t features, const MsgHeader& h, TreeLinks& links) {
+    TreeHeader th{};
+    if (!recv_all(up, &th, sizeof(th)) || th.count > TREE_MAX_NODES) return false;
+    std::vector<TreeNode> nodes(th.count);
+    if (th.count && !recv_all(up, nodes.data(), nodes.size() * sizeof(TreeNode))) return false;
+    uint64_t at = h.end;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        nodes[i].ip[TREE_IP_MAX - 1] = 0;
+        if (nodes[i].begin != at || nodes[i].end < nodes[i].begin
+            || nodes[i].subtree == 0 || nodes[i].subtree > nodes.size() - i) return false;
+        at = nodes[i].end;
+    }
+    if (h.end < h.begin) return false;
+    std::cout << "[Worker] tree op=" << h.len << " own=[" << h.begin << ", " << h.end << ") subtree_end=" << at
+        << " descendants=" << nodes.size() << "\n";
+    switch ((Op)h.len) {
+    case Op::SUM: return tree_scalar<WorkerSumResult>(up, h, nodes, links, tree_sum_part);
+    case Op::MAX: return tree_scalar<WorkerScalarResult>(up, h, nodes, links, tree_max_part);
+    case Op::STATS: return tree_scalar<WorkerStatsResult>(up, h, nodes, links, tree_stats_part);
+    case Op::SORT: return tree_sort(up, features, h, nodes, links);
+    default:
+        std::cerr << "[Worker] bad tree op\n";
+        return false;
+    }
+}
+
+int main(int argc, char** argv) {
     try {
         // 初始化 WSA 并启动监听，等待 master 连接
         // worker 只接受一个连接，主循环内串行处理 master 发来的多轮指令
+        // 可选参数为监听端口（Worker [port]），同一台机器上可以启动多个 worker 组成集群（见 cluster.h）
+        uint16_t port = PORT;
+        if (argc > 1) {
+            char* end = nullptr;
+            const unsigned long v = std::strtoul(argv[1], &end, 10);
+            if (*end || v == 0 || v > 65535) {
+                std::cerr << "usage: Worker [port]\n";
+                return 1;
+            }
+            port = (uint16_t)v;
+        }
         WsaInit wsa;
         std::cout << "[Worker] BOOT OK\n";
         print_build_features();
+        numa_init();
 
-        SOCKET ls = tcp_listen(PORT);
-        std::cout << "[Worker] Listening on " << PORT << "...\n";
+        SOCKET ls = tcp_listen(port);
+        std::cout << "[Worker] Listening on " << port << "...\n";
         SOCKET c = tcp_accept(ls);
         std::cout << "[Worker] Connected.\n";
+        // 本连接协商到的特性（见 Op::HELLO）；master 未发 HELLO 时全部按原始格式发送
+        uint32_t features = 0;
+        std::vector<SOCKET> streams;    // 协商了 FEATURE_STRIPE 时的数据连接
+        // 上一个结果所在的共享内存区域：master 映射之后才会发下一个请求，因此保留到收到下一个请求头
+        std::unique_ptr<ShmRegion> shm;
+        TreeLinks links;                // 树形汇聚时到孩子的连接
 
         // 循环处理来自 master 的任务
         while (true) {
@@ -95,7 +492,40 @@ int main() {
                 std::cerr << "[Worker] bad magic\n";
                 break;
             }
-            if (h.op != (uint32_t)Op::SUM && h.op != (uint32_t)Op::MAX && h.op != (uint32_t)Op::SORT) {
+            shm.reset();
+            if (h.op == (uint32_t)Op::HELLO) {
+                // 只接受自己也支持的特性
+                HelloReply hr{ (uint32_t)h.len & ((USE_SORT_CODEC ? FEATURE_SORT_CODEC : 0u) | FEATURE_STRIPE
+                    | (USE_SHM_TRANSPORT ? FEATURE_SHM : 0u)), 0 };
+                if (h.begin < 2) hr.features &= ~FEATURE_STRIPE;
+                if (hr.features & FEATURE_STRIPE) hr.streams = (uint32_t)(h.begin < STRIPE_MAX_STREAMS ? h.begin : STRIPE_MAX_STREAMS);
+                if (!send_all(c, &hr, sizeof(hr))) break;
+                features = hr.features;
+                // 接受数据连接，按 StreamHello 中的序号排列
+                streams.assign(hr.streams, INVALID_SOCKET);
+                bool streams_ok = true;
+                for (uint32_t k = 0; k < hr.streams && streams_ok; ++k) {
+                    SOCKET d = tcp_accept(ls);
+                    StreamHello sh{};
+                    streams_ok = recv_all(d, &sh, sizeof(sh)) && sh.magic == MAGIC && sh.index < hr.streams
+                        && streams[sh.index] == INVALID_SOCKET;
+                    if (streams_ok) streams[sh.index] = d;
+                    else close_sock(d);
+                }
+                if (!streams_ok) {
+                    std::cerr << "[Worker] bad data stream\n";
+                    break;
+                }
+                std::cout << "[Worker] hello, features=0x" << std::hex << features << std::dec
+                    << " streams=" << streams.size() << "\n";
+                continue;
+            }
+            if (h.op == (uint32_t)Op::TREE) {
+                if (!serve_tree(c, features, h, links)) break;
+                std::cout << "[Worker] send tree result done\n";
+                continue;
+            }
+            if (h.op != (uint32_t)Op::SUM && h.op != (uint32_t)Op::MAX && h.op != (uint32_t)Op::SORT && h.op != (uint32_t)Op::STATS && h.op != (uint32_t)Op::SORT_SPLIT) {
                 std::cerr << "[Worker] bad op\n";
                 break;
             }
@@ -105,22 +535,45 @@ int main() {
             }
 
             // 按 master 下发的范围生成数据，所有数据均由 worker 自行生成，不依赖网络传输数据块
-            std::vector<float> local;
-            std::cout << "[Worker] init_local...\n";
+            // 生成器融合时 SUM/MAX/STATS 边生成边计算（见 range_gen.h），只有 SORT 需要完整数组；
+            // SORT_SPLIT 直接从生成器中挑选自己键区间内的元素
+            const RangeGenerator& gen = default_generator();
+            // 区间超过 EXT_SORT_MIN 的 SORT 走外部排序（见 ext_sort.h），同样不需要完整数组
+            const bool ext = h.op == (uint32_t)Op::SORT && ext_sort_wanted(h.end - h.begin);
+            const bool fused = ext || h.op == (uint32_t)Op::SORT_SPLIT || (USE_GEN_FUSED && h.op != (uint32_t)Op::SORT);
+            FirstTouchVec local;
             LARGE_INTEGER st, ed;
             QueryPerformanceCounter(&st);
-            init_local(local, h.begin, h.end);
-            std::cout << "[Worker] init_local done, n=" << local.size() << "\n";
+            if (!fused) {
+                std::cout << "[Worker] init_local...\n";
+                init_local(local, h.begin, h.end);
+                std::cout << "[Worker] init_local done, n=" << local.size() << "\n";
+            }
             if (h.op == (uint32_t)Op::SUM) {
                 std::cout << "[Worker] cpu sum...\n";
                 // 本段数据执行 log(sqrt(x)) 后求和，结果发回 master 进行汇总
-                //float part = cpu_sum_log_sqrt(local.data(), (uint64_t)local.size());//
-                //float part = cpu_sum_log_sqrt_sse(local.data(), (uint64_t)local.size());//  
-                float part = cpu_sum_log_sqrt_sse_omp(local.data(), (uint64_t)local.size()); //TODO：可选择无SSE和OpenMP版本或单独启用SSE
+                WorkerSumResult out{};
+                //out.value = cpu_sum_log_sqrt(local.data(), (uint64_t)local.size());//
+                //out.value = cpu_sum_log_sqrt_sse(local.data(), (uint64_t)local.size());//  
+                //out.value = cpu_sum_log_sqrt_sse_omp(local.data(), (uint64_t)local.size());//
+                if (SUM_ENGINE == SumEngine::DET_OMP) {
+                    // 确定性引擎：回传定点部分和，由 master 精确合并
+                    DetSum d = fused ? cpu_sum_log_sqrt_det_gen(gen, h.begin, h.end)
+                        : cpu_sum_log_sqrt_det_omp(local.data(), (uint64_t)local.size());
+                    out.value = (float)det_value(d);
+                    out.det = 1;
+                    out.det_fixed = d.fixed;
+                    out.det_special = d.special;
+                }
+                else if (fused) {
+                    out.value = cpu_sum_log_sqrt_gen(SUM_ENGINE, gen, h.begin, h.end);
+                }
+                else {
+                    out.value = cpu_sum_log_sqrt_engine(SUM_ENGINE, local.data(), (uint64_t)local.size()); //TODO：可选择无SSE和OpenMP版本或单独启用SSE；引擎由 cpu_ops.h 中的 SUM_ENGINE 决定
+                }
                 QueryPerformanceCounter(&ed);
-                double compute_ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
+                out.compute_ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
                 std::cout << "[Worker] cpu sum done\n";
-                WorkerScalarResult out{ part, compute_ms };
                 send_all(c, &out, sizeof(out));
                 std::cout << "[Worker] send sum done\n";
             }
@@ -130,7 +583,9 @@ int main() {
                 // 本段数据执行 log(sqrt(x)) 后取最大，同步给 master
                 //float part = cpu_max_log_sqrt(local.data(), (uint64_t)local.size());//
                 //float part = cpu_max_log_sqrt_sse(local.data(), (uint64_t)local.size());//
-                float part = cpu_max_log_sqrt_sse_omp(local.data(), (uint64_t)local.size());   //TODO：可选择无SSE和OpenMP版本或单独启用SSE
+                //float part = cpu_max_log_sqrt_sse_omp(local.data(), (uint64_t)local.size());//
+                float part = fused ? cpu_max_transformed_gen<LogSqrtTransform>(gen, h.begin, h.end)
+                    : cpu_max_transformed_omp<LogSqrtTransform>(local.data(), (uint64_t)local.size());   //TODO：可选择无SSE和OpenMP版本或单独启用SSE；单调变换下推
                 QueryPerformanceCounter(&ed);
                 double compute_ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
                 std::cout << "[Worker] cpu max done\n";
@@ -138,11 +593,160 @@ int main() {
                 send_all(c, &out, sizeof(out));
                 std::cout << "[Worker] send max done\n";
             }
+            else if (h.op == (uint32_t)Op::STATS) {
+                std::cout << "[Worker] cpu stats...\n";
+                // 一次遍历得到本段的全部统计量，argmax 换算为全局下标
+                StatsResult part = fused ? cpu_stats_log_sqrt_gen(gen, h.begin, h.end)
+                    : cpu_stats_log_sqrt_omp(local.data(), (uint64_t)local.size());
+                stats_offset(part, h.begin);
+                QueryPerformanceCounter(&ed);
+                double compute_ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
+                std::cout << "[Worker] cpu stats done\n";
+                WorkerStatsResult out{ part.count, part.sum, part.m2, part.min, part.max, part.argmax, compute_ms };
+                send_all(c, &out, sizeof(out));
+                std::cout << "[Worker] send stats done\n";
+            }
+            else if (h.op == (uint32_t)Op::SORT_SPLIT) {
+                std::cout << "[Worker] sort split...\n";
+                // 1) 从 [begin, end) 抽样发给 master，样本数按区间占全集 [0, end) 的比例分配
+                WorkerSortSample ws{ (uint32_t)((uint64_t)SORT_SAMPLE * (h.end - h.begin) / h.end) };
+                std::vector<uint32_t> sample(ws.count);
+                sample_codes(gen, h.begin, h.end, ws.count, 0x5A3D1E5ULL ^ h.begin, sample.data());
+                const NetBuf sb[2] = { { &ws, sizeof(ws) }, { sample.data(), ws.count * sizeof(uint32_t) } };
+                if (!send_iov(c, sb, 2)) break;
+
+                // 2) 等待 master 选定的分割点，worker 负责 key code >= splitter 的元素
+                SortSplitter sp{};
+                if (!recv_all(c, &sp, sizeof(sp))) break;
+                QueryPerformanceCounter(&st);   // 计算耗时从收到分割点开始
+                select_by_code(gen, 0, h.end, sp.code, 0x100000000ULL, local);
+                shuffle_fisher_yates(local.data(), (uint64_t)local.size(),
+                    0xBADC0FFEEULL ^ h.begin); // 与 SORT 相同，先打乱再排序
+                sort_with_engine<LogSqrtTransform>(SORT_ENGINE, local.data(), (int64_t)local.size());    //TODO：排序引擎由 cpu_sort.h 中的 SORT_ENGINE 决定
+                // 3) 变换后直接回传，master 收到即是最终结果的尾段；协商了共享内存时直接变换到共享内存区域中
+                shm = make_shm(features, (uint64_t)local.size());
+                transform_log_sqrt_sse_omp(local.data(), shm ? shm->data() : local.data(), (uint64_t)local.size());
+                QueryPerformanceCounter(&ed);
+                double compute_ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
+                std::cout << "[Worker] sort split done, splitter=0x" << std::hex << sp.code << std::dec
+                    << " n=" << local.size() << "\n";
+                uint64_t bytes = (uint64_t)local.size() * sizeof(float);
+                WorkerSortHeader wh{ bytes, compute_ms };
+                if (shm) shm->finish(true, compute_ms);
+                if ((features & FEATURE_SHM) && !send_shm_notice(c, shm.get())) break;
+                // 结果在共享内存中时主连接上只有 ShmNotice；
+                // 协商了数据连接时结果头走主连接，数据条带化走各数据连接（见 stripe.h）；
+                // 否则头部与数据一次发出，数据走大块发送（Linux 上可零拷贝），协商了压缩时按 SORT 的帧格式发送（见 wire_codec.h）
+                if (!shm && !streams.empty()) {
+                    if (!send_all(c, &wh, sizeof(wh))
+                        || !stripe_send(streams, local.data(), (uint64_t)local.size(), (features & FEATURE_SORT_CODEC) != 0)) break;
+                }
+                else if (!shm) {
+                    SortFrames sf;
+                    SortChunkHeader endf{ 0 };
+                    std::vector<NetBuf> wb{ { &wh, sizeof(wh) } };
+                    if (features & FEATURE_SORT_CODEC) {
+                        append_sort_frames(local.data(), (uint64_t)local.size(), true, true, sf, wb);
+                        wb.push_back({ &endf, sizeof(endf) });
+                    }
+                    else wb.push_back({ local.data(), (size_t)bytes });
+                    //const NetBuf wb[2] = { { &wh, sizeof(wh) }, { local.data(), (size_t)bytes } };//
+                    send_bulk(c, wb.data(), wb.size());
+                }
+                std::cout << "[Worker] send sort split done\n";
+            }
+            else if (h.op == (uint32_t)Op::SORT && ext) {
+                std::cout << "[Worker] external sort...\n";
+                // 1) 顺串排序后落盘；compute_ms 只含这一阶段，归并与发送重叠进行
+                ExtRunSet runs("worker");
+                std::vector<std::unique_ptr<SortedSource>> src;
+                if (!runs.build(gen, h.begin, h.end, 0xBADC0FFEEULL ^ h.begin) || !runs.open(src)) break;
+                QueryPerformanceCounter(&ed);
+                double compute_ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
+                std::cout << "[Worker] external sort runs done\n";
+                WorkerSortHeader wh{ (h.end - h.begin) * sizeof(float), compute_ms };
+                if ((features & FEATURE_SHM) && !send_shm_notice(c, nullptr)) break;   // 外部排序的结果不放进共享内存
+                if (!send_all(c, &wh, sizeof(wh))) break;
+
+                // 2) k 路归并，每个输出块直接作为一帧发出
+                FrameSink sink(c, (features & FEATURE_SORT_CODEC) != 0);
+                const uint64_t sent = ext_merge(src, sink);
+                SortChunkHeader endf{ 0 };
+                if (sent != h.end - h.begin || !send_all(c, &endf, sizeof(endf))) break;
+                std::cout << "[Worker] send external sort done\n";
+            }
+            else if (h.op == (uint32_t)Op::SORT && USE_PIPE_SORT && local.size() >= PIPE_MIN_N) {
+                std::cout << "[Worker] pipelined sort...\n";
+                shuffle_fisher_yates(local.data(), (uint64_t)local.size(),
+                    0xBADC0FFEEULL ^ h.begin); // 使用 begin 参与 seed，保证段间差异
+                // 1) 按键分桶，桶之间有序（见 cpu_sort.h 的 bucket_by_code）；
+                //    协商了共享内存时直接分桶到共享内存区域中，之后在其中原地排序，master 从中直接归并
+                std::vector<int64_t> bounds;
+                shm = make_shm(features, (uint64_t)local.size());
+                if ((features & FEATURE_SHM) && !send_shm_notice(c, shm.get())) break;
+                if (shm) {
+                    bucket_by_code(local.data(), (int64_t)local.size(), 0x9E3779B97F4A7C15ULL ^ h.begin, *shm, bounds);
+                    FirstTouchVec().swap(local);
+                }
+                else {
+                    FirstTouchVec buckets;
+                    bucket_by_code(local.data(), (int64_t)local.size(), 0x9E3779B97F4A7C15ULL ^ h.begin, buckets, bounds);
+                    local.swap(buckets);
+                }
+                float* out = shm ? shm->data() : local.data();
+
+                // 2) 发送线程按桶号顺序等待，某桶一排好就分帧发出，与后面各桶的排序重叠；
+                //    compute_ms 为第一个桶排好之前的耗时（生成、打乱、分桶与首桶排序），其余排序被发送掩盖；
+                //    结果在共享内存中时改为按桶推进已发布的元素个数，master 边等边归并
+                const bool codec = (features & FEATURE_SORT_CODEC) != 0;
+                std::unique_ptr<std::atomic<bool>[]> done(new std::atomic<bool>[PIPE_BUCKETS]);
+                for (int b = 0; b < PIPE_BUCKETS; ++b) done[b].store(false, std::memory_order_relaxed);
+                bool send_ok = false;
+                std::thread sender([&]() {
+                    numa_release_thread();  // 不与主线程（OpenMP 0 号线程）挤在同一个 CPU 上
+                    WorkerSortHeader wh{ (uint64_t)bounds[PIPE_BUCKETS] * sizeof(float), 0.0 };
+                    SortChunkHeader endf{ 0 };
+                    for (int b = 0; b < PIPE_BUCKETS; ++b) {
+                        while (!done[b].load(std::memory_order_acquire)) std::this_thread::yield();
+                        SortFrames sf;
+                        std::vector<NetBuf> wb;
+                        if (b == 0) {
+                            QueryPerformanceCounter(&ed);
+                            wh.compute_ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
+                            if (!shm) wb.push_back({ &wh, sizeof(wh) });
+                        }
+                        if (shm) {
+                            shm->publish((uint64_t)bounds[b + 1]);
+                            continue;
+                        }
+                        // 排序线程占满 CPU，编码在本线程内串行完成
+                        append_sort_frames(out + bounds[b], (uint64_t)(bounds[b + 1] - bounds[b]), codec, false, sf, wb);
+                        if (b + 1 == PIPE_BUCKETS) wb.push_back({ &endf, sizeof(endf) });
+                        if (!wb.empty() && !send_bulk(c, wb.data(), wb.size())) return;
+                    }
+                    if (shm) shm->finish(true, wh.compute_ms);
+                    send_ok = true;
+                });
+
+                // 3) 各桶按编号顺序分给线程排序（动态调度，编号小的桶先完成）
+#if defined(USE_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+                for (int b = 0; b < PIPE_BUCKETS; ++b) {
+                    sort_with_engine<LogSqrtTransform>(SORT_ENGINE, out + bounds[b], bounds[b + 1] - bounds[b]);    //TODO：排序引擎由 cpu_sort.h 中的 SORT_ENGINE 决定
+                    done[b].store(true, std::memory_order_release);
+                }
+                sender.join();
+                if (!send_ok) break;
+                std::cout << "[Worker] send pipelined sort done\n";
+            }
             else if (h.op == (uint32_t)Op::SORT) {
                 std::cout << "[Worker] sort...\n";
                 shuffle_fisher_yates(local.data(), (uint64_t)local.size(),
                     0xBADC0FFEEULL ^ h.begin); // 使用 begin 参与 seed，保证段间差异
-                quicksort_by_key(local.data(), 0, (int64_t)local.size() - 1);
+                // 单调变换下推：按原始值排序，回传的仍是按 key 有序的原始值
+                //sort_by_transform<LogSqrtTransform>(local.data(), (int64_t)local.size());//
+                sort_with_engine<LogSqrtTransform>(SORT_ENGINE, local.data(), (int64_t)local.size());    //TODO：排序引擎由 cpu_sort.h 中的 SORT_ENGINE 决定
                 QueryPerformanceCounter(&ed);
                 double compute_ms = (ed.QuadPart - st.QuadPart) * freqInvMs();
                 std::cout << "[Worker] local[0]=" << local.front()
@@ -153,12 +757,29 @@ int main() {
                 std::cout << "[Worker] sort done\n";
                 uint64_t bytes = (uint64_t)local.size() * sizeof(float);
                 WorkerSortHeader wh{ bytes, compute_ms };
-                send_all(c, &wh, sizeof(wh));
-                send_all(c, local.data(), (size_t)bytes);
+                // 协商了共享内存时拷入共享内存区域（小区间才走这里，拷贝量不大）
+                shm = make_shm(features, (uint64_t)local.size());
+                if (shm) {
+                    std::memcpy(shm->data(), local.data(), (size_t)bytes);
+                    shm->finish(true, compute_ms);
+                }
+                if ((features & FEATURE_SHM) && !send_shm_notice(c, shm.get())) break;
+                if (shm) continue;
+                // 分帧发送，master 收到一帧即可开始归并；
+                // 全部帧头与数据组成一个分段列表，一次 send_bulk 发出（不再每帧两次系统调用，Linux 上数据可零拷贝）
+                SortFrames sf;
+                SortChunkHeader endf{ 0 };
+                std::vector<NetBuf> wb{ { &wh, sizeof(wh) } };
+                append_sort_frames(local.data(), (uint64_t)local.size(), (features & FEATURE_SORT_CODEC) != 0, true, sf, wb);
+                wb.push_back({ &endf, sizeof(endf) });
+                send_bulk(c, wb.data(), wb.size());
                 std::cout << "[Worker] send sort done\n";
             }
+            // 结果发出后再统计本地内存比例，不计入 compute_ms
+            if (!local.empty()) numa_report("worker local", local.data(), (uint64_t)local.size());
         }
 
+        for (SOCKET d : streams) close_sock(d);
         close_sock(c);
         close_sock(ls);
         return 0;
@@ -172,6 +793,8 @@ int main() {
         return 1;
     }
 
+#if defined(_WIN32)
     system("pause");
+#endif
 
 }